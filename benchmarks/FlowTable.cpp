@@ -0,0 +1,83 @@
+// Compares the lookups of the FlowTable against the ConcurrentMap
+//  it replaced, with a single thread and with several concurrent ones.
+// Usage: flow_table_benchmark [flows] [lookups per thread] [threads]
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+#include <tcpp/utils/Connections.hpp>
+#include <tcpp/data-structures/FlowTable.hpp>
+#include <tcpp/data-structures/ConcurrentMap.hpp>
+
+using namespace tcpp;
+
+static std::vector<ConnectionID> make_flows(const size_t count) {
+    std::mt19937 generator(42);
+    std::vector<ConnectionID> flows(count);
+    for (size_t i = 0; i < count; i++) {
+        // Many clients connecting to the same server endpoint
+        flows[i] = { static_cast<IpAddress>(generator()), 0x0A000001, static_cast<Port>(generator()), 4000 };
+    }
+    return flows;
+}
+
+// The average nanoseconds per lookup over all the threads
+static double measure(const size_t threads_count, const size_t lookups, auto&& lookup) {
+    std::atomic<size_t> found = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < threads_count; t++) {
+            threads.emplace_back([&, t] {
+                std::mt19937_64 generator(t);
+                size_t local = 0;
+                for (size_t i = 0; i < lookups; i++) {
+                    local += lookup(generator());
+                }
+                found += local;
+            });
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    if (found != threads_count * lookups) {
+        std::cerr << "Some of the flows weren't found\n";
+        std::exit(1);
+    }
+    return elapsed.count() / static_cast<double>(lookups);
+}
+
+int main(int argc, char* argv[]) {
+    const size_t flows_count = argc > 1 ? std::stoul(argv[1]) : 1 << 16;
+    const size_t lookups = argc > 2 ? std::stoul(argv[2]) : 1 << 22;
+    const size_t threads = argc > 3 ? std::stoul(argv[3]) : std::max(1U, std::thread::hardware_concurrency());
+
+    auto flows = make_flows(flows_count);
+
+    EpochReclaimer reclaimer(0);
+    FlowTable<ConnectionID, uint64_t> table(reclaimer, flows_count * 8 / 7 + 1);
+    ConcurrentMap<ConnectionID, uint64_t> map;
+    for (size_t i = 0; i < flows.size(); i++) {
+        table.emplace(flows[i], i);
+        map.emplace(flows[i], i);
+    }
+
+    auto table_lookup = [&](uint64_t random) {
+        return table.find(flows[random % flows.size()]) != nullptr;
+    };
+    auto map_lookup = [&](uint64_t random) {
+        return map.find(flows[random % flows.size()]) != map.end();
+    };
+
+    std::cout << flows_count << " flows, " << lookups << " lookups per thread\n";
+    for (size_t t : { size_t { 1 }, threads }) {
+        std::cout << t << " thread(s):\n";
+        std::cout << "  FlowTable:     " << measure(t, lookups, table_lookup) << " ns/lookup\n";
+        std::cout << "  ConcurrentMap: " << measure(t, lookups, map_lookup) << " ns/lookup\n";
+        if (threads == 1) break;
+    }
+}
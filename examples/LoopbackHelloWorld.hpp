@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+
+#include <tcpp/TCPInterface.hpp>
+#include <tcpp/LoopbackDevice.hpp>
+#include <tcpp/utils/IPv4.hpp>
+
+using tcpp::operator ""_nip;
+
+// Two interfaces talking to each other over an in-memory link, with no kernel
+//  in the loop. Measures how long it takes to connect and receive the greeting.
+void example() {
+    tcpp::LoopbackPair pair;
+    auto server = tcpp::TCPInterface { std::move(pair.first) };
+    auto client = tcpp::TCPInterface { std::move(pair.second) };
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+
+    constexpr int connections_count = 100;
+    std::chrono::nanoseconds handshakes { }, greetings { };
+    for (tcpp::Port port = 50000; port < 50000 + connections_count; port++) {
+        std::atomic<tcpp::TCPConnection<1 << 20>*> accepted = nullptr;
+        std::jthread acceptor([&] {
+            // The server greets every connection, then closes its side
+            accepted = &listener.accept();
+            accepted.load()->connection_established.wait(false);
+            accepted.load()->write("Hello World!\n");
+            accepted.load()->close();
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        auto& connection = client.connect({ "10.0.0.2"_nip, port }, server_endpoint);
+        connection.connection_established.wait(false);
+        auto established = std::chrono::steady_clock::now();
+
+        std::array<uint8_t, 64> buffer { };
+        size_t received = 0;
+        while (received < 13) {
+            received += connection.read({ buffer.data() + received, buffer.size() - received });
+        }
+        auto greeted = std::chrono::steady_clock::now();
+
+        handshakes += established - start;
+        greetings += greeted - established;
+
+        // Released, so that they're freed instead of piling up
+        connection.peer_closed.wait(false);
+        connection.close();
+        acceptor.join();
+    }
+
+    std::cout << "Average handshake: " << (handshakes / connections_count).count() << "ns\n";
+    std::cout << "Average greeting: " << (greetings / connections_count).count() << "ns\n";
+}
@@ -34,10 +34,12 @@ static std::string id_str(tcpp::ConnectionID id) {
                 auto& connection = *connections[i];
                 auto id = id_str(connection.id);
 
-                if (connection.connection_closed) {
+                if (connection.peer_closed) {
                     std::cout << "(*) " << id << " left the room.\n";
+                    connection.close();
                     connections[i] = connections.back();
                     connections.pop_back();
+                    continue;
                 }
 
                 auto n = connection.read(buffer);
@@ -17,9 +17,12 @@ void example() {
     auto& listener = tcp.bind({ "10.0.0.5"_nip, 4000 });
     auto& connection = listener.accept();
     std::array<uint8_t, 2048> buffer { };
-    while (!connection.connection_closed) {
+    while (!connection.peer_closed) {
         auto n = connection.read(buffer);
         buffer[n] = '\0';
         std::cout << buffer.data();
+        // Echoed back
+        connection.write({ buffer.data(), n });
     }
+    connection.close();
 }
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+#include <concepts>
+#include <cstdint>
+
+namespace tcpp {
+
+struct ReceivedPacket {
+    // Starts at the IP header, at the beginning of a buffer of the PacketAllocator.
+    //  Empty if nothing is received.
+    std::span<uint8_t> data;
+    // Set when the device vouches for the checksums of the packet, so they don't need to be verified
+    bool checksum_valid = false;
+};
+
+// What the TCPInterface needs from the device underneath it. Each of the queues of the
+//  device is received from by a single thread and sent to by another single thread.
+//  - receive_packet(queue): blocks until a packet is received, handing the ownership of its
+//     buffer to the caller. Returns an empty packet once the device is closed.
+//  - send_packets(packets, queue): takes the ownership of the buffers of the packets.
+//  - close(): unblocks the receivers. Nothing is sent or received afterward.
+//  - offloads_enabled(): whether the device computes the TCP checksums of the sent packets.
+template <typename T>
+concept LinkDevice = std::movable<T> && requires(
+    T device, const T& const_device, std::span<const std::span<uint8_t>> packets, size_t queue
+) {
+    { device.receive_packet(queue) } -> std::same_as<ReceivedPacket>;
+    device.send_packets(packets, queue);
+    device.close();
+    { const_device.queues_count() } -> std::convertible_to<size_t>;
+    { const_device.offloads_enabled() } -> std::convertible_to<bool>;
+};
+
+}
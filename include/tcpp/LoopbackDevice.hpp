@@ -0,0 +1,74 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <cstdint>
+
+#include <tcpp/LinkDevice.hpp>
+
+namespace tcpp {
+
+// An in-memory link device. The packets sent through one of the devices of a LoopbackPair
+//  are received by the other one, on the queue with the same index. The buffers themselves
+//  are passed along, so nothing is copied and no system call is made on the way.
+class LoopbackDevice {
+public:
+
+    // The number of packets that can be on their way on each of the queues in each direction.
+    //  Packets sent while the wire is full are dropped, as they would be by a real link.
+    static constexpr size_t WireCapacity = 1 << 9;
+
+    // Blocks until a packet is received. Returns an empty packet once the device is closed.
+    [[nodiscard]] ReceivedPacket receive_packet(size_t queue = 0);
+
+    // Takes the ownership of the buffers, and hands them to the other device
+    void send_packets(std::span<const std::span<uint8_t>> packets, size_t queue = 0);
+
+    [[nodiscard]] size_t queues_count() const;
+
+    // The packets never leave the memory, so the checksums are never computed in the
+    //  first place. The received packets are reported to have valid checksums instead.
+    [[nodiscard]] bool offloads_enabled() const { return false; }
+
+    void close();
+
+    LoopbackDevice(const LoopbackDevice&) = delete;
+
+    LoopbackDevice& operator=(const LoopbackDevice&) = delete;
+
+    LoopbackDevice(LoopbackDevice&&) noexcept = default;
+
+    LoopbackDevice& operator=(LoopbackDevice&&) noexcept = default;
+
+    ~LoopbackDevice() = default;
+
+private:
+
+    friend class LoopbackPair;
+
+    // The queues between the two devices, defined in the source file. It's shared by
+    //  both of them, and lives as long as any of them does, since either of them might
+    //  still be sending to the other one after it's closed.
+    struct Link;
+
+    LoopbackDevice(std::shared_ptr<Link> link_, size_t side_);
+
+    std::shared_ptr<Link> link;
+    // The index of this device in the pair
+    size_t side;
+};
+
+static_assert(LinkDevice<LoopbackDevice>);
+
+// Two devices connected back to back. Typically each of them is moved into a TCPInterface
+//  of its own, so that the two interfaces can talk to each other within the same process.
+class LoopbackPair {
+public:
+
+    explicit LoopbackPair(size_t queues = 1);
+
+    LoopbackDevice first;
+    LoopbackDevice second;
+};
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/LinkDevice.hpp>
+
+namespace tcpp {
+
+// Attaches the stack to an L2 interface (like one end of a veth pair) through AF_PACKET sockets
+//  with TPACKET_V3 memory-mapped rings. The frames are parsed in place in the receive ring, and
+//  the frames to send are written in place into the transmit ring. No system call is made per
+//  packet: the receive ring is only polled when it's empty, and the transmit ring is flushed once
+//  per batch. The device answers ARP requests for its address and learns the addresses of its
+//  neighbours from the frames it receives. The address shouldn't be one the kernel owns on the
+//  interface, otherwise the kernel would answer the same packets as well.
+class PacketSocketDevice {
+public:
+
+    // Copies the next IPv4 packet addressed to the device out of the receive ring. Everything
+    //  else is handled or dropped in place. Returns an empty packet once the device is closed.
+    [[nodiscard]] ReceivedPacket receive_packet(size_t queue = 0);
+
+    // Packets to neighbours whose addresses aren't known yet are dropped, and an ARP request is sent for them,
+    //  at most once a second for each of the neighbours
+    void send_packets(std::span<const std::span<uint8_t>> packets, size_t queue = 0);
+
+    [[nodiscard]] size_t queues_count() const { return queues.size(); }
+
+    [[nodiscard]] bool offloads_enabled() const { return false; }
+
+    [[nodiscard]] MacAddress mac() const;
+
+    void close();
+
+    PacketSocketDevice(const PacketSocketDevice&) = delete;
+
+    PacketSocketDevice& operator=(const PacketSocketDevice&) = delete;
+
+    PacketSocketDevice(PacketSocketDevice&&) noexcept;
+
+    PacketSocketDevice& operator=(PacketSocketDevice&&) noexcept;
+
+    ~PacketSocketDevice();
+
+private:
+
+    friend class PacketSocketBuilder;
+
+    // The socket and the rings of each of the queues, and the
+    //  state shared by all of them. Both are defined in the source file.
+    struct Queue;
+    struct Shared;
+
+    PacketSocketDevice(std::vector<std::unique_ptr<Queue>> queues_, std::unique_ptr<Shared> shared_);
+
+    void handle_arp(size_t queue, std::span<uint8_t> frame);
+
+    void send_arp(uint16_t operation, const MacAddress& target_mac, IpAddress target_ip);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::unique_ptr<Shared> shared;
+};
+
+static_assert(LinkDevice<PacketSocketDevice>);
+
+class PacketSocketBuilder {
+public:
+
+    explicit PacketSocketBuilder(std::string interface_name_) : interface_name(std::move(interface_name_)) { }
+
+    // The address the device answers ARP requests for, and receives the packets of
+    PacketSocketBuilder& set_ip4(std::string ip4_) { ip4 = std::move(ip4_); return *this; }
+
+    // More than one queue opens a socket for each of the queues, joined in a
+    //  fanout group that spreads the flows over them by their hash
+    PacketSocketBuilder& set_queues(size_t queues_) { queues = queues_; return *this; }
+
+    // The receive ring of each of the queues is made of this many blocks of this size
+    PacketSocketBuilder& set_rx_ring(size_t block_size_, size_t blocks_count_) {
+        block_size = block_size_;
+        blocks_count = blocks_count_;
+        return *this;
+    }
+
+    // A block is handed to us once it's full, or once this much time passes since its first
+    //  packet. Low values trade the number of packets handed at once for latency.
+    PacketSocketBuilder& set_block_timeout(unsigned milliseconds) { block_timeout = milliseconds; return *this; }
+
+    // The number of frames in the transmit ring of each of the queues
+    PacketSocketBuilder& set_tx_frames(size_t frames) { tx_frames = frames; return *this; }
+
+    PacketSocketDevice build();
+
+private:
+
+    std::string interface_name;
+    std::string ip4;
+    size_t queues = 1;
+    size_t block_size = 1 << 20;
+    size_t blocks_count = 32;
+    unsigned block_timeout = 1;
+    size_t tx_frames = 1024;
+};
+
+}
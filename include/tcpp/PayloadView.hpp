@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include <utility>
+#include <cstdint>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+
+namespace tcpp {
+
+// A read-only view of the payload of a received segment, loaned to the application without
+//  copying. The buffer of the segment goes back to the allocator once the view is released.
+class PayloadView {
+
+    PacketBuffer buffer = nullptr;
+    std::span<const uint8_t> payload;
+
+public:
+
+    PayloadView() = default;
+
+    PayloadView(const PacketBuffer buffer_, const std::span<const uint8_t> payload_)
+        : buffer(buffer_), payload(payload_) { }
+
+    PayloadView(const PayloadView&) = delete;
+
+    PayloadView& operator=(const PayloadView&) = delete;
+
+    PayloadView(PayloadView&& other) noexcept
+        : buffer(std::exchange(other.buffer, nullptr)), payload(std::exchange(other.payload, { })) { }
+
+    PayloadView& operator=(PayloadView&& other) noexcept {
+        release();
+        buffer = std::exchange(other.buffer, nullptr);
+        payload = std::exchange(other.payload, { });
+        return *this;
+    }
+
+    [[nodiscard]] std::span<const uint8_t> data() const { return payload; }
+
+    [[nodiscard]] size_t size() const { return payload.size(); }
+
+    [[nodiscard]] bool empty() const { return payload.empty(); }
+
+    // Drops the first bytes of the view, after they're consumed
+    void remove_prefix(const size_t count) { payload = payload.subspan(count); }
+
+    void release() {
+        if (buffer != nullptr) {
+            PacketAllocator{}.deallocate(buffer);
+            buffer = nullptr;
+        }
+        payload = { };
+    }
+
+    ~PayloadView() noexcept { release(); }
+};
+
+}
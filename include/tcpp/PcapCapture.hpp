@@ -0,0 +1,79 @@
+#pragma once
+
+#include <span>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+
+namespace tcpp {
+
+// Writes the packets passing through a TCPInterface to a pcap file (raw IP, nanosecond timestamps).
+// Recording a packet only copies it into a wait-free ring, which a background thread drains
+//  to the file, so the datapath never waits on the file. There is one ring for each direction
+//  of each of the queues, each of which must only be recorded to from a single thread.
+//  If a ring is full, the packet is left out of the capture and counted as dropped.
+class PcapCapture {
+public:
+
+    // The packets are cut to this size in the capture. Whatever fits in a regular
+    //  buffer is kept whole, which is every packet unless the segmentation is offloaded.
+    static constexpr size_t SnapLength = PacketAllocator::RegularCapacity;
+
+    // The number of packets each of the rings can hold before they're written to the file
+    static constexpr size_t RingCapacity = 1 << 10;
+
+    explicit PcapCapture(const std::string& path, size_t queues = 1);
+
+    void record_received(size_t queue, std::span<const uint8_t> packet);
+
+    // The packets are recorded before the device gets them. If the device computes the checksums, the
+    //  ones of the recorded copy are computed here instead, so that it's recorded as it's sent on the wire.
+    //  Segments to be split by the device are recorded as they are, before they're split.
+    void record_sent(size_t queue, std::span<const uint8_t> packet, bool checksum_offloaded = false);
+
+    [[nodiscard]] size_t queues_count() const { return rings.size() / 2; }
+
+    // The number of packets left out because the writer couldn't keep up
+    [[nodiscard]] size_t dropped_count() const { return dropped.load(std::memory_order::relaxed); }
+
+    PcapCapture(const PcapCapture&) = delete;
+
+    PcapCapture& operator=(const PcapCapture&) = delete;
+
+    PcapCapture(PcapCapture&&) = delete;
+
+    PcapCapture& operator=(PcapCapture&&) = delete;
+
+    // Writes whatever is left in the rings before closing the file
+    ~PcapCapture();
+
+private:
+
+    // A captured packet as stored in the rings, defined in the source file
+    struct Record;
+    struct Ring;
+
+    void record(size_t ring, std::span<const uint8_t> packet, bool checksum_offloaded = false);
+
+    void writer(std::stop_token token);
+
+    // Returns the number of records written
+    size_t drain();
+
+    std::ofstream file;
+    // The received packets of queue i go to ring 2i, and the sent ones to ring 2i + 1
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::atomic<size_t> dropped = 0;
+
+    // Declared last so that it's joined before anything it uses is destroyed
+    std::jthread writer_thread;
+};
+
+}
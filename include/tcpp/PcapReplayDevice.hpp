@@ -0,0 +1,76 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include <tcpp/LinkDevice.hpp>
+
+namespace tcpp {
+
+enum class ReplayTiming {
+    AsFastAsPossible,
+    // The packets are spaced out the way they were captured
+    Recorded,
+};
+
+// A link device that replays the packets of a pcap file. The file is memory-mapped and
+//  prefaulted up front, so the replay doesn't wait on any I/O. Raw IP, IPv4, and Ethernet
+//  (IPv4 frames only) captures are supported, with either microsecond or nanosecond timestamps.
+// With multiple queues, the packets are split over them by the hash of their connection, the
+//  same way the TCPInterface shards its connections, so that each flow is replayed in order.
+class PcapReplayDevice {
+public:
+
+    explicit PcapReplayDevice(
+        const std::string& path,
+        ReplayTiming timing_ = ReplayTiming::AsFastAsPossible,
+        size_t queues = 1
+    );
+
+    // Copies the next packet of the queue into a buffer of the PacketAllocator. Returns an empty
+    //  packet once all the packets of the queue are replayed, or once the device is closed.
+    [[nodiscard]] ReceivedPacket receive_packet(size_t queue = 0);
+
+    // There's nothing on the other side. The packets are counted, then dropped.
+    void send_packets(std::span<const std::span<uint8_t>> packets, size_t queue = 0);
+
+    [[nodiscard]] size_t queues_count() const;
+
+    [[nodiscard]] bool offloads_enabled() const { return false; }
+
+    void close();
+
+    // The number of packets in the file that can be replayed
+    [[nodiscard]] size_t packets_count() const;
+
+    // The number of packets handed out by receive_packet() so far
+    [[nodiscard]] size_t replayed_count() const;
+
+    // The number of packets given to send_packets() so far
+    [[nodiscard]] size_t sent_count() const;
+
+    // Whether all the packets of all the queues have been replayed
+    [[nodiscard]] bool finished() const { return replayed_count() == packets_count(); }
+
+    PcapReplayDevice(const PcapReplayDevice&) = delete;
+
+    PcapReplayDevice& operator=(const PcapReplayDevice&) = delete;
+
+    PcapReplayDevice(PcapReplayDevice&&) noexcept;
+
+    PcapReplayDevice& operator=(PcapReplayDevice&&) noexcept;
+
+    ~PcapReplayDevice();
+
+private:
+
+    // The mapping of the file and the replay progress, defined in the source file
+    struct Replay;
+    std::unique_ptr<Replay> replay;
+};
+
+static_assert(LinkDevice<PcapReplayDevice>);
+
+}
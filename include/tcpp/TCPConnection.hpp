@@ -1,15 +1,53 @@
 #pragma once
 
+#include <array>
+#include <deque>
+#include <chrono>
 #include <algorithm>
+#include <optional>
+#include <mutex>
+#include <functional>
+#include <string_view>
 
+#include <tcpp/PayloadView.hpp>
 #include <tcpp/structs/IPv4.hpp>
 #include <tcpp/structs/TCP.hpp>
+#include <tcpp/data-structures/ByteRing.hpp>
+#include <tcpp/data-structures/ReassemblyQueue.hpp>
 #include <tcpp/data-structures/MPSCBoundedQueue.hpp>
-#include <tcpp/allocators/ReusableSlabAllocator.hpp>
+#include <tcpp/data-structures/WaitableQueue.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/allocators/PacketHandle.hpp>
+#include <tcpp/congestion-control/CongestionControl.hpp>
+#include <tcpp/congestion-control/NewReno.hpp>
+#include <tcpp/utils/SequenceNumbers.hpp>
+#include <tcpp/utils/InitialSequenceNumber.hpp>
 
 namespace tcpp {
 
-template <size_t ConnectionBufferSize>
+struct ConnectionOptions {
+    // Set when the device computes the TCP checksums of the packets it sends
+    bool checksum_offload = false;
+    // Set when the device splits the segments larger than the MSS
+    bool segmentation_offload = false;
+    // Received segments are loaned to the application in place instead of copying their payload
+    bool zero_copy_receive = false;
+    // The receive buffer is mapped twice in a row, so that received_regions() is always one piece
+    bool mirrored_buffers = false;
+    // Explicit congestion notification (RFC 3168) is offered to the peer, and used if it agrees
+    bool ecn = true;
+    // The lower bound of the retransmission timeout. RFC 6298 asks for a second, which is
+    //  many round trips on most paths. Linux uses 200ms, and so does this by default.
+    std::chrono::milliseconds min_rto { 200 };
+    // The capacity of each of the send and the receive buffers. The free space of the receive
+    //  buffer is the window advertised to the peer, scaled to cover all of it (RFC 7323).
+    size_t buffer_size = 1 << 18;
+    // How long the connection lingers in TIME-WAIT once both sides are closed, if ours closed first. It's
+    //  twice the maximum segment lifetime (RFC 9293 - Section 3.4.2), for which Linux takes 60 seconds in total.
+    std::chrono::milliseconds time_wait { 60000 };
+};
+
+template <size_t SendQueueCapacity, CongestionControl Controller = NewReno>
 class TCPConnection {
     /*
      *  RFC 9293 - Section 3.3.1 - Figure 3
@@ -29,7 +67,7 @@ class TCPConnection {
     struct SendSequenceSpace {
         uint32_t una;  // send unacknowledged
         uint32_t nxt;  // send next
-        uint16_t wnd;  // send window
+        uint32_t wnd;  // send window, scaled
         uint8_t  up;   // send urgent pointer
         uint32_t wl1;  // segment sequence number used for last window update
         uint32_t wl2;  // segment acknowledgment number used for last window update
@@ -57,106 +95,821 @@ class TCPConnection {
         uint32_t irs;  // initial receive sequence number
     };
 
+    // A sent segment that occupies sequence space, kept until it's acknowledged
+    struct SentSegment {
+        uint32_t seq;
+        // The sequence number right after the segment
+        uint32_t end;
+        // Shared with the send queue and the device while it's on its way
+        PacketHandle packet;
+        SteadyTime sent_at;
+        // Received by the peer out of order, as its sack blocks say
+        bool sacked = false;
+        // Ever sent again, which rules it out of the round-trip time samples (Karn's algorithm)
+        bool retransmitted = false;
+        // Sent again since the last timeout, which is when the loss recovery starts over
+        bool resent = false;
+        // Refused by the send queue while it was full, and pushed again once it has room
+        bool dropped = false;
+    };
+
     enum class State {
         New,
-        SynRcvd,  // Syn Received
-        SynSent,  // Syn Sent
-        Estab,    // Connection Established
-
-        WaitingForDataAck,  // TODO Delete this
-        WaitingForFinAck,   // TODO Delete this
-        FinAcked,           // TODO Delete this
+        SynRcvd,    // Syn Received
+        SynSent,    // Syn Sent
+        Estab,      // Connection Established
+        FinWait1,   // Our fin is sent, waiting for its acknowledgement
+        FinWait2,   // Our fin is acknowledged, waiting for the fin of the peer
+        CloseWait,  // The peer has closed its side, waiting for the application to close ours
+        Closing,    // Both fins are sent, waiting for the acknowledgement of ours
+        LastAck,    // Our fin is sent after the one of the peer, waiting for its acknowledgement
+        TimeWait,   // Both fins are acknowledged, waiting for the segments of the connection to leave the network
+        Closed,
     };
 
-    void send_packet(structs::IPv4& ip) {
+    // Builds the headers of a new segment in place, in a fresh buffer with room for the
+    //  payload. The segment is then sent as is by send_segment(), without any copying.
+    structs::IPv4& new_segment(const size_t payload_size = 0, const size_t options_size = 0) {
+        const auto headers_size = HeadersSize + options_size;
+
+        auto buffer = PacketAllocator{}.allocate(headers_size + payload_size);
+        std::fill_n(buffer, headers_size, 0);
+
+        auto& ip = structs::IPv4::from_ptr(buffer);
+        ip.version = 4;
+        ip.ihl = sizeof(structs::IPv4) / 4;
+        ip.set_total_len(static_cast<uint16_t>(headers_size + payload_size));
+        ip.fragment_offset_n = htons(0x4000);  // Don't fragment
+        ip.ttl = 64;
+        ip.protocol = structs::IPv4::IPPROTOCOL_TCP;
+        // The id is in terms of the received packets
+        ip.source_addr_n = id.dest_ip;
+        ip.dest_addr_n = id.source_ip;
+
+        auto& tcp = ip.tcp_payload();
+        tcp.set_source_port(id.dest_port);
+        tcp.set_dest_port(id.source_port);
+        tcp.data_offset = sizeof(structs::TCP) / 4;
+
+        return ip;
+    }
+
+    // The syn and the syn-ack carry our maximum segment size, along with our window scale and sack permitted if they're offered
+    structs::IPv4& new_syn_segment(const bool offer_window_scale, const bool offer_sack) {
+        const auto options_size = structs::TCP::MSS_OPTION_SIZE +
+            (offer_window_scale ? structs::TCP::PADDED_WINDOW_SCALE_OPTION_SIZE : 0) +
+            (offer_sack ? structs::TCP::PADDED_SACK_PERMITTED_OPTION_SIZE : 0);
+        auto& ip = new_segment(0, options_size);
+        auto& tcp = ip.tcp_payload();
+        tcp.syn = true;
+        tcp.set_mss_option(LocalMSS);
+        if (offer_window_scale) {
+            tcp.set_window_scale_option(local_window_shift());
+        }
+        if (offer_sack) {
+            tcp.set_sack_permitted_option();
+        }
+        return ip;
+    }
+
+    // The most that can be received before the application reads any of it. In the zero-copy mode,
+    //  it's bounded by the slots for the segments, each of which is counted as a full segment.
+    [[nodiscard]] size_t receive_capacity() const {
+        return options.zero_copy_receive ? SegmentsCapacity * LocalMSS : receive_buffer.capacity();
+    }
+
+    // The smallest shift that lets the window cover the whole receive buffer
+    [[nodiscard]] uint8_t local_window_shift() const {
+        uint8_t shift = 0;
+        while ((receive_capacity() >> shift) > MaxUnscaledWindow && shift < structs::TCP::MAX_WINDOW_SCALE) {
+            shift++;
+        }
+        return shift;
+    }
+
+    // The room left for received data. Only the handler writes to the receive
+    //  buffer, and it does so with the lock held, which this is called with as well.
+    [[nodiscard]] size_t receive_space() {
+        if (options.zero_copy_receive) {
+            return (SegmentsCapacity - received_segments.size()) * LocalMSS;
+        }
+        return receive_buffer.free_space();
+    }
+
+    // The window of a syn is never scaled (RFC 7323 - Section 2.2). Otherwise, the space is rounded
+    //  down to the granularity of the scale, which might shrink the window by less than that.
+    uint16_t advertise_window(const bool syn) {
+        const auto shift = syn ? 0 : window_shift;
+        const auto space = std::min(receive_space(), MaxUnscaledWindow << shift) >> shift;
+        receive.wnd = static_cast<uint32_t>(space << shift);
+        advertised_window.store(receive.wnd, std::memory_order_relaxed);
+        return static_cast<uint16_t>(space);
+    }
+
+    // Fills in the acknowledgement, the window, and the checksums, which are brought up to date each time the segment is sent
+    void stamp_segment(structs::IPv4& ip) {
         auto& tcp = ip.tcp_payload();
-        tcp.set_seq_num(send.nxt);
+        if (!tcp.syn) tcp.ece = ece_pending;
         tcp.set_ack_num(receive.nxt);
-        tcp.set_window_size(send.wnd);
-        if (!swapped) {
-            swapped = true;
-            std::swap(ip.source_addr_n, ip.dest_addr_n);
-            std::swap(tcp.source_port_n, tcp.dest_port_n);
-        }
-        ip.compute_and_set_ip_tcp_checksums();
-        ReusableAllocator alloc;
-        auto buffer = alloc.allocate();
-        std::copy_n(reinterpret_cast<uint8_t*>(&ip), ip.total_len(), buffer);
-        send_queue.push(buffer);
+        tcp.set_window_size(advertise_window(tcp.syn));
+        if (options.checksum_offload) {
+            // The device takes care of the TCP checksum
+            ip.compute_and_set_checksum();
+        } else {
+            ip.compute_and_set_ip_tcp_checksums();
+        }
+        acknowledged = receive.nxt;
+    }
+
+    // Fills in the sequence space fields and the checksums, and hands the buffer of the segment to the sender
+    void send_segment(structs::IPv4& ip) {
+        auto& tcp = ip.tcp_payload();
+        const auto seq = send.nxt;
+        tcp.set_seq_num(seq);
+        stamp_segment(ip);
         const auto seq_increase =
             ip.total_len() - ip.payload_offset() - tcp.payload_offset() +  // TCP payload size
             (tcp.syn | tcp.fin);
+        // Advanced before the segment is handed over. Once it is, the reply
+        //  might be processed by the handler thread at any moment.
         send.nxt += seq_increase;
+        PacketHandle segment { reinterpret_cast<PacketBuffer>(&ip) };
+        if (seq_increase > 0) {
+            const auto now = std::chrono::steady_clock::now();
+            // Shared with the send queue rather than copied. The reference is taken before the
+            //  segment is handed over, since the device may be done with it at any moment after.
+            retransmission_queue.push_back({ seq, send.nxt, segment, now });
+            // RFC 6298 - Section 5.1
+            if (!timer_running()) arm_retransmission_timer(now);
+        }
+        auto buffer = segment.release();
+        if (!send_queue.push(buffer)) {
+            PacketAllocator{}.deallocate(buffer);
+            // Still kept in the retransmission queue if it occupies sequence space. Bare acknowledgements are lost.
+            if (seq_increase > 0) mark_dropped(retransmission_queue.back());
+        }
     }
 
-    void process_syn(structs::IPv4& ip) {
-        auto& tcp = ip.tcp_payload();
+    // The segment is pushed again shortly, rather than after a whole retransmission timeout
+    void mark_dropped(SentSegment& segment) {
+        segment.dropped = true;
+        dropped_segments = true;
+        schedule_timer(std::chrono::steady_clock::now() + QueueRetryDelay);
+    }
+
+    // Pushes the segments the full send queue refused again, in order, until it refuses one again
+    void resend_dropped() {
+        if (!dropped_segments) return;
+        dropped_segments = false;
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& segment : retransmission_queue) {
+            if (!segment.dropped) continue;
+            // Never shared, since the queue didn't take it
+            stamp_segment(structs::IPv4::from_ptr(segment.packet.get()));
+            segment.sent_at = now;
+            auto buffer = segment.packet.share();
+            if (!send_queue.push(buffer)) {
+                PacketAllocator{}.deallocate(buffer);
+                mark_dropped(segment);
+                return;
+            }
+            segment.dropped = false;
+        }
+    }
+
+    // Sends a kept segment again, with the acknowledgement and the window brought up to date. The buffer is
+    //  copied first if it's still shared, since the device (or the peer, over a loopback) may still be reading it.
+    void retransmit(SentSegment& segment) {
+        if (!segment.packet.unique()) {
+            const auto size = structs::IPv4::from_ptr(segment.packet.get()).total_len();
+            auto copy = PacketAllocator{}.allocate(size);
+            std::copy_n(segment.packet.get(), size, copy);
+            PacketAllocator::metadata(copy).gso_size = PacketAllocator::metadata(segment.packet.get()).gso_size;
+            segment.packet = PacketHandle { copy };
+        }
+        auto& ip = structs::IPv4::from_ptr(segment.packet.get());
+        // The retransmissions aren't ECN-capable (RFC 3168 - Section 6.1.5)
+        ip.tos &= static_cast<uint8_t>(~structs::IPv4::ECN_MASK);
+        stamp_segment(ip);
+        segment.retransmitted = true;
+        segment.resent = true;
+        auto buffer = segment.packet.share();
+        if (!send_queue.push(buffer)) {
+            PacketAllocator{}.deallocate(buffer);
+            mark_dropped(segment);
+        }
+    }
 
-        send.iss = 0;
+    // Carries the blocks of what's held out of order, if sack is agreed on (RFC 2018 - Section 4). Only
+    //  the pure acknowledgements do, leaving the whole room of the data segments to their payload.
+    void send_ack() {
+        std::array<ReassemblyQueue::Range, structs::TCP::MAX_SACK_BLOCKS> ranges;
+        const auto count = sack_permitted ? out_of_order.ranges(ranges, last_out_of_order) : 0;
+        structs::IPv4& ack = new_segment(0, count > 0 ? structs::TCP::padded_sack_option_size(count) : 0);
+        auto& tcp = ack.tcp_payload();
+        tcp.ack = true;
+        if (count > 0) {
+            std::array<structs::TCP::SackBlock, structs::TCP::MAX_SACK_BLOCKS> blocks;
+            std::transform(ranges.begin(), ranges.begin() + static_cast<ptrdiff_t>(count), blocks.begin(), [](auto range) {
+                return structs::TCP::SackBlock { range.begin, range.end };
+            });
+            tcp.set_sack_option(std::span { blocks }.first(count));
+        }
+        send_segment(ack);
+    }
+
+    void initialize_send_space() {
+        send.iss = initial_sequence_number(id);
         send.una = send.iss;
         send.nxt = send.iss;
-        send.wnd = static_cast<uint16_t>((1 << 16) - 1);
+        recover = send.iss;
+        ecn_recover = send.iss;
+        highest_sacked = send.iss;
+        high_rxt = send.iss;
+    }
 
+    // The window, the maximum segment size, and the window scale of the peer, from its syn (or syn-ack)
+    void initialize_peer(const structs::TCP& tcp) {
         receive.irs = tcp.seq_num();
         receive.nxt = receive.irs + 1;
-        receive.wnd = tcp.window_size();
-
-        // Remove any options
-        const auto old_offset = tcp.data_offset;
-        tcp.data_offset = 5;
-        ip.set_total_len(ip.total_len() - (old_offset - 5) * 4);
+        send.wnd = tcp.window_size();
+        max_send_window = send.wnd;
+        send.wl1 = tcp.seq_num();
+        send.wl2 = tcp.ack_num();
+        auto mss = tcp.mss_option();
+        // RFC 9293 - Section 3.7.1: 536 bytes unless the peer says otherwise
+        peer_mss = mss == 0 ? DefaultMSS : std::min(mss, LocalMSS);
+        // RFC 7323 - Section 2.2: the windows are scaled only if both syns carry the option. Ours
+        //  always does, except in reply to a syn without it, in which case neither does.
+        if (auto shift = tcp.window_scale_option(); shift >= 0) {
+            window_scaling = true;
+            peer_window_shift = static_cast<uint8_t>(shift);
+            window_shift = local_window_shift();
+        }
+        // RFC 2018 - Section 2: the same goes for sack
+        sack_permitted = tcp.sack_permitted_option();
+        // RFC 3168 - Section 6.1.1: a syn offering ECN carries both ece and cwr, and the syn-ack agreeing to it only ece
+        ecn = options.ecn && tcp.ece && (tcp.ack ? !tcp.cwr : tcp.cwr);
+        congestion = Controller { peer_mss };
+    }
 
-        tcp.ack = true;
-        send_packet(ip);
+    void set_established() {
+        connection_established = true;
+        connection_established.notify_all();
+    }
 
-        state = State::SynRcvd;
+    void set_closed() {
+        state = State::Closed;
+        notify_closed();
+        release();
     }
 
-    void process_fin(structs::IPv4& ip) {
-        // Send ack as a response to the fin
-        auto& tcp = ip.tcp_payload();
-        tcp.ack = true;
-        tcp.fin = false;
-        send_packet(ip);
+    void notify_closed() {
         // TODO change this?
         connection_closed = true;
         connection_closed.notify_all();
+        peer_closed = true;
+        peer_closed.notify_all();
     }
 
-    void process_ack(structs::IPv4& ip) {
-        auto& tcp = ip.tcp_payload();
+    // RFC 9293 - Section 3.6: the connection is closed as far as the application is concerned, but it's kept around,
+    //  so that the last acknowledgement is sent again if the fin of the peer is, and so that the segments still in
+    //  the network aren't taken for those of a new connection with the same id. Entered again on each such fin.
+    void set_time_wait() {
+        state = State::TimeWait;
+        notify_closed();
+        time_wait_deadline = std::chrono::steady_clock::now() + options.time_wait;
+        schedule_timer(time_wait_deadline);
+    }
+
+    void process_syn(const structs::IPv4& ip) {
+        initialize_send_space();
+        initialize_peer(ip.tcp_payload());
+
+        auto& syn_ack = new_syn_segment(window_scaling, sack_permitted);
+        syn_ack.tcp_payload().ack = true;
+        syn_ack.tcp_payload().ece = ecn;
+        send_segment(syn_ack);
+
+        state = State::SynRcvd;
+    }
+
+    // Called once the fin of the peer is in order, after receive.nxt covers it
+    void process_fin() {
+        if (state == State::SynRcvd || state == State::Estab) {
+            state = State::CloseWait;
+        } else if (state == State::FinWait1) {
+            state = State::Closing;
+        } else if (state == State::FinWait2) {
+            set_time_wait();
+        } else {
+            // A retransmission. It's acknowledged again.
+            return;
+        }
+        peer_closed = true;
+        peer_closed.notify_all();
+    }
+
+    // Called once by the handler when the connection is closed, and once by the application when it's
+    //  done with it. Whichever comes last hands the connection back, which may free it right after.
+    void release() {
+        if (pending_releases.fetch_sub(1, std::memory_order_acq_rel) == 1 && on_released) {
+            on_released();
+        }
+    }
+
+    // RFC 9293 - Section 3.10.7.4, the fifth step. The acknowledgement is known not to be ahead of send.nxt.
+    void process_ack(const structs::TCP& tcp, const bool occupies_space) {
+        const auto ack = tcp.ack_num();
         if (state == State::SynRcvd) {
-            // Send message
-            ip.set_tcp_payload("Hello World!\n");
-            send_packet(ip);
-            state = State::WaitingForDataAck;
-        } else if (state == State::WaitingForDataAck) {
-            // Send fin
-            ip.set_tcp_payload("");
-            bool fin = tcp.fin;
-            tcp.fin = true;
-            send_packet(ip);
-            tcp.fin = fin;
-            state = State::WaitingForFinAck;
-        } else if (state == State::WaitingForFinAck) {
-            state = State::FinAcked;
-        } else if (state == State::FinAcked && !tcp.fin) {
-            tcp.psh = false;
-            ip.set_tcp_payload("");
-            // Send ack
-            send_packet(ip);
-        }
-    }
-
-    void process_new(structs::IPv4& ip) {
+            if (ack != send.nxt) return;
+            state = State::Estab;
+            set_established();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        // The peer is still there, even if it's not acknowledging anything new, as when its window is closed
+        timeouts = 0;
+        const auto in_flight = pipe();
+        const auto window = static_cast<uint32_t>(tcp.window_size()) << peer_window_shift;
+        const bool advanced = seq_lt(send.una, ack);
+        uint32_t acked = 0;
+        if (advanced) {
+            acked = ack - send.una;
+            send.una = ack;
+            duplicate_acks = 0;
+            // Kept within reach of the window, which they'd otherwise fall behind of once it moves 2^31 bytes past them
+            if (seq_lt(high_rxt, ack)) high_rxt = ack;
+            if (seq_lt(highest_sacked, ack)) highest_sacked = ack;
+            // Only the segments acknowledged as a whole. The rest of them are kept, and sent again as they are.
+            std::optional<SteadyTime> sent_at;
+            while (!retransmission_queue.empty() && seq_le(retransmission_queue.front().end, ack)) {
+                auto& segment = retransmission_queue.front();
+                if (segment.sacked) {
+                    // Counted as acknowledged when it was sacked
+                    sacked_bytes -= segment.end - segment.seq;
+                    acked -= segment.end - segment.seq;
+                }
+                // Karn's algorithm: it's unknown which of the transmissions of a segment an acknowledgement is for
+                sent_at = segment.retransmitted ? std::nullopt : std::optional { segment.sent_at };
+                retransmission_queue.pop_front();
+            }
+            if (sent_at) {
+                sample_rtt(now - *sent_at);
+                congestion.on_rtt_sample(now - *sent_at, now);
+            }
+            // RFC 6298 - Sections 5.2 and 5.3
+            if (send.una == send.nxt) {
+                retransmission_deadline = { };
+            } else {
+                arm_retransmission_timer(now);
+            }
+        } else if (ack == send.una && send.una != send.nxt && !occupies_space && window == send.wnd) {
+            // RFC 5681 - Section 2
+            duplicate_acks++;
+        }
+
+        // Only newer segments update the window
+        if (seq_lt(send.wl1, tcp.seq_num()) || (send.wl1 == tcp.seq_num() && seq_le(send.wl2, ack))) {
+            send.wnd = window;
+            max_send_window = std::max(max_send_window, window);
+            send.wl1 = tcp.seq_num();
+            send.wl2 = ack;
+        }
+
+        const bool fin_acked = fin_sent && ack == send.nxt;
+        if (state == State::FinWait1 && fin_acked) {
+            state = State::FinWait2;
+        } else if (state == State::Closing && fin_acked) {
+            set_time_wait();
+        } else if (state == State::LastAck && fin_acked) {
+            state = State::Closed;
+        }
+
+        if (sack_permitted) acked += mark_sacked(tcp);
+        // RFC 6582 - Section 3.2: the recovery ends once everything sent before it started is acknowledged
+        if (recovering && !seq_lt(send.una, recover)) recovering = false;
+        if (timeout_recovery && !seq_lt(send.una, recover)) timeout_recovery = false;
+        if (acked > 0) {
+            congestion.on_ack({ acked, in_flight, recovering, now });
+        }
+        // RFC 3168 - Section 6.1.2: the congestion echoed by the peer is responded to like a loss, once per window,
+        //  and the peer is told with cwr on the next new segment. It's ignored while a loss is being recovered from.
+        if (ecn && tcp.ece && !recovering && seq_lt(ecn_recover, send.una)) {
+            congestion.on_ecn(in_flight, now);
+            ecn_recover = send.nxt;
+            cwr_pending = true;
+        }
+        recover_losses(advanced, in_flight, now);
+        transmit();
+    }
+
+    // The bytes in flight, not counting the ones the peer has selectively acknowledged (RFC 6675 - Section 4)
+    [[nodiscard]] uint32_t pipe() const {
+        return send.nxt - send.una - sacked_bytes;
+    }
+
+    // RFC 6675 - Section 5: the segments covered by the blocks of the peer are marked on the scoreboard, and aren't
+    //  sent again. Only whole segments are marked, which the blocks don't split unless the segmentation is offloaded.
+    //  Returns the number of bytes newly marked.
+    uint32_t mark_sacked(const structs::TCP& tcp) {
+        std::array<structs::TCP::SackBlock, structs::TCP::MAX_SACK_BLOCKS> blocks;
+        const auto count = tcp.sack_option(blocks);
+        uint32_t marked = 0;
+        for (auto [begin, end] : std::span { blocks }.first(count)) {
+            // Anything outside of what's in flight is either stale or bogus
+            if (!seq_lt(begin, end) || !seq_lt(send.una, end) || seq_lt(send.nxt, end)) continue;
+            auto it = std::partition_point(retransmission_queue.begin(), retransmission_queue.end(), [&](auto& segment) {
+                return seq_le(segment.end, begin);
+            });
+            for (; it != retransmission_queue.end() && seq_le(it->end, end); ++it) {
+                if (it->sacked || seq_lt(it->seq, begin)) continue;
+                it->sacked = true;
+                marked += it->end - it->seq;
+                if (seq_lt(highest_sacked, it->end)) highest_sacked = it->end;
+            }
+        }
+        sacked_bytes += marked;
+        return marked;
+    }
+
+    // RFC 6582 - Section 3.2: the congestion control responds once per window of data, and
+    //  the recovery lasts until everything sent before it started is acknowledged
+    void enter_recovery(const uint32_t in_flight, const SteadyTime now) {
+        if (recovering) return;
+        recovering = true;
+        recover = send.nxt;
+        congestion.on_loss(in_flight, now);
+    }
+
+    // RFC 6675 - Section 4: a segment is taken as lost once more than DupThresh - 1 segments worth of bytes above it
+    //  are sacked, and only the lost segments are sent again, once each. Without sack, the segment at the start of the
+    //  window is sent again on the third duplicate acknowledgement instead (RFC 5681 - Section 3.2), and on each
+    //  acknowledgement of part of what was sent before the recovery started (RFC 6582 - Section 3.2).
+    void recover_losses(const bool advanced, const uint32_t in_flight, const SteadyTime now) {
+        if (retransmission_queue.empty()) return;
+        if (timeout_recovery) {
+            resend_after_timeout();
+            return;
+        }
+        if (!sack_permitted) {
+            if (recovering && advanced) {
+                retransmit(retransmission_queue.front());
+            } else if (!recovering && duplicate_acks >= DupThresh) {
+                enter_recovery(in_flight, now);
+                retransmit(retransmission_queue.front());
+            }
+            return;
+        }
+        if (sacked_bytes == 0) return;
+
+        // Down from the highest segment sacked, until enough bytes above are sacked. Everything below is lost then.
+        const size_t threshold = (DupThresh - 1) * size_t { peer_mss };
+        auto highest = std::partition_point(retransmission_queue.begin(), retransmission_queue.end(), [&](auto& segment) {
+            return seq_lt(segment.end, highest_sacked);
+        });
+        if (highest == retransmission_queue.end()) return;
+        auto lost_end = retransmission_queue.begin();
+        size_t sacked_above = 0;
+        for (auto it = std::make_reverse_iterator(highest + 1); it != retransmission_queue.rend(); ++it) {
+            if (sacked_above > threshold) {
+                lost_end = it.base();
+                break;
+            }
+            if (it->sacked) sacked_above += it->end - it->seq;
+        }
+
+        // The ones below high_rxt are sent again already
+        auto it = std::partition_point(retransmission_queue.begin(), lost_end, [&](auto& segment) {
+            return seq_le(segment.end, high_rxt);
+        });
+        for (; it != lost_end; ++it) {
+            if (!it->sacked && !it->resent) {
+                enter_recovery(in_flight, now);
+                retransmit(*it);
+            }
+            high_rxt = it->end;
+        }
+    }
+
+    // RFC 5681 - Section 3.1: after a timeout, everything that was in flight is sent again in order, as much
+    //  at a time as the congestion window allows while it grows back. The segments sacked since are skipped.
+    void resend_after_timeout() {
+        const size_t window = congestion.window();
+        size_t resent = 0;
+        for (auto& segment : retransmission_queue) {
+            if (!seq_lt(segment.seq, recover) || resent >= window) break;
+            if (segment.sacked) continue;
+            if (!segment.resent) retransmit(segment);
+            resent += segment.end - segment.seq;
+        }
+    }
+
+    // RFC 6298 - Section 2
+    void sample_rtt(const std::chrono::nanoseconds rtt) {
+        if (smoothed_rtt == std::chrono::nanoseconds::zero()) {
+            smoothed_rtt = rtt;
+            rtt_variance = rtt / 2;
+        } else {
+            rtt_variance = (3 * rtt_variance + std::chrono::abs(smoothed_rtt - rtt)) / 4;
+            smoothed_rtt = (7 * smoothed_rtt + rtt) / 8;
+        }
+        const std::chrono::nanoseconds min_rto = options.min_rto;
+        rto = std::clamp(smoothed_rtt + std::max(ClockGranularity, 4 * rtt_variance), min_rto, MaxRto);
+        // RFC 6298 - Section 5.7
+        backoff = 0;
+    }
+
+    [[nodiscard]] bool timer_running() const {
+        return retransmission_deadline != SteadyTime { };
+    }
+
+    // RFC 6298 - Section 5. Re-arming the timer only moves its deadline. The interface is asked for a timer only
+    //  when none is due by then, so re-arming it on every acknowledgement takes neither an allocation nor a lock.
+    //  The timer that's due early finds the deadline moved when it fires, and asks for another one.
+    void arm_retransmission_timer(const SteadyTime now) {
+        retransmission_deadline = now + std::min(rto * (1 << backoff), MaxRto);
+        schedule_timer(retransmission_deadline);
+    }
+
+    void schedule_timer(const SteadyTime time) {
+        if (timer_scheduled && timer_scheduled_for <= time) return;
+        timer_scheduled = true;
+        timer_scheduled_for = time;
+        if (on_schedule_timer) on_schedule_timer(time);
+    }
+
+    // RFC 9293 - Section 3.8.6.1: a closed window is probed, in case the update reopening it is lost. The probe
+    //  is an empty segment at snd.una - 1, which the peer acknowledges with its window as it would a duplicate.
+    //  Unlike a byte past the window, it doesn't occupy any sequence space, so nothing is sent out of order
+    //  behind it once the window reopens.
+    void send_window_probe() {
+        structs::IPv4& probe = new_segment();
+        auto& tcp = probe.tcp_payload();
+        tcp.ack = true;
+        tcp.set_seq_num(send.una - 1);
+        stamp_segment(probe);
+        auto buffer = reinterpret_cast<PacketBuffer>(&probe);
+        if (!send_queue.push(buffer)) {
+            PacketAllocator{}.deallocate(buffer);
+        }
+    }
+
+    // RFC 6298 - Sections 5.4 to 5.6
+    void process_timeout(const SteadyTime now) {
+        if (retransmission_queue.empty()) {
+            retransmission_deadline = { };
+            if (unsent.empty() || (state != State::Estab && state != State::CloseWait)) return;
+            if (send.wnd == 0) {
+                // Probed again, with the timeout backed off, until the window reopens
+                send_window_probe();
+                backoff = std::min(backoff + 1, MaxTimeouts);
+                arm_retransmission_timer(now);
+            } else {
+                // Held back by the silly window syndrome avoidance for too long
+                sws_override = true;
+                transmit();
+                sws_override = false;
+            }
+            return;
+        }
+        // RFC 9293 - Section 3.8.3: the peer is given up on
+        if (++timeouts > MaxTimeouts) {
+            set_closed();
+            return;
+        }
+        backoff = std::min(backoff + 1, MaxTimeouts);
+        if (send.wnd == 0) {
+            // The window is closed, or not known yet. Either way, the segment is only probing, and
+            //  its timeout says nothing about the congestion.
+            retransmit(retransmission_queue.front());
+        } else {
+            congestion.on_timeout(pipe(), now);
+            // RFC 2018 - Section 8: the peer may have dropped what it sacked, so the scoreboard is started over
+            for (auto& segment : retransmission_queue) {
+                segment.sacked = false;
+                segment.resent = false;
+            }
+            sacked_bytes = 0;
+            high_rxt = send.una;
+            duplicate_acks = 0;
+            recovering = false;
+            timeout_recovery = true;
+            recover = send.nxt;
+            resend_after_timeout();
+        }
+        arm_retransmission_timer(now);
+    }
+
+    [[nodiscard]] static uint8_t* payload_of(structs::IPv4& ip) {
+        return &ip.extract<uint8_t>(ip.payload_offset() + ip.tcp_payload().payload_offset());
+    }
+
+    // Of the segments built by new_segment() without any options
+    [[nodiscard]] static size_t payload_size(const structs::IPv4& ip) {
+        return ip.total_len() - HeadersSize;
+    }
+
+    // The payload the unsent segments are filled up to as they're written. Bigger segments are handed to the device
+    //  to split when it offloads the segmentation. Otherwise, it's the MSS of the peer, or ours until the handshake.
+    [[nodiscard]] size_t segment_size_limit() const {
+        if (options.segmentation_offload) return MaxOffloadedSegment;
+        const bool handshake_done = state != State::New && state != State::SynSent && state != State::SynRcvd;
+        return handshake_done ? peer_mss : LocalMSS;
+    }
+
+    // The room left for the payload of an unsent segment, bounded by its buffer, and by the segment size
+    [[nodiscard]] size_t unsent_room(const PacketHandle& segment) const {
+        const auto payload = payload_size(structs::IPv4::from_ptr(segment.get()));
+        const auto limit = std::min(PacketAllocator::capacity(segment.get()) - HeadersSize, segment_size_limit());
+        return limit > payload ? limit - payload : 0;
+    }
+
+    // Copies as much of the bytes as fits into the last unsent segment, or into a new one if it's full. This is the
+    //  only copy of the bytes on the way out: the segment is sent as it is, and kept as it is for retransmission.
+    //  Returns the number of bytes taken, which is never zero.
+    size_t append_unsent(const std::span<const uint8_t> bytes) {
+        if (unsent.empty() || unsent_room(unsent.back()) == 0) {
+            // At least a regular buffer, so that the small writes that follow are coalesced into it
+            const auto limit = segment_size_limit();
+            const auto capacity = std::max(
+                std::min(bytes.size(), limit),
+                std::min(limit, PacketAllocator::RegularCapacity - HeadersSize)
+            );
+            structs::IPv4& segment = new_segment(capacity);
+            segment.set_total_len(static_cast<uint16_t>(HeadersSize));
+            unsent.emplace_back(reinterpret_cast<PacketBuffer>(&segment));
+        }
+        auto& segment = structs::IPv4::from_ptr(unsent.back().get());
+        const auto payload = payload_size(segment);
+        const auto count = std::min(bytes.size(), unsent_room(unsent.back()));
+        std::copy_n(bytes.data(), count, payload_of(segment) + payload);
+        segment.set_total_len(static_cast<uint16_t>(HeadersSize + payload + count));
+        unsent_bytes += count;
+        return count;
+    }
+
+    // Leaves the first count bytes of the payload in the first unsent segment, and moves the rest to a new segment
+    //  right behind it. The only copy past append_unsent(), for when the peer can't take a whole segment.
+    void split_unsent(const size_t count) {
+        auto& segment = structs::IPv4::from_ptr(unsent.front().get());
+        const auto rest = payload_size(segment) - count;
+        structs::IPv4& tail = new_segment(rest);
+        std::copy_n(payload_of(segment) + count, rest, payload_of(tail));
+        segment.set_total_len(static_cast<uint16_t>(HeadersSize + count));
+        unsent.emplace(unsent.begin() + 1, reinterpret_cast<PacketBuffer>(&tail));
+    }
+
+    // Sends as many of the unsent segments as the window of the peer allows, then sends the fin once everything
+    //  is sent, if the application has closed its side. The segments are kept in the retransmission queue until
+    //  they're acknowledged. Called with the lock held.
+    void transmit() {
+        // Whatever the send queue refused goes before anything new
+        resend_dropped();
+        if (state != State::Estab && state != State::CloseWait) return;
+
+        const size_t max_segment = options.segmentation_offload ? MaxOffloadedSegment : peer_mss;
+        while (!unsent.empty()) {
+            const size_t in_flight = send.nxt - send.una;
+            const size_t window = send.wnd > in_flight ? send.wnd - in_flight : 0;
+            // The congestion window doesn't count the bytes the peer has selectively acknowledged
+            const size_t pipe_size = pipe();
+            const size_t congestion_window = congestion.window();
+            const size_t congestion_room = congestion_window > pipe_size ? congestion_window - pipe_size : 0;
+            const size_t payload = payload_size(structs::IPv4::from_ptr(unsent.front().get()));
+            const auto count = std::min({ payload, window, congestion_room, max_segment });
+            if (count == 0) break;
+            // Rather than a small segment, the congestion window waits for room for a whole one
+            if (count < std::min<size_t>(payload, peer_mss) && congestion_room < window) break;
+            // RFC 9293 - Section 3.8.6.2.1: nor is a small piece of a segment sent into a small window, unless it's half
+            //  the largest window the peer has offered. Once nothing is in flight to bring an update of the window,
+            //  the piece is sent on a timeout anyway. A whole segment is sent as it is, since it's either full, or
+            //  the last of what the application has written.
+            if (count < payload && count < peer_mss && count < max_send_window / 2 && !sws_override) {
+                if (send.nxt == send.una && !timer_running()) {
+                    arm_retransmission_timer(std::chrono::steady_clock::now());
+                }
+                break;
+            }
+            if (count < payload) split_unsent(count);
+
+            auto& segment = structs::IPv4::from_ptr(unsent.front().release());
+            unsent.pop_front();
+            unsent_bytes -= count;
+            auto& tcp = segment.tcp_payload();
+            tcp.ack = true;
+            tcp.psh = unsent.empty();
+            if (ecn) {
+                segment.tos |= structs::IPv4::ECN_ECT0;
+                tcp.cwr = std::exchange(cwr_pending, false);
+            }
+            if (count > peer_mss) {
+                PacketAllocator::metadata(reinterpret_cast<PacketBuffer>(&segment)).gso_size = peer_mss;
+            }
+            send_segment(segment);
+        }
+        // Nothing is in flight to be acknowledged with a window update, so the closed window is probed on a timeout
+        if (send.wnd == 0 && !unsent.empty() && !timer_running()) {
+            arm_retransmission_timer(std::chrono::steady_clock::now());
+        }
+
+        if (close_requested && !fin_sent && unsent.empty()) {
+            auto& fin = new_segment();
+            fin.tcp_payload().ack = true;
+            fin.tcp_payload().fin = true;
+            fin_sent = true;
+            send_segment(fin);
+            state = state == State::Estab ? State::FinWait1 : State::LastAck;
+        }
+    }
+
+    // Hands the payload to the application: copies as much of it as there's room for, or loans it
+    //  in place in the zero-copy mode, in which case the buffer is taken off the handle, and held
+    //  until the application releases it. Returns the number of bytes taken, which is all or
+    //  nothing in the zero-copy mode. Called with the lock held.
+    size_t deliver(PacketHandle& packet, const size_t offset, const size_t length) {
+        if (options.zero_copy_receive) {
+            if (!received_segments.push(ReceivedSegment { packet.get(), static_cast<uint32_t>(offset), static_cast<uint32_t>(length) })) {
+                return 0;
+            }
+            // The application may have released the buffer already, so it must not be touched anymore
+            (void)packet.release();
+            return length;
+        }
+        return receive_buffer.write({ packet.get() + offset, length });
+    }
+
+    // Delivers the segments held in the reassembly queue that the bytes just received have put in
+    //  order, up to the next hole, all at once. Returns whether the fin of the peer is among them.
+    bool deliver_queued() {
+        while (auto segment = out_of_order.front()) {
+            if (seq_lt(receive.nxt, segment->seq)) break;
+            // The start of the segment may overlap the bytes just received
+            const size_t skip = receive.nxt - segment->seq;
+            const size_t length = segment->end - segment->seq;
+            if (skip < length) {
+                const auto accepted = deliver(segment->packet, segment->offset + skip, length - skip);
+                receive.nxt += static_cast<uint32_t>(accepted);
+                if (accepted < length - skip) {
+                    // No room for the rest of it. It's delivered once the hole in front of it is filled again.
+                    segment->offset = static_cast<uint16_t>(segment->offset + skip + accepted);
+                    segment->seq = receive.nxt;
+                    return false;
+                }
+            }
+            const bool fin = segment->fin;
+            out_of_order.pop_front();
+            if (fin) return true;
+        }
+        return false;
+    }
+
+    // RFC 9293 - Section 3.8.6.2.2. Called by the application once it frees room for received data. Once the
+    //  window can grow by a segment (or by half of the buffer if smaller), the peer is told right away, since it
+    //  won't send anything to be acknowledged while the window it knows of is closed.
+    void update_window() {
+        const size_t space = options.zero_copy_receive ?
+            (SegmentsCapacity - received_segments.size()) * LocalMSS :
+            receive_buffer.capacity() - receive_buffer.size();
+        const size_t threshold = std::min<size_t>(receive_capacity() / 2, LocalMSS);
+        if (space < advertised_window.load(std::memory_order_relaxed) + threshold) return;
+        std::lock_guard lock(m);
+        if (state == State::Estab || state == State::FinWait1 || state == State::FinWait2) {
+            send_ack();
+        }
+    }
+
+    void process_new(const structs::IPv4& ip) {
         auto& tcp = ip.tcp_payload();
         // Ignore any non-syn packet for new connections
         if (tcp.syn != true) return;
         process_syn(ip);
     }
 
+    void process_syn_sent(const structs::IPv4& ip) {
+        auto& tcp = ip.tcp_payload();
+        // Only a syn-ack that acknowledges our syn completes the handshake
+        if (!tcp.syn || !tcp.ack || tcp.ack_num() != send.nxt) return;
+
+        send.una = tcp.ack_num();
+        initialize_peer(tcp);
+        // The syn is done with
+        retransmission_queue.clear();
+        retransmission_deadline = { };
+
+        send_ack();
+
+        state = State::Estab;
+        set_established();
+        // Whatever the application has written meanwhile
+        transmit();
+    }
+
 public:
 
+    // The sender of the queue parks while it's empty
+    using SendQueue = WaitableQueue<MPSCBoundedQueue<PacketBuffer, SendQueueCapacity>>;
+
     const ConnectionID id;
 
     TCPConnection(TCPConnection&) = delete;
@@ -168,89 +921,379 @@ public:
         return lhs.id <=> rhs.id;
     }
 
+    // on_released is called once both the connection is closed and the application has called close(). on_schedule_timer
+    //  asks for process_timer() to be called at the given time, or soon after. Without it, nothing is ever retransmitted.
     explicit TCPConnection(
         const ConnectionID id,
-        MPSCBoundedQueue<PacketBuffer, ConnectionBufferSize>& send_queue
-    ) : id(id), send_queue(send_queue)
+        SendQueue& send_queue,
+        const ConnectionOptions options_ = { },
+        std::function<void()> on_released_ = { },
+        std::function<void(SteadyTime)> on_schedule_timer_ = { }
+    ) : id(id), send_queue(send_queue), options(options_),
+        receive_buffer(options_.buffer_size, options_.mirrored_buffers),
+        on_released(std::move(on_released_)),
+        on_schedule_timer(std::move(on_schedule_timer_))
     { }
 
-    void process_packet(uint8_t* packet) {
-        auto& ip = structs::IPv4::from_ptr(packet);
-
-        swapped = false;
+    // Actively opens the connection by sending a syn. The rest of the handshake is
+    //  carried out by the handler thread, which sets connection_established once it's done.
+    void open() {
+        std::lock_guard lock(m);
+        assert(state == State::New);
+        initialize_send_space();
+        state = State::SynSent;
+        auto& syn = new_syn_segment(true, true);
+        syn.tcp_payload().ece = options.ecn;
+        syn.tcp_payload().cwr = options.ecn;
+        send_segment(syn);
+    }
 
+    // Takes the ownership of the buffer of the packet
+    void process_packet(uint8_t* buffer) {
+        std::lock_guard lock(m);
+        // Freed on the way out, unless it's kept
+        PacketHandle packet { buffer };
+        auto& ip = structs::IPv4::from_ptr(buffer);
         auto& tcp = ip.tcp_payload();
-        // TODO perform the actual checks
-        if (tcp.ack == true && (tcp.ack_num() < send.nxt || tcp.seq_num() < receive.nxt)) {
+
+        if (state == State::New || state == State::SynSent || state == State::Closed) {
+            if (state == State::New) process_new(ip);
+            else if (state == State::SynSent) process_syn_sent(ip);
+            return;
+        }
+
+        // RFC 3168 - Section 6.1.3: a congestion mark is echoed back until the peer says it has responded to it
+        if (ecn) {
+            if (tcp.cwr) ece_pending = false;
+            if ((ip.tos & structs::IPv4::ECN_MASK) == structs::IPv4::ECN_CE) ece_pending = true;
+        }
+
+        size_t offset = ip.payload_offset() + tcp.payload_offset();
+        size_t payload_len = ip.total_len() - offset;
+        uint32_t seq = tcp.seq_num();
+        // Taken before the buffer is possibly handed to the application
+        const bool fin = tcp.fin;
+        const bool occupies_space = payload_len > 0 || tcp.syn || fin;
+
+        // Every segment past the handshake carries an acknowledgement, which can't be ahead of what's sent.
+        //  Whatever is dropped is responded to with an acknowledgement if it occupies sequence space, to
+        //  let the peer know what's expected.
+        if (!tcp.ack || seq_lt(send.nxt, tcp.ack_num())) {
+            if (occupies_space) send_ack();
+            return;
+        }
+
+        // The acknowledgement goes first, since it may move the connection out of SynRcvd. It's taken even
+        //  from a segment that's received already, which may carry one that's newer than the rest.
+        process_ack(tcp, occupies_space);
+
+        // The part of a retransmitted segment that's received already is trimmed off
+        if (seq_lt(seq, receive.nxt)) {
+            const size_t duplicate = receive.nxt - seq;
+            if (duplicate > payload_len || (duplicate == payload_len && !fin)) {
+                // Not acceptable, even if empty, which is answered with an acknowledgement (RFC 9293 - Section 3.10.7.4).
+                //  This is what the window probes rely on.
+                send_ack();
+                if (state == State::TimeWait && fin) set_time_wait();
+                if (state == State::Closed) set_closed();
+                return;
+            }
+            offset += duplicate;
+            payload_len -= duplicate;
+            seq = receive.nxt;
+        }
+
+        const bool receiving = state == State::Estab || state == State::FinWait1 || state == State::FinWait2;
+        if (seq != receive.nxt) {
+            // Ahead of a hole. Held until the hole is filled, as long as it's within the window.
+            const bool in_window = seq_le(seq + static_cast<uint32_t>(payload_len), receive.nxt + receive.wnd);
+            if (receiving && occupies_space && in_window && out_of_order.insert(buffer, offset, seq, payload_len, fin)) {
+                (void)packet.release();
+                last_out_of_order = seq;
+            }
+            // A duplicate acknowledgement, which tells the peer where the hole is (RFC 5681 - Section 4.2)
+            if (occupies_space) send_ack();
             return;
         }
 
-        if (state == State::New) {
-            return process_new(ip);
+        size_t accepted = 0;
+        if (payload_len > 0 && receiving) {
+            accepted = deliver(packet, offset, payload_len);
+            receive.nxt += static_cast<uint32_t>(accepted);
         }
 
-        // TODO use receive and send windows
-        auto offset = ip.payload_offset() + tcp.payload_offset();
-        auto payload_len = ip.total_len() - offset;
-        auto payload = &ip.extract<uint8_t>(offset);
-        for (size_t i = 0; i < payload_len; i++) {
-            auto pushed = receive_buffer.push(payload[i]);
-            assert(pushed);
+        // The fin comes after the whole payload
+        bool fin_received = fin && state != State::SynRcvd && accepted == payload_len;
+        if (accepted == payload_len && !fin) {
+            fin_received = deliver_queued();
+        }
+        if (fin_received) {
+            receive.nxt += 1;
+            process_fin();
         }
 
-        receive.nxt += payload_len + (tcp.syn | tcp.fin);
+        // Unless the data or the fin are acknowledged by the segments just sent. Whatever
+        //  is left out for lack of room is acknowledged as well, along with the window.
+        if (acknowledged != receive.nxt || accepted < payload_len) {
+            send_ack();
+        }
 
-        if (tcp.ack == true) {
-            process_ack(ip);
+        if (state == State::Closed) {
+            set_closed();
         }
+    }
 
-        if (tcp.fin == true) {
-            process_fin(ip);
+    // Called by the timer asked for through on_schedule_timer, possibly late, and possibly after
+    //  the timer is re-armed or stopped, in which case it's either scheduled again or ignored
+    void process_timer() {
+        std::lock_guard lock(m);
+        const auto now = std::chrono::steady_clock::now();
+        // Another one is due, or this one is taken care of already
+        if (!timer_scheduled || now < timer_scheduled_for) return;
+        timer_scheduled = false;
+        resend_dropped();
+        if (state == State::TimeWait) {
+            if (now < time_wait_deadline) schedule_timer(time_wait_deadline);
+            else set_closed();
+            return;
         }
+        if (!timer_running() || state == State::Closed) return;
+        if (now < retransmission_deadline) {
+            schedule_timer(retransmission_deadline);
+            return;
+        }
+        process_timeout(now);
+    }
+
+    // Copies as many of the bytes as there's room for in the send buffer straight into the segments, then sends
+    //  as many of them as the window of the peer allows. The rest are sent as acknowledgements arrive. Returns the
+    //  number of bytes taken, which is less than asked once the buffer is full. The bytes are copied with the lock
+    //  held, since the handler may send the segments they go into as soon as there's room for them.
+    size_t write(const std::span<const uint8_t> bytes) {
+        std::lock_guard lock(m);
+        size_t written = 0;
+        while (written < bytes.size() && unsent_bytes < options.buffer_size) {
+            const auto count = std::min(bytes.size() - written, options.buffer_size - unsent_bytes);
+            written += append_unsent(bytes.subspan(written, count));
+        }
+        transmit();
+        return written;
+    }
 
-        ReusableAllocator{}.deallocate(packet);
+    size_t write(const std::string_view bytes) {
+        return write({ reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size() });
     }
 
+    // Copies the received bytes into the buffer. Works in both the copying and the zero-copy modes.
     [[nodiscard]] size_t read(std::span<uint8_t> buffer) {
-        // TODO change this
-        size_t bytes_read = 0;
-        for (uint8_t& b : buffer) {
-            auto val = receive_buffer.pop();
-            if (!val.has_value()) break;
-            b = val.value();
-            bytes_read++;
+        if (options.zero_copy_receive) {
+            size_t bytes_read = 0;
+            while (bytes_read < buffer.size()) {
+                if (partially_read.empty()) {
+                    auto view = receive_payload();
+                    if (!view.has_value()) break;
+                    partially_read = std::move(view.value());
+                }
+                auto data = partially_read.data();
+                auto count = std::min(data.size(), buffer.size() - bytes_read);
+                std::copy_n(data.data(), count, buffer.data() + bytes_read);
+                partially_read.remove_prefix(count);
+                bytes_read += count;
+                if (partially_read.empty()) partially_read.release();
+            }
+            return bytes_read;
         }
+
+        auto bytes_read = receive_buffer.read(buffer);
+        if (bytes_read > 0) update_window();
         return bytes_read;
     }
 
+    // Only in the copying mode. The received bytes, in place, without copying them out. They
+    //  remain valid until they're released with consume(). Mixing this with read() is fine.
+    [[nodiscard]] ByteRing::Regions received_regions() {
+        assert(!options.zero_copy_receive);
+        return receive_buffer.readable_regions();
+    }
+
+    void consume(const size_t count) {
+        receive_buffer.consume(count);
+        update_window();
+    }
+
+    // Only in the zero-copy mode. Returns the payload of the next received segment, in place.
+    // The buffer of the segment is held until the view is released (or destroyed).
+    // Mixing this with read() skips the bytes of any segment partially consumed by read().
+    [[nodiscard]] std::optional<PayloadView> receive_payload() {
+        assert(options.zero_copy_receive);
+        auto segment = received_segments.pop();
+        if (!segment.has_value()) return std::nullopt;
+        update_window();
+        auto [packet, offset, length] = segment.value();
+        return PayloadView { packet, { packet + offset, length } };
+    }
+
+    // Closes our side once everything written is sent, then waits for the connection to close. The connection
+    //  must not be used by the application afterward, since it may be freed at any point after this returns.
     void close() {
-        // TODO change this?
+        {
+            std::lock_guard lock(m);
+            if (!close_requested) {
+                close_requested = true;
+                transmit();
+            }
+        }
         connection_closed.wait(false);
+        if (!closed_by_application.exchange(true)) {
+            release();
+        }
+    }
+
+    // Closes a connection that was never handed to the application, without a word to the peer. It's
+    //  not released afterward, but erased right away by whoever created it.
+    void abandon() {
+        std::lock_guard lock(m);
+        state = State::Closed;
+        connection_closed = true;
+        connection_closed.notify_all();
     }
 
     ~TCPConnection() noexcept {
-        close();
+        connection_closed.wait(false);
+        // Segments never taken by the application
+        while (auto segment = received_segments.pop()) {
+            PacketAllocator{}.deallocate(segment.value().packet);
+        }
     }
 
 private:
 
+    // The largest segment we accept, which fits a regular packet buffer, and the
+    //  default one of the peer (RFC 9293 - Section 3.7.1)
+    static constexpr uint16_t LocalMSS = 1460;
+    static constexpr uint16_t DefaultMSS = 536;
+    static constexpr size_t MaxUnscaledWindow = (1 << 16) - 1;
+    static constexpr size_t HeadersSize = sizeof(structs::IPv4) + sizeof(structs::TCP);
+    static_assert(HeadersSize == 40);
+    // The duplicate acknowledgements (or the segments worth of sacked bytes) that signal a loss (RFC 5681 - Section 2)
+    static constexpr uint32_t DupThresh = 3;
+    // With the segmentation offloaded, a segment is only bounded by the size of an IP packet
+    static constexpr size_t MaxOffloadedSegment = (1 << 16) - 1 - sizeof(structs::IPv4) - sizeof(structs::TCP);
+    // RFC 6298 - Section 2
+    static constexpr std::chrono::nanoseconds InitialRto = std::chrono::seconds(1);
+    static constexpr std::chrono::nanoseconds MaxRto = std::chrono::seconds(60);
+    static constexpr std::chrono::nanoseconds ClockGranularity = std::chrono::milliseconds(1);
+    // How soon the segments refused by a full send queue are pushed again
+    static constexpr std::chrono::nanoseconds QueueRetryDelay = std::chrono::milliseconds(1);
+    // The timeouts in a row before the connection is given up on, which takes about 15 minutes
+    //  with the timeout backed off (R2 of RFC 9293 - Section 3.8.3), as with the default of Linux
+    static constexpr uint32_t MaxTimeouts = 15;
+
+    // Guards the state and the sequence spaces, which both the handler
+    //  thread and the application (through write() and close()) act on
+    std::mutex m;
+
     State state = State::New;
     SendSequenceSpace send { };
     ReceiveSequenceSpace receive { };
+    uint16_t peer_mss = DefaultMSS;
+    // Set once both syns carry sack permitted
+    bool sack_permitted = false;
+    // The shift counts of the windows sent by the peer and by us, once window scaling is agreed on
+    bool window_scaling = false;
+    uint8_t peer_window_shift = 0;
+    uint8_t window_shift = 0;
+    // The window of the last segment sent. Read by the application to tell when to send a window update.
+    std::atomic<uint32_t> advertised_window = 0;
+    // The receive.nxt of the last segment sent, which acknowledged everything up to it
+    uint32_t acknowledged = 0;
+
+    // The queue of the shard of the interface, shared by its connections
+    SendQueue& send_queue;
+
+    const ConnectionOptions options;
+
+    ByteRing receive_buffer;
 
-    // TODO have a separate arg for the queue capacity
-    MPSCBoundedQueue<PacketBuffer, ConnectionBufferSize>& send_queue;
+    // The send buffer: the segments the application has written, in place, that aren't sent yet.
+    //  Their payload is bounded by the buffer size.
+    std::deque<PacketHandle> unsent;
+    size_t unsent_bytes = 0;
+
+    // Doubles as the scoreboard of RFC 6675, along with the counters below
+    std::deque<SentSegment> retransmission_queue;
+    uint32_t sacked_bytes = 0;
+    // The end of the highest segment sacked, and of the highest one sent again during the recovery
+    uint32_t highest_sacked = 0;
+    uint32_t high_rxt = 0;
+    uint32_t duplicate_acks = 0;
+    // Set from the detection of a loss until everything sent before it is acknowledged, which is up to recover
+    bool recovering = false;
+    uint32_t recover = 0;
+
+    // Set from a timeout until everything that was in flight is acknowledged, which is up to recover as well
+    bool timeout_recovery = false;
+
+    // RFC 6298 - Section 2. The smoothed round-trip time is zero until the first sample.
+    std::chrono::nanoseconds smoothed_rtt { 0 };
+    std::chrono::nanoseconds rtt_variance { 0 };
+    std::chrono::nanoseconds rto = InitialRto;
+    // The timeout doubles on each expiration, until the next sample (RFC 6298 - Section 5.5)
+    uint32_t backoff = 0;
+    // The expirations since the peer last acknowledged anything
+    uint32_t timeouts = 0;
+    // The largest window the peer has offered, and whether what's held back in a small window is sent anyway
+    uint32_t max_send_window = 0;
+    bool sws_override = false;
+    // Set while any of the segments in the retransmission queue is marked as dropped
+    bool dropped_segments = false;
+    // Zero while the timer is stopped
+    SteadyTime retransmission_deadline { };
+    SteadyTime time_wait_deadline { };
+    // The earliest of the timers asked of the interface that's still due, if any
+    bool timer_scheduled = false;
+    SteadyTime timer_scheduled_for { };
+
+    Controller congestion { DefaultMSS };
+    // Set once both syns agree on ECN. The peer is told of the congestion marks on the segments received with
+    //  ece until it responds with cwr, and it's told with cwr in turn once its ece is responded to.
+    bool ecn = false;
+    bool ece_pending = false;
+    bool cwr_pending = false;
+    // The ece of the peer is responded to again only once everything sent up to here is acknowledged
+    uint32_t ecn_recover = 0;
+    bool close_requested = false;
+    bool fin_sent = false;
+
+    // Used instead of the receive buffer in the zero-copy mode. This bounds the
+    //  number of buffers the application can hold on to through a connection.
+    static constexpr std::size_t SegmentsCapacity = 1 << 8;
+    struct ReceivedSegment {
+        PacketBuffer packet;
+        // Where the payload starts in the buffer, which is past the part of it that was received already
+        uint32_t offset;
+        uint32_t length;
+    };
+    SPSCBoundedWaitFreeQueue<ReceivedSegment, SegmentsCapacity> received_segments;
 
-    // TODO delete this
-    bool swapped = false;
+    // The segments received out of order, held until the ones in front of them arrive
+    ReassemblyQueue out_of_order;
+    // The last one of them, whose block goes first in the sack option
+    uint32_t last_out_of_order = 0;
+    // Exclusive to the reading thread
+    PayloadView partially_read;
 
-    // TODO change this
-    static constexpr std::size_t BufferSize =  1 << 16;
-    SPSCBoundedWaitFreeQueue<uint8_t, BufferSize> receive_buffer;
+    std::function<void()> on_released;
+    std::function<void(SteadyTime)> on_schedule_timer;
+    std::atomic<int> pending_releases = 2;
+    std::atomic<bool> closed_by_application = false;
 
 public:
 
     // TODO delete this?
+    std::atomic<bool> connection_established = false;
+    // Set once the peer has closed its side. Nothing is received afterward.
+    std::atomic<bool> peer_closed = false;
     std::atomic<bool> connection_closed = false;
 };
 
@@ -1,40 +1,143 @@
 #pragma once
 
+#include <array>
+#include <mutex>
+#include <memory>
 #include <thread>
+#include <vector>
 #include <functional>
+#include <stdexcept>
 
 #include <tcpp/TypeDefs.hpp>
 #include <tcpp/TunDevice.hpp>
+#include <tcpp/LinkDevice.hpp>
+#include <tcpp/PcapCapture.hpp>
 #include <tcpp/TCPListener.hpp>
 #include <tcpp/TimersManager.hpp>
 #include <tcpp/utils/Connections.hpp>
-#include <tcpp/data-structures/ConcurrentMap.hpp>
-#include <tcpp/allocators/ReusableSlabAllocator.hpp>
+#include <tcpp/utils/BatchStats.hpp>
+#include <tcpp/utils/WaitStrategy.hpp>
+#include <tcpp/utils/EpochReclaimer.hpp>
+#include <tcpp/data-structures/FlowTable.hpp>
+#include <tcpp/data-structures/PortDemux.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
 
 namespace tcpp {
 
-template <size_t ConnectionBufferSize = (1 << 20)>
-requires PowerOfTwo<ConnectionBufferSize>
+struct InterfaceOptions {
+    // The maximum number of packets a sender thread takes off
+    //  its send queue and submits to the device at once.
+    // A value of 1 sends the packets one by one.
+    size_t tx_batch_size = 32;
+
+    // Received segments are loaned to the application in place (through
+    //  TCPConnection::receive_payload()) instead of copying their payload.
+    bool zero_copy_receive = false;
+
+    // The receive buffers of the connections are mapped twice in a row, so that
+    //  the received bytes can always be read in place in a single piece
+    bool mirrored_buffers = false;
+
+    // Explicit congestion notification (RFC 3168) is negotiated with the peers
+    bool ecn = true;
+
+    // The lower bound of the retransmission timeouts of the connections
+    std::chrono::milliseconds min_rto { 200 };
+
+    // The capacity of the send and the receive buffers of each of the connections. The receive
+    //  buffer bounds the window advertised to the peers, and so the throughput of a connection.
+    size_t connection_buffer_size = 1 << 18;
+
+    // How long the connections this side closes first linger in TIME-WAIT, before their ids can be used again
+    std::chrono::milliseconds time_wait { 60000 };
+
+    // When set, every packet received or sent by the interface is recorded to it.
+    //  It must have at least as many queues as the device, and outlive the interface.
+    PcapCapture* capture = nullptr;
+
+    // How the sender and the handler threads wait while their queues are empty
+    WaitStrategy sender_wait = WaitStrategy::SpinPark;
+    WaitStrategy handler_wait = WaitStrategy::SpinPark;
+    // The number of empty polls before the wait strategies kick in
+    uint32_t spins_before_waiting = 1 << 10;
+
+    // The connections are kept in a table of a fixed size. Once
+    //  it's full, new connections are refused until the interface is
+    //  recreated. Rounded up to a power of two, 7/8 of which is usable.
+    size_t max_connections = 1 << 16;
+};
+
+// The interface runs on top of any link device, a TunDevice by default. All of its connections,
+//  whether accepted by its listeners or opened by connect(), use the same congestion control.
+//  SendQueueCapacity bounds the packets of each shard waiting to be sent by the device. The
+//  buffers of the connections are sized by the options instead.
+template <size_t SendQueueCapacity = (1 << 20), LinkDevice Device = TunDevice, CongestionControl Controller = NewReno>
+requires PowerOfTwo<SendQueueCapacity>
 class TCPInterface {
 
+    using Connection = TCPConnection<SendQueueCapacity, Controller>;
+    using Listener = TCPListener<SendQueueCapacity, Controller>;
+
 public:
 
-    explicit TCPInterface(TunDevice interface)
+    // One listener, handler, and sender thread is run for each of the queues of the device
+    explicit TCPInterface(Device interface, const InterfaceOptions options_ = { })
         : interface(std::move(interface)),
-          sender_thread(&TCPInterface::sender, this, stop_source.get_token()),
-          handler_thread(&TCPInterface::packets_handler, this, stop_source.get_token()),
-          listener_thread(&TCPInterface::listener, this, stop_source.get_token())
-    { }
-
-    // TODO accept the size argument as a template parameter when the map is replaced
-    TCPListener<ConnectionBufferSize>& bind(const Endpoint endpoint) {
-        auto[it, inserted] = port_listeners.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(endpoint),
-            std::forward_as_tuple(endpoint, send_queue, port_listeners)
+          options(options_),
+          shards(this->interface.queues_count()),
+          reclaimer(2 * shards.size() + 1),
+          connections(reclaimer, options.max_connections),
+          port_listeners(reclaimer),
+          timers(options.max_connections)
+    {
+        if (options.tx_batch_size == 0) {
+            throw std::invalid_argument("The transmit batch size must be at least 1");
+        }
+        if (options.capture != nullptr && options.capture->queues_count() < shards.size()) {
+            throw std::invalid_argument("The capture has fewer queues than the device");
+        }
+
+        auto token = stop_source.get_token();
+        threads.reserve(3 * shards.size());
+        for (size_t i = 0; i < shards.size(); i++) {
+            threads.emplace_back(&TCPInterface::sender, this, token, i);
+            threads.emplace_back(&TCPInterface::packets_handler, this, token, i);
+            threads.emplace_back(&TCPInterface::listener, this, token, i);
+        }
+    }
+
+    // Binding to AnyAddress accepts the connections to the port on
+    //  any address that doesn't have a listener of its own
+    Listener& bind(const Endpoint endpoint) {
+        auto listener = port_listeners.bind(endpoint, endpoint, listener_closer(endpoint));
+        if (listener == nullptr) {
+            throw std::invalid_argument("The endpoint is already bound");
+        }
+        return *listener;
+    }
+
+    // Actively opens a connection from the local endpoint to the remote one. This doesn't wait
+    //  for the handshake, which completes once the connection_established flag of the connection is set.
+    Connection& connect(const Endpoint local, const Endpoint remote) {
+        // The id is in terms of the received packets
+        ConnectionID id { remote.ip, local.ip, remote.port, local.port };
+        auto [connection, inserted] = connections.emplace(
+            id, id, shards[shard_of(id)].send_queue, connection_options(), releaser(id), timer_scheduler(id)
         );
-        assert(inserted);
-        return it->second;
+        if (!inserted) {
+            throw std::invalid_argument("The connection already exists (or the interface is closing or full)");
+        }
+        connection->open();
+        return *connection;
+    }
+
+    // The sizes of the batches submitted to the device by the senders of all the queues
+    [[nodiscard]] BatchStats tx_batch_stats() const {
+        BatchStats result;
+        for (auto& shard : shards) {
+            result += shard.tx_batches.snapshot();
+        }
+        return result;
     }
 
     ~TCPInterface() noexcept {
@@ -42,151 +145,272 @@ public:
         // Before anything, give connections a chance to close. They
         // might need to send or receive some data before termination
         connections.set_read_only();  // Nothing is inserted or deleted
-        auto it = connections.begin();
-        auto end = connections.end();
-        while (it != end) {
-            it->second.close();
-            ++it;
-        }
+        connections.for_each([](const ConnectionID&, Connection& connection) {
+            connection.close();
+        });
         // Need to close it before the destruction of the listener thread.
         // Otherwise, the listener will remain blocked in the `receive` call.
         interface.close();
         (void)stop_source.request_stop();
+        // The parked threads only notice the stop once they're woken up
+        for (auto& shard : shards) {
+            shard.send_queue.parking_spot().wake();
+            shard.received_packets.parking_spot().wake();
+        }
     }
 
 private:
 
-    void listener(std::stop_token token) {
-        ReusableAllocator allocator;
+    // The consumers of both of the queues of a shard park while they're empty
+    using PacketsQueue = typename Connection::SendQueue;
+
+    // Each connection is pinned to one of the shards by the hash of its id. All of
+    //  its packets are processed by the handler of that shard, and all of its replies
+    //  are sent through the queue of the device with the same index. This keeps the
+    //  packets of the same flow in order while different flows proceed in parallel.
+    struct Shard {
+        PacketsQueue send_queue;
+        // Pushed to by the listeners of all the queues
+        PacketsQueue received_packets;
+        // Recorded by the sender of this shard
+        BatchStatsRecorder tx_batches;
+    };
+
+    ConnectionOptions connection_options() const {
+        return {
+            .checksum_offload = interface.offloads_enabled(),
+            .segmentation_offload = interface.offloads_enabled(),
+            .zero_copy_receive = options.zero_copy_receive,
+            .mirrored_buffers = options.mirrored_buffers,
+            .ecn = options.ecn,
+            .min_rto = options.min_rto,
+            .buffer_size = options.connection_buffer_size,
+            .time_wait = options.time_wait,
+        };
+    }
+
+    // Once both the connection is closed and the application is done with it, it's unlinked right away,
+    //  and freed once none of the listeners and handlers can be holding it anymore
+    std::function<void()> releaser(const ConnectionID id) {
+        return [this, id] { connections.erase(id); };
+    }
+
+    // A listener thread may be using the listener as it's closed, and an accepting thread may be waiting in it,
+    //  neither of which is a reader of the reclaimer. So the closed listeners are kept until the interface is destroyed.
+    std::function<void()> listener_closer(const Endpoint endpoint) {
+        return [this, endpoint] {
+            auto listener = port_listeners.detach(endpoint);
+            std::lock_guard lock(closed_listeners_mutex);
+            closed_listeners.push_back(std::move(listener));
+        };
+    }
+
+    // The timers are shared by all the connections, and refer to them by their ids, since
+    //  a connection may be released and freed by the time its timer fires
+    struct ConnectionTimer {
+        TCPInterface* interface;
+        ConnectionID id;
+
+        void operator()() const {
+            interface->process_timer(id);
+        }
+    };
+
+    std::function<void(SteadyTime)> timer_scheduler(const ConnectionID id) {
+        return [this, id](const SteadyTime time) { timers.addTimer({ time, ConnectionTimer { this, id } }); };
+    }
+
+    void process_timer(const ConnectionID id) {
+        {
+            auto guard = reclaimer.pin(timers_reader());
+            auto connection = connections.find(id);
+            if (connection == nullptr) return;
+            connection->process_timer();
+        }
+        reclaimer.collect();
+    }
+
+    // The reader indices of the listener and the handler of the queue, and of the timers, in the reclaimer
+    size_t listener_reader(const size_t queue) const { return queue; }
+    size_t handler_reader(const size_t queue) const { return shards.size() + queue; }
+    size_t timers_reader() const { return 2 * shards.size(); }
+
+    // The maximum number of packets a handler takes off its queue at once
+    static constexpr size_t HandlerBurstSize = 32;
+
+    size_t shard_of(const ConnectionID& id) const {
+        return std::hash<ConnectionID>{}(id) % shards.size();
+    }
+
+    void listener(std::stop_token token, const size_t queue) {
+        PacketAllocator allocator;
         while (!token.stop_requested()) {
-            auto buffer = allocator.allocate();
             // TODO get rid of latency incurred by copying
-            auto n = interface.receive({ buffer, PacketBufferSize });
-            if (n <= 0) {
+            auto packet = interface.receive_packet(queue);
+            if (packet.data.empty()) {
                 // The tun device is closed (or some other problem). No business for me here.
                 break;
             }
+            auto buffer = packet.data.data();
+            // Whatever is looked up below is used only until the next packet
+            auto guard = reclaimer.pin(listener_reader(queue));
+
+            if (options.capture != nullptr) {
+                options.capture->record_received(queue, packet.data);
+            }
 
             auto& ip = structs::IPv4::from_ptr(buffer);
             if (ip.version != 4 || ip.protocol != structs::IPv4::IPPROTOCOL_TCP) {
+                allocator.deallocate(buffer);
+                continue;
+            }
+
+            // Skipped when the device has already verified the checksums (or they're offloaded)
+            if (!packet.checksum_valid && !(ip.has_valid_checksum() && ip.has_valid_tcp_checksum())) {
+                allocator.deallocate(buffer);
                 continue;
             }
 
             // std::cerr << ip.info() << "\n";
 
             auto id = ip.connection_id();
-            bool connection_not_established = !connections.contains(id);
+            auto& shard = shards[shard_of(id)];
+            if (connections.contains(id)) {
+                // The handler is too far behind. The packet is lost, as it would be on the wire.
+                if (!shard.received_packets.push(buffer)) allocator.deallocate(buffer);
+                continue;
+            }
 
+            // Only the packets of the connections that aren't established yet go through the listeners
             auto& tcp = ip.tcp_payload();
-            Port port = tcp.dest_port();
-            IpAddress address = ip.dest_addr_n;
-            Endpoint endpoint { address, port };
-            // TODO delete this
-            auto listener = port_listeners.find_and_perform(endpoint, [](TCPListener<ConnectionBufferSize>& listener) {
-                // Mark for usage so that it doesn't get deleted while we're operating on it.
-                // This is the only thread other than the destructor that uses this variable.
-                listener.under_usage = true;
-            });
-            bool no_listener = listener == port_listeners.end();
-            if (no_listener && connection_not_established) {
+            auto listener = port_listeners.find({ ip.dest_addr_n, tcp.dest_port() });
+            // TODO memory order
+            if (listener == nullptr || closing || !tcp.syn) {
+                allocator.deallocate(buffer);
                 continue;
             }
 
-            // TODO memory order
-            if (connection_not_established && !closing) {
-                // there is only a single listener (this thread). there can be multiple threads accessing
-                //  the listener, but they can only increment the counter. this means that if the counter
-                //  is > 0, then we can proceed without worrying about other threads decrementing the counter
-                //  and having us stuck in the CAS loop down there.
-                if (tcp.syn && listener->second.acceptable_connections > 0) {
-                    // New connection
-                    // TODO memory order
-                    // TODO insure that this is a valid new connection
-                    auto [new_connection, inserted] = connections.emplace(
-                        std::piecewise_construct,
-                        std::forward_as_tuple(id),
-                        std::forward_as_tuple(id, send_queue)
-                    );
-                    assert(inserted);
-                    received_packets.push(buffer);
-                    // TODO will there ever be a situation in which multiple
-                    //  threads are accessing this value concurrently?
-                    // TODO memory orders
-                    listener->second.acceptable_connections--;
-                    auto& to_return = listener->second.connection_to_return;
-                    assert(to_return == nullptr);
-                    to_return = &new_connection->second;
-                    // TODO Optimal? the listener has to have a very low latency.
-                    to_return.notify_one();
-                } else {
-                    // Not waiting for a new connection, drop the packet.
-                }
-            } else {
-                received_packets.push(buffer);
+            // The listener threads of all the queues compete over the room in the backlog, while the
+            //  accepting threads can only give room back. Claim a slot before creating the connection
+            //  so that the backlog can't overflow.
+            if (!listener->claim_backlog_slot()) {
+                // The backlog is full. The peer sends the syn again later.
+                allocator.deallocate(buffer);
+                continue;
             }
 
-            if (!no_listener) {
-                // If we've set this, unset it
-                listener->second.under_usage = false;
+            // New connection
+            // TODO memory order
+            // TODO insure that this is a valid new connection
+            auto [new_connection, inserted] = connections.emplace(
+                id, id, shard.send_queue, connection_options(), releaser(id), timer_scheduler(id)
+            );
+            if (!inserted) {
+                // The table is full (or the interface is closing). Give the claim back.
+                listener->release_backlog_slot();
+                allocator.deallocate(buffer);
+                continue;
+            }
+            // The syn goes first, so that a connection is never accepted without it. Once it's queued, the
+            //  handler owns the buffer. If the listener is closed meanwhile, the connection isn't accepted.
+            const bool queued = shard.received_packets.push(buffer);
+            if (!queued || !listener->push_to_backlog(new_connection)) {
+                // Unknown to the application, so it's dropped right away. The peer sends the syn again later.
+                new_connection->abandon();
+                connections.erase(id);
+                listener->release_backlog_slot();
+                if (!queued) allocator.deallocate(buffer);
             }
         }
     }
 
-    void sender(std::stop_token token) {
-        ReusableAllocator allocator;
+    void sender(std::stop_token token, const size_t queue) {
+        auto& shard = shards[queue];
+        // Allocated once, up front
+        std::vector<PacketBuffer> buffers(options.tx_batch_size);
+        std::vector<std::span<uint8_t>> packets(options.tx_batch_size);
+        Backoff backoff(options.sender_wait, options.spins_before_waiting);
+        auto ready = [&] { return !shard.send_queue.empty() || token.stop_requested(); };
         while (!token.stop_requested()) {
-            // TODO don't spin
-            auto packet = send_queue.pop();
-            if (!packet.has_value()) continue;
-            auto buffer = packet.value();
-            auto& ip = structs::IPv4::from_ptr(buffer);
-            (void)interface.send({ buffer, ip.total_len() });
-            allocator.deallocate(buffer);
+            // The whole batch is taken off the queue at once
+            auto count = shard.send_queue.pop_n(buffers);
+            if (count == 0) {
+                backoff.idle(shard.send_queue.parking_spot(), ready);
+                continue;
+            }
+            backoff.reset();
+            for (size_t i = 0; i < count; i++) {
+                auto& ip = structs::IPv4::from_ptr(buffers[i]);
+                packets[i] = { buffers[i], ip.total_len() };
+            }
+            if (options.capture != nullptr) {
+                for (size_t i = 0; i < count; i++) {
+                    options.capture->record_sent(queue, packets[i], interface.offloads_enabled());
+                }
+            }
+            // The device returns the slabs to the allocator once they're sent
+            interface.send_packets({ packets.data(), count }, queue);
+            shard.tx_batches.record(count);
         }
     }
 
-    void packets_handler(std::stop_token token) {
+    void packets_handler(std::stop_token token, const size_t queue) {
+        auto& received_packets = shards[queue].received_packets;
+        Backoff backoff(options.handler_wait, options.spins_before_waiting);
+        auto ready = [&] { return !received_packets.empty() || token.stop_requested(); };
+        std::array<PacketBuffer, HandlerBurstSize> burst { };
         while (!token.stop_requested()) {
-            // TODO stop spinning?
-            auto packet = received_packets.pop();
-            if (!packet.has_value()) continue;
-            auto& ip = structs::IPv4::from_ptr(packet.value());
-            auto id = ip.connection_id();
-            auto connection_it = connections.find(id);
-            if (connection_it == connections.end()) {
-                // TODO change this
-                // Connection not found. We must be in the process of destruction now.
-                break;
+            // Whatever has arrived, up to a burst, is taken off the queue at once
+            auto count = received_packets.pop_n(burst);
+            if (count == 0) {
+                backoff.idle(received_packets.parking_spot(), ready);
+                continue;
             }
-            connection_it->second.process_packet(packet.value());
-            if (connection_it->second.connection_closed) {
-                // TODO erase when appropriate
-                // connections.erase(connection_it);
-                // if (!closing) {
-                    // assert(!connections.contains(id));
-                // }
+            backoff.reset();
+            {
+                auto guard = reclaimer.pin(handler_reader(queue));
+                for (auto packet : std::span { burst.data(), count }) {
+                    auto& ip = structs::IPv4::from_ptr(packet);
+                    auto id = ip.connection_id();
+                    auto connection = connections.find(id);
+                    if (connection == nullptr) {
+                        // The connection is released (or the interface is being destroyed)
+                        PacketAllocator{}.deallocate(packet);
+                        continue;
+                    }
+                    // The connection may be released while processing the packet
+                    connection->process_packet(packet);
+                }
             }
+            // Frees the released connections that none of the threads can be holding anymore
+            reclaimer.collect();
         }
     }
 
-    TunDevice interface;
+    Device interface;
 
-    // TODO have different argument for queue capacity
-    MPSCBoundedQueue<PacketBuffer, ConnectionBufferSize> send_queue;
-    SPSCBoundedWaitFreeQueue<uint8_t*, ConnectionBufferSize> received_packets;
+    const InterfaceOptions options;
 
-    TimersManager<std::function<void()>> timers;  // TODO change std::function
+    std::vector<Shard> shards;
 
-    // TODO have different argument for queue capacity
-    ConcurrentMap<ConnectionID, TCPConnection<ConnectionBufferSize>> connections;
-    ConcurrentMap<Endpoint, TCPListener<ConnectionBufferSize>> port_listeners;
+    // The listeners, the handlers, and the timers are its readers
+    EpochReclaimer reclaimer;
+
+    // Looked up by the listeners and handlers for every packet, without locking
+    FlowTable<ConnectionID, Connection> connections;
+    // Indexed by the local port. Looked up only for the packets of the connections that aren't established.
+    PortDemux<Listener> port_listeners;
+    std::mutex closed_listeners_mutex;
+    std::vector<std::unique_ptr<Listener>> closed_listeners;
 
     std::atomic<bool> closing = false;
 
+    // Destroyed before the connections, which its callbacks look up, and after the destructor closes them
+    TimersManager<ConnectionTimer> timers;
+
     std::stop_source stop_source;
-    std::jthread sender_thread;
-    std::jthread handler_thread;
-    std::jthread listener_thread;
+    // Declared last so that all the threads are joined before anything they use is destroyed
+    std::vector<std::jthread> threads;
 };
 
 }
@@ -1,63 +1,112 @@
 #pragma once
 
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
+#include <functional>
+
 #include <tcpp/TypeDefs.hpp>
+#include <tcpp/LinkDevice.hpp>
 #include <tcpp/utils/Connections.hpp>
 #include <tcpp/TCPConnection.hpp>
-#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
-#include <tcpp/data-structures/ConcurrentMap.hpp>
+#include <tcpp/data-structures/MPMCBoundedQueue.hpp>
 
 namespace tcpp {
 
-template <size_t ConnectionQueueCapacity>
+template <size_t SendQueueCapacity, CongestionControl Controller = NewReno>
 class TCPListener {
-    template <size_t ConnectionBufferSize>
-    requires PowerOfTwo<ConnectionBufferSize>
+    template <size_t Capacity, LinkDevice Device, CongestionControl>
+    requires PowerOfTwo<Capacity>
     friend class TCPInterface;
 
+    using Connection = TCPConnection<SendQueueCapacity, Controller>;
+
+    // The connections created for the syns received, waiting to be accepted, as the backlog of listen(2)
+    static constexpr size_t BacklogCapacity = 1 << 7;
+
     const Endpoint endpoint;
-    MPSCBoundedQueue<PacketBuffer, ConnectionQueueCapacity>& send_queue;
 
-    std::atomic<int> acceptable_connections = 0;
-    std::atomic<TCPConnection<ConnectionQueueCapacity>*> connection_to_return;
+    // Pushed to by the listener threads of all the queues, and popped by any of the accepting threads
+    MPMCBoundedQueue<Connection*, BacklogCapacity> backlog;
+    // The slots of the backlog not claimed by a listener thread yet
+    std::atomic<int> backlog_room = BacklogCapacity;
+    // Bumped after each push to the backlog, for the accepting threads to wait on
+    std::atomic<uint32_t> backlog_pushes = 0;
 
-    // TODO specify the size specifically
-    ConcurrentMap<Endpoint, TCPListener>& listeners;
+    // Serializes the pushes to the backlog with closing, so that nothing is pushed after the backlog is drained
+    std::mutex close_mutex;
+    std::atomic<bool> closed = false;
 
-public:
+    // Unbinds the listener, and hands it over to the interface, which keeps it until it's destroyed
+    std::function<void()> on_closed;
+
+    // Claimed before the connection is created, so that the push that follows always finds room
+    bool claim_backlog_slot() {
+        if (closed.load(std::memory_order::relaxed)) return false;
+        auto room = backlog_room.load(std::memory_order::relaxed);
+        while (room > 0 && !backlog_room.compare_exchange_weak(room, room - 1, std::memory_order::relaxed)) { }
+        return room > 0;
+    }
+
+    void release_backlog_slot() {
+        backlog_room.fetch_add(1, std::memory_order::relaxed);
+    }
+
+    // Fails once the listener is closed, in which case the connection isn't the listener's to release
+    bool push_to_backlog(Connection* connection) {
+        {
+            std::lock_guard lock(close_mutex);
+            if (closed.load(std::memory_order::relaxed)) return false;
+            (void)backlog.push(connection);
+        }
+        backlog_pushes.fetch_add(1, std::memory_order::release);
+        backlog_pushes.notify_one();
+        return true;
+    }
 
-    // TODO delete this
-    std::atomic<bool> under_usage = false;
+public:
 
     // TODO make it private
     TCPListener(
         const Endpoint endpoint,
-        MPSCBoundedQueue<PacketBuffer, ConnectionQueueCapacity>& send_queue,
-        ConcurrentMap<Endpoint, TCPListener>& listeners
+        std::function<void()> on_closed_
     ) : endpoint(endpoint),
-        send_queue(send_queue),
-        listeners(listeners)
+        on_closed(std::move(on_closed_))
     { }
 
-    // TODO same size by default?
-    TCPConnection<ConnectionQueueCapacity>& accept() {
-        acceptable_connections++;  // TODO memory order
-        // TODO memory orders
-        connection_to_return.wait(nullptr);
-        auto connection = connection_to_return.load();
-        connection_to_return = nullptr;
-        return *connection;
+    // Waits for a connection, unless one is in the backlog already. The connections that arrive
+    //  before accept() is called wait in the backlog, as long as there's room in it. Throws once
+    //  the listener is closed, including to the threads waiting in it meanwhile.
+    Connection& accept() {
+        while (true) {
+            // Taken before the pop, so that a push after it wakes the wait right away
+            const auto pushes = backlog_pushes.load(std::memory_order::acquire);
+            if (closed.load(std::memory_order::acquire)) {
+                throw std::runtime_error("The listener is closed");
+            }
+            if (auto connection = backlog.pop()) {
+                release_backlog_slot();
+                return **connection;
+            }
+            backlog_pushes.wait(pushes, std::memory_order::acquire);
+        }
     }
 
-    // TODO delete all connections from the connections map in the interface
+    // Stops accepting connections, and closes the ones in the backlog that were never accepted,
+    //  waiting for each of them to close. The listener remains valid until the interface is destroyed.
     void close() {
-        auto it = listeners.find(endpoint);
-        listeners.erase(it);
-    }
-
-    ~TCPListener() noexcept {
-        // TODO delete this
-        while (under_usage.load()) {}
+        {
+            std::lock_guard lock(close_mutex);
+            if (closed.exchange(true, std::memory_order::relaxed)) return;
+        }
+        // Wakes up the accepting threads to find the listener closed
+        backlog_pushes.fetch_add(1, std::memory_order::release);
+        backlog_pushes.notify_all();
+        on_closed();
+        while (auto connection = backlog.pop()) {
+            (*connection)->close();
+        }
     }
 };
 
-};
\ No newline at end of file
+};
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <condition_variable>
+#include <chrono>
+#include <mutex>
 #include <queue>
+#include <thread>
+#include <vector>
 
 namespace tcpp {
 
-using TimePoint = std::chrono::time_point<std::chrono::high_resolution_clock>;
+// Steady, so that the timers aren't thrown off by changes to the wall clock
+using TimePoint = std::chrono::steady_clock::time_point;
 
 template <typename Callback>
 requires requires(Callback cb) { cb(); }
@@ -18,49 +23,51 @@ struct Timer {
     }
 };
 
+// Runs each of the callbacks on a thread of its own once its time comes. The callbacks run
+//  without the lock held, so they may add timers themselves, or take locks that are held
+//  while adding timers. A timer can't be cancelled, so the callbacks check whether they're
+//  still needed, and the ones that are re-armed often are better off added lazily.
 template <typename Callback>
 requires requires(Callback cb) { cb(); }
 class TimersManager {
 
-    std::mutex m;  // TODO change this
+    std::mutex m;
     std::priority_queue<Timer<Callback>, std::vector<Timer<Callback>>, std::greater<>> timers;
     std::condition_variable cv;
-    std::jthread handler_thread { &TimersManager::handler, this };
-
-    bool should_execute(const Timer<Callback>& timer) {
-        // True if the timer is about to expire in less than or equal
-        //  to 10 milliseconds or should've been already executed
-        auto now = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(timer.time - now);
-        return duration.count() <= 10;
+    // std::jthread only passes the stop token first, which doesn't work with member functions
+    std::jthread handler_thread { [this](std::stop_token token) { handler(std::move(token)); } };
+
+    static std::priority_queue<Timer<Callback>, std::vector<Timer<Callback>>, std::greater<>> reserved(const size_t capacity) {
+        std::vector<Timer<Callback>> storage;
+        storage.reserve(capacity);
+        return std::priority_queue<Timer<Callback>, std::vector<Timer<Callback>>, std::greater<>> { std::greater<>{ }, std::move(storage) };
     }
 
     void handler(std::stop_token token) {
         std::unique_lock lock(m);
         while (!token.stop_requested()) {
             if (timers.empty()) {
-                // The only reason for a wake-up is that something is put into the queue
+                // Woken up once something is put into the queue, or once the thread needs to terminate
                 cv.wait(lock);
+                continue;
             }
-
-            if (!timers.empty()) {
-                if (should_execute(timers.top())) {
-                    // Woke up because of a timer expiration
-                    timers.top().callback();
-                    timers.pop();
-                } else {
-                    // Woke up because an earlier timer is inserted
-                    cv.wait_until(lock, timers.top().time);
-                }
-            } else {
-                // Woken up because the thread needs to terminate
+            if (std::chrono::steady_clock::now() < timers.top().time) {
+                // Woken up by the expiration, or by the insertion of an earlier timer
+                cv.wait_until(lock, timers.top().time);
+                continue;
             }
+            auto timer = timers.top();
+            timers.pop();
+            lock.unlock();
+            timer.callback();
+            lock.lock();
         }
     }
 
 public:
 
-    TimersManager() = default;
+    // The queue of the timers is allocated up front for the capacity, and grows past it if needed
+    explicit TimersManager(const size_t capacity = 0) : timers(reserved(capacity)) { }
 
     TimersManager(const TimersManager&) = delete;
 
@@ -72,7 +79,8 @@ public:
 
     void addTimer(Timer<Callback> timer) {
         std::lock_guard lock(m);
-        bool need_to_update_wait_time = !timers.empty() && (timer.time < timers.top().time);
+        // The handler waits for the earliest timer, or for any timer at all
+        bool need_to_update_wait_time = timers.empty() || (timer.time < timers.top().time);
         timers.push(std::move(timer));
         if (need_to_update_wait_time) {
             cv.notify_one();
@@ -80,8 +88,14 @@ public:
     }
 
     ~TimersManager() noexcept {
+        // The stop has to be requested before the notification. Otherwise, the handler
+        //  might wake up, find that it shouldn't stop yet, and go back to waiting forever.
+        //  Taking the lock ensures that the handler is either not checking the token yet
+        //  or already waiting, so that the notification isn't lost in between.
+        handler_thread.request_stop();
+        std::lock_guard lock(m);
         cv.notify_one();
     }
 };
 
-}
\ No newline at end of file
+}
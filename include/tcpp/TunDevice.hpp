@@ -1,9 +1,12 @@
 #pragma once
 
 #include <span>
+#include <memory>
 #include <string>
+#include <vector>
 #include <cstdint>
 
+#include <tcpp/LinkDevice.hpp>
 #include <tcpp/utils/FileDescriptor.hpp>
 
 namespace tcpp {
@@ -11,9 +14,38 @@ namespace tcpp {
 class TunDevice {
 public:
 
-    [[nodiscard]] ssize_t send(std::span<const uint8_t> buffer) const;
+    [[nodiscard]] ssize_t send(std::span<const uint8_t> buffer, size_t queue = 0) const;
 
-    [[nodiscard]] ssize_t receive(std::span<uint8_t> buffer) const;
+    [[nodiscard]] ssize_t receive(std::span<uint8_t> buffer, size_t queue = 0) const;
+
+    // Sends the packets in order, stopping at the first failure.
+    // Returns the number of packets sent.
+    [[nodiscard]] size_t send_batch(std::span<const std::span<const uint8_t>> packets, size_t queue = 0) const;
+
+    // Receives the next packet into a buffer of the PacketAllocator, which the caller owns afterward.
+    // Returns an empty packet once the device is closed (or on failure).
+    [[nodiscard]] ReceivedPacket receive_packet(size_t queue = 0);
+
+    // Sends the packets, each of which is at the beginning of a buffer of the PacketAllocator.
+    // The device owns the buffers afterward, and returns them to the allocator once they're sent.
+    // With the offloads enabled, the device takes care of the TCP checksums, and TCP segments
+    //  with a gso_size in their metadata are split by the kernel.
+    void send_packets(std::span<const std::span<uint8_t>> packets, size_t queue = 0);
+
+    [[nodiscard]] size_t queues_count() const { return fds.size(); }
+
+    [[nodiscard]] bool uses_io_uring() const { return !rings.empty(); }
+
+    [[nodiscard]] bool offloads_enabled() const { return vnet_header; }
+
+    // The packets send_packets() failed to write, or wrote only part of, summed over the queues. They're
+    //  lost as they would be on the wire, and this tells the errors of the device apart from such losses.
+    struct WriteErrors {
+        uint64_t failed = 0;
+        uint64_t short_writes = 0;
+    };
+
+    [[nodiscard]] WriteErrors write_errors() const;
 
     void close();
 
@@ -21,9 +53,9 @@ public:
 
     TunDevice& operator=(const TunDevice&) = delete;
 
-    TunDevice(TunDevice&&) = default;
+    TunDevice(TunDevice&&) noexcept;
 
-    TunDevice& operator=(TunDevice&&) = default;
+    TunDevice& operator=(TunDevice&&) noexcept;
 
     ~TunDevice();
 
@@ -31,12 +63,29 @@ private:
 
     friend class TunBuilder;
     // Can only be created through a TunBuilder
-    TunDevice(FileDescriptor fd_, std::string name_) : fd(std::move(fd_)), name(std::move(name_)) { }
+    TunDevice(std::vector<FileDescriptor> fds_, std::string name_, bool vnet_header_);
 
-    FileDescriptor fd;
+    void setup_io_uring(unsigned entries);
+
+    // One file descriptor per queue. Unless the device
+    // is built with multiple queues, there is only one.
+    std::vector<FileDescriptor> fds;
     std::string name;
 
-    // This is an alternative to have an atomic fd. This is
+    // Every packet read or written through the fds is preceded by a virtio-net header.
+    // This is a requirement of the checksum and segmentation offloads.
+    bool vnet_header = false;
+
+    // The io_uring state of each of the queues, defined in the source
+    //  file. Empty unless the device is built with io_uring enabled.
+    struct QueueRings;
+    std::vector<std::unique_ptr<QueueRings>> rings;
+
+    // Counted by the sending thread of each of the queues
+    struct WriteCounters;
+    std::unique_ptr<WriteCounters[]> write_counters;
+
+    // This is an alternative to have atomic fds. This is
     // written to only from the close() function and read
     // in the destructor. As long as these don't happen
     // concurrently, and as long as nothing will try to
@@ -45,6 +94,8 @@ private:
     bool already_closed = false;
 };
 
+static_assert(LinkDevice<TunDevice>);
+
 class TunBuilder {
 public:
 
@@ -54,16 +105,35 @@ public:
 
     TunBuilder& set_netmask(std::string netmask_) { netmask = std::move(netmask_); return *this; }
 
+    // More than one queue opens the device in IFF_MULTI_QUEUE mode,
+    // with a separate file descriptor for each of the queues
+    TunBuilder& set_queues(size_t queues_) { queues = queues_; return *this; }
+
+    // A non-zero value backs receive_packet() and send_packets() of each
+    //  queue with io_uring instead of blocking reads and writes. The buffers
+    //  of the PacketAllocator are registered as fixed buffers, and up
+    //  to this many reads are kept in flight for each of the queues.
+    TunBuilder& set_io_uring(unsigned entries) { io_uring_entries = entries; return *this; }
+
+    // Enables IFF_VNET_HDR along with the checksum and TCP segmentation offloads. The
+    //  kernel skips computing the checksums of the packets it hands us, and can coalesce
+    //  them into frames of up to 64KB. The packets we send can be up to 64KB as well.
+    // Note that each of the reads in flight occupies a large (64KB) buffer in this mode.
+    TunBuilder& set_offloads(bool enabled) { offloads = enabled; return *this; }
+
     TunDevice build();
 
 private:
 
     void allocate_tun();
 
-    FileDescriptor fd;
+    std::vector<FileDescriptor> fds;
     std::string name;
     std::string ip4;
     std::string netmask;
+    size_t queues = 1;
+    unsigned io_uring_entries = 0;
+    bool offloads = false;
 };
 
 };
\ No newline at end of file
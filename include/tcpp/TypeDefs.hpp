@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <tcpp/utils/Concepts.hpp>
 
@@ -7,18 +8,35 @@ namespace tcpp {
 
 using Port = uint16_t;
 using IpAddress = uint32_t;
+using MacAddress = std::array<uint8_t, 6>;
 
 template <typename T, size_t SlabSize, size_t SlabsCount>
 requires PowerOfTwo<SlabsCount>
 class ReusableSlabSingletonAllocator;
 
 
+// Small buffers hold the segments made of headers alone, like the acknowledgements
+constexpr int SmallPacketBufferSize = 256;
+
 constexpr int PacketBufferSize = 2048;
 
-constexpr int AllocatablePacketsCount = 1024;
+// The maximum numbers of buffers of each size. Only the addresses are reserved for all of
+//  them up front, and the memory is added as needed, according to the ArenaOptions.
+constexpr int AllocatableSmallPacketsCount = 1 << 16;
+
+constexpr int AllocatablePacketsCount = 1 << 16;
+
+// Large buffers hold segments of up to 64KB for the segmentation and receive offloads
+constexpr int LargePacketBufferSize = (1 << 16) + 64;
+
+constexpr int AllocatableLargePacketsCount = 1 << 12;
 
 using PacketBuffer = uint8_t*;
 
+using SmallReusableAllocator = ReusableSlabSingletonAllocator<uint8_t, SmallPacketBufferSize, AllocatableSmallPacketsCount>;
+
 using ReusableAllocator = ReusableSlabSingletonAllocator<uint8_t, PacketBufferSize, AllocatablePacketsCount>;
 
+using LargeReusableAllocator = ReusableSlabSingletonAllocator<uint8_t, LargePacketBufferSize, AllocatableLargePacketsCount>;
+
 }
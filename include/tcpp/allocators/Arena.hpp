@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace tcpp {
+
+struct ArenaOptions {
+    // The bytes backed by memory up front, and the bytes added each time the arena runs out.
+    //  Both are rounded up to the huge page size.
+    size_t initial_size = 16 << 20;
+    size_t growth_size = 16 << 20;
+    // Also bounded by the size reserved for the arena
+    size_t max_size = SIZE_MAX;
+    // Explicit huge pages (MAP_HUGETLB) while the system has any reserved,
+    //  and transparent huge pages otherwise
+    bool huge_pages = true;
+    // Locks the memory, faulting it in as it's added. Failing because
+    //  of the limits on locked memory leaves the memory unlocked.
+    bool lock_memory = false;
+    // The NUMA node to place the memory on, ideally the one of the CPUs of the workers
+    //  that use it. -1 leaves the placement to the first-touch policy of the kernel.
+    int numa_node = -1;
+};
+
+// A contiguous range of addresses reserved up front, and backed by memory in chunks as it grows,
+//  so that the addresses handed out never move and the whole range can be checked at once.
+// The parts that aren't backed yet are inaccessible, and take no memory.
+class Arena {
+public:
+
+    static constexpr size_t HugePageSize = 2 << 20;
+
+    // The reserved size is rounded up to the huge page size
+    Arena(size_t reserved_size_, const ArenaOptions& options_);
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena();
+
+    // Backs at least the next size bytes with memory, or as many as are left. Returns the number of bytes added,
+    //  which is zero once the whole arena is backed. The growth of the arena must be serialized by the caller.
+    size_t grow(size_t size);
+
+    [[nodiscard]] uint8_t* data() const { return base; }
+
+    [[nodiscard]] size_t reserved() const { return reserved_size; }
+
+    // The bytes at the beginning of the range that are backed by memory
+    [[nodiscard]] size_t committed() const { return committed_size.load(std::memory_order_acquire); }
+
+    // Whether all the memory added so far is made of explicit huge pages
+    [[nodiscard]] bool huge_pages() const { return explicit_huge_pages; }
+
+private:
+
+    bool map_huge_pages(uint8_t* address, size_t size);
+
+    const ArenaOptions options;
+    const size_t reserved_size;
+    uint8_t* base = nullptr;
+    std::atomic<size_t> committed_size = 0;
+    bool explicit_huge_pages = true;
+};
+
+}
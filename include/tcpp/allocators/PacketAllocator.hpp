@@ -0,0 +1,164 @@
+#pragma once
+
+#include <new>
+#include <span>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/allocators/ReusableSlabAllocator.hpp>
+
+namespace tcpp {
+
+// The bytes reserved at the beginning of every slab, in front of the packet. A PacketBuffer
+//  points right after them, at the IP header. Devices can place their own headers (like the
+//  virtio-net header) in the space right before the packet, and the metadata of the packet
+//  is kept at the beginning of the slab.
+constexpr size_t PacketHeadroom = 64;
+
+// The classes of sizes the buffers come in, each allocated from slabs of its own
+enum class SizeClass : uint8_t {
+    Small,    // Headers alone, like the acknowledgements and the handshake segments
+    Regular,  // Up to the MTU
+    Large,    // Segments of up to 64KB, for the segmentation and receive offloads
+};
+
+struct PacketMetadata {
+    // Each holder of the buffer owns a reference. The buffer is freed along with the last one.
+    std::atomic<uint32_t> references = 1;
+    // When non-zero, the packet is a TCP segment larger than the MSS, which
+    //  the device splits into segments carrying this many bytes of payload each
+    uint16_t gso_size = 0;
+    SizeClass size_class = SizeClass::Regular;
+};
+
+static_assert(sizeof(PacketMetadata) <= PacketHeadroom);
+static_assert(LargePacketBufferSize - PacketHeadroom >= (1 << 16));
+
+// Packet buffers come in three size classes, each with a slab allocator of its own: the small slabs
+//  of SmallPacketBufferSize, the regular ones of PacketBufferSize, and the large ones for segments
+//  of up to 64KB. A buffer is allocated from the smallest class that fits, and any of them can be
+//  freed through here, since the class of the buffer is kept in its metadata.
+// A buffer starts with a single reference, owned by whoever allocated it. It can be shared,
+//  without copying, by adding a reference for each of the other holders with retain(). Each of
+//  the holders then deallocates it as usual, which only frees it once the last one does.
+class PacketAllocator {
+
+    static uint8_t* slab_of(const PacketBuffer buffer) { return buffer - PacketHeadroom; }
+
+    // Drops a reference. Returns whether it was the last one, and the buffer is to be freed.
+    static bool release(const PacketBuffer buffer) {
+        auto& references = metadata(buffer).references;
+        // The only holder can't race with anyone, so it skips the read-modify-write
+        if (references.load(std::memory_order_acquire) == 1) return true;
+        return references.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    // Calls the function with the slab allocator of the size class
+    static decltype(auto) visit(const SizeClass size_class, auto&& func) {
+        switch (size_class) {
+            case SizeClass::Small: return func(SmallReusableAllocator{});
+            case SizeClass::Regular: return func(ReusableAllocator{});
+            case SizeClass::Large: break;
+        }
+        return func(LargeReusableAllocator{});
+    }
+
+public:
+
+    using value_type = uint8_t;
+
+    static constexpr size_t SizeClassesCount = 3;
+
+    static constexpr size_t SmallCapacity = SmallPacketBufferSize - PacketHeadroom;
+
+    static constexpr size_t RegularCapacity = PacketBufferSize - PacketHeadroom;
+
+    static constexpr size_t LargeCapacity = LargePacketBufferSize - PacketHeadroom;
+
+    // The smallest class with room for the size
+    static constexpr SizeClass size_class_for(const size_t size) {
+        if (size <= SmallCapacity) return SizeClass::Small;
+        if (size <= RegularCapacity) return SizeClass::Regular;
+        return SizeClass::Large;
+    }
+
+    // size: the number of bytes needed for the packet, not including the headroom.
+    //  Throws if it's larger than LargeCapacity, which no buffer can hold.
+    PacketBuffer allocate(const size_t size = RegularCapacity) {
+        if (size > LargeCapacity) [[unlikely]] {
+            throw std::invalid_argument("The packet is larger than the largest buffers");
+        }
+        const auto size_class = size_class_for(size);
+        auto slab = visit(size_class, [](auto allocator) { return allocator.allocate(); });
+        // The slabs are not cleared before reuse
+        new (slab) PacketMetadata { .size_class = size_class };
+        return slab + PacketHeadroom;
+    }
+
+    // Adds a reference to the buffer, for another holder. The caller must own one already.
+    static void retain(const PacketBuffer buffer) {
+        metadata(buffer).references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The number of holders of the buffer. Once it's one, the caller is the only holder, and stays so.
+    static uint32_t references(const PacketBuffer buffer) {
+        return metadata(buffer).references.load(std::memory_order_acquire);
+    }
+
+    // Drops a reference to the buffer, freeing it if it's the last one
+    void deallocate(const PacketBuffer buffer) noexcept {
+        if (!release(buffer)) return;
+        visit(metadata(buffer).size_class, [&](auto allocator) { allocator.deallocate(slab_of(buffer)); });
+    }
+
+    // The slabs are returned to the shared depots in batches by the magazines of the allocators
+    void deallocate_bulk(const std::span<const PacketBuffer> buffers) noexcept {
+        for (auto buffer : buffers) {
+            deallocate(buffer);
+        }
+    }
+
+    // The number of bytes available for the packet in the buffer
+    static size_t capacity(const PacketBuffer buffer) {
+        switch (metadata(buffer).size_class) {
+            case SizeClass::Small: return SmallCapacity;
+            case SizeClass::Regular: return RegularCapacity;
+            case SizeClass::Large: break;
+        }
+        return LargeCapacity;
+    }
+
+    static PacketMetadata& metadata(const PacketBuffer buffer) {
+        return *std::launder(reinterpret_cast<PacketMetadata*>(slab_of(buffer)));
+    }
+
+    // Sets the sizing and placement of the memory of the buffers of each class.
+    //  Must be called before the first buffer is allocated, otherwise it returns false.
+    //  Either all of the classes are configured, or none of them is.
+    static bool configure(const ArenaOptions& small, const ArenaOptions& regular, const ArenaOptions& large) {
+        if (!SmallReusableAllocator::configurable() ||
+            !ReusableAllocator::configurable() ||
+            !LargeReusableAllocator::configurable()) {
+            return false;
+        }
+        SmallReusableAllocator::configure(small);
+        ReusableAllocator::configure(regular);
+        LargeReusableAllocator::configure(large);
+        return true;
+    }
+
+    // The memory backing the buffers so far, one region for each of the classes.
+    //  The buffers added as the arenas grow later on fall outside of them.
+    static std::array<std::span<uint8_t>, SizeClassesCount> regions() {
+        return {
+            SmallReusableAllocator{}.committed_region(),
+            ReusableAllocator{}.committed_region(),
+            LargeReusableAllocator{}.committed_region()
+        };
+    }
+};
+
+}
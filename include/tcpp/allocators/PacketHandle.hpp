@@ -0,0 +1,72 @@
+#pragma once
+
+#include <utility>
+#include <cstdint>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+
+namespace tcpp {
+
+// An owning reference to a packet buffer, counted in the metadata of the buffer. Copies share
+//  the buffer instead of copying it, and the buffer is freed along with the last reference.
+// The raw buffers passed around the stack own a reference each, the same way, so a handle can
+//  adopt the reference of a raw buffer, and give its own (or a new one) away to be passed around.
+class PacketHandle {
+
+    PacketBuffer buffer = nullptr;
+
+public:
+
+    PacketHandle() = default;
+
+    // Adopts the reference owned by the raw buffer
+    explicit PacketHandle(const PacketBuffer buffer_) : buffer(buffer_) { }
+
+    PacketHandle(const PacketHandle& other) : buffer(other.buffer) {
+        if (buffer != nullptr) PacketAllocator::retain(buffer);
+    }
+
+    PacketHandle& operator=(const PacketHandle& other) {
+        if (this != &other) {
+            *this = PacketHandle { other };
+        }
+        return *this;
+    }
+
+    PacketHandle(PacketHandle&& other) noexcept : buffer(std::exchange(other.buffer, nullptr)) { }
+
+    PacketHandle& operator=(PacketHandle&& other) noexcept {
+        reset();
+        buffer = std::exchange(other.buffer, nullptr);
+        return *this;
+    }
+
+    ~PacketHandle() noexcept { reset(); }
+
+    [[nodiscard]] PacketBuffer get() const { return buffer; }
+
+    explicit operator bool() const { return buffer != nullptr; }
+
+    // A new reference to the buffer as a raw buffer, to be handed over while this handle keeps its own
+    [[nodiscard]] PacketBuffer share() const {
+        PacketAllocator::retain(buffer);
+        return buffer;
+    }
+
+    // Gives the reference of the handle away as a raw buffer, leaving the handle empty
+    [[nodiscard]] PacketBuffer release() { return std::exchange(buffer, nullptr); }
+
+    // Whether this is the only reference to the buffer, in which case it can be modified in place
+    [[nodiscard]] bool unique() const { return PacketAllocator::references(buffer) == 1; }
+
+    [[nodiscard]] uint32_t use_count() const { return buffer == nullptr ? 0 : PacketAllocator::references(buffer); }
+
+    void reset() {
+        if (buffer != nullptr) {
+            PacketAllocator{}.deallocate(std::exchange(buffer, nullptr));
+        }
+    }
+};
+
+}
@@ -1,47 +1,49 @@
 #pragma once
 
+#include <span>
+#include <array>
+#include <mutex>
 #include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <tcpp/allocators/Arena.hpp>
 #include <tcpp/data-structures/MPMCBoundedQueue.hpp>
 
 namespace tcpp {
 
 // SlabSize: The size of each slab in multiples of sizeof(T), not in bytes
-// Total allocated buffer = (sizeof(T) * SlabSize * SlabsCount) bytes
+// SlabsCount: The maximum number of slabs. The addresses of all of them, (sizeof(T) * SlabSize * SlabsCount)
+//  bytes, are reserved up front, while the memory backing them is added in chunks as the slabs run out.
 // The slabs are not cleared before reuse
 template <typename T, size_t SlabSize, size_t SlabsCount>
 requires PowerOfTwo<SlabsCount>
 class ReusableSlabAllocator {
+
+    static constexpr size_t SlabBytes = sizeof(T) * SlabSize;
+
 public:
 
     using value_type = T;
 
-    ReusableSlabAllocator() : buffer(allocate_buffer()) {
-        // We have two options here:
-        //   1 - Keep track of the amount of slabs inserted into the queue from the buffer
-        //   and only insert new slabs into the queue if we need one and the queue is empty
-        //   2 - Insert all the slabs into the queue, and don't keep track of anything
-        // Here, number 2 is implemented for faster allocations and deallocations
-        for (size_t i = 0; i < SlabsCount; i++) {
-            available_slabs.push(buffer + i * SlabSize);
-        }
+    explicit ReusableSlabAllocator(const ArenaOptions& options = { })
+        : arena(SlabBytes * SlabsCount, options),
+          buffer(reinterpret_cast<T*>(arena.data())),
+          growth_size(std::max(options.growth_size, SlabBytes))
+    {
+        // All the slabs backed by the arena are inserted into the queue right away,
+        //  so that the allocations and deallocations don't keep track of anything
+        carve_slabs();
     }
 
-    ReusableSlabAllocator(ReusableSlabAllocator&& other) noexcept
-        : buffer(std::exchange(other.buffer, nullptr)) { }
-
     ReusableSlabAllocator(const ReusableSlabAllocator& other) = delete;
 
-    ~ReusableSlabAllocator() noexcept {
-        std::allocator<T> alloc;
-        std::allocator_traits<std::allocator<T>>::deallocate(alloc, buffer, SlabSize * SlabsCount);
-    }
-
     T* allocate(std::size_t n = 1) {
         (void)n;
-        auto slab = available_slabs.pop();
-        if (!slab.has_value())
-            throw std::runtime_error("The slab allocator ran out of slabs");
-        return slab.value();
+        while (true) {
+            if (auto slab = available_slabs.pop(); slab.has_value()) return slab.value();
+            if (!grow())
+                throw std::runtime_error("The slab allocator ran out of slabs");
+        }
     }
 
     void deallocate(T* p, std::size_t n = 1) noexcept {
@@ -49,6 +51,36 @@ public:
         available_slabs.push(p);
     }
 
+    // Takes as many slabs as are available and fit, with a single synchronization on the shared queue.
+    //  Grows the arena if there are none. Returns the number of slabs taken, which is zero if it's full.
+    size_t allocate_bulk(std::span<T*> slabs) {
+        while (true) {
+            if (auto count = available_slabs.pop_n(slabs); count > 0) return count;
+            if (!grow()) return 0;
+        }
+    }
+
+    // Returns all the slabs at once, with a single synchronization on the shared queue
+    void deallocate_bulk(std::span<T* const> slabs) noexcept {
+        // The queue can hold all the slabs, so this never fails for slabs allocated from here
+        (void)available_slabs.push_n(slabs);
+    }
+
+    // The number of slabs backed by memory so far
+    [[nodiscard]] size_t slabs_count() const { return carved_slabs.load(std::memory_order_acquire); }
+
+    // The memory all the slabs are carved out of, including the parts that aren't backed yet
+    std::span<T> region() const {
+        return { buffer, SlabSize * SlabsCount };
+    }
+
+    // The part of the region backed by memory so far
+    std::span<T> committed_region() const {
+        return { buffer, SlabSize * slabs_count() };
+    }
+
+    [[nodiscard]] bool huge_pages() const { return arena.huge_pages(); }
+
     template <typename U, typename... Args>
     void construct(U* p, Args&&... args) {
         ::new((void*)p) U(std::forward<Args>(args)...);
@@ -61,46 +93,144 @@ public:
 
 private:
 
-    T* allocate_buffer() {
-        std::allocator<T> alloc;
-        return std::allocator_traits<std::allocator<T>>::allocate(alloc, SlabSize * SlabsCount);
+    // Called once the queue is found empty. Returns false if the arena is full.
+    bool grow() {
+        std::lock_guard lock(growth);
+        // Another thread may have grown the arena in the meantime
+        if (!available_slabs.empty()) return true;
+        while (arena.grow(growth_size) > 0) {
+            if (carve_slabs() > 0) return true;
+        }
+        return false;
+    }
+
+    // Inserts the slabs that the memory added to the arena fully covers. Returns their number.
+    size_t carve_slabs() {
+        const auto carved = carved_slabs.load(std::memory_order_relaxed);
+        const auto backed = std::min(SlabsCount, arena.committed() / SlabBytes);
+        for (size_t i = carved; i < backed; i++) {
+            available_slabs.push(buffer + i * SlabSize);
+        }
+        carved_slabs.store(backed, std::memory_order_release);
+        return backed - carved;
     }
 
+    Arena arena;
     T* buffer;
+    const size_t growth_size;
+    std::mutex growth;
+    std::atomic<size_t> carved_slabs = 0;
     MPMCBoundedQueue<T*, SlabsCount> available_slabs;
 };
 
 
 // SlabSize: The size of each slab in multiples of sizeof(T), not in bytes
-// Total allocated buffer = (sizeof(T) * SlabSize * SlabsCount) bytes
+// SlabsCount: The maximum number of slabs, as in the ReusableSlabAllocator
 // The slabs are not cleared before reuse
+// The shared instance is created on first use, with the options given to configure() beforehand, if any.
+// Each thread keeps a magazine of slabs in front of the shared instance, which acts as the depot.
+//  The allocations and deallocations are served from the magazine, and the depot is only touched
+//  when the magazine runs empty or full, MagazineSize slabs at a time. A slab freed by a thread other
+//  than the one that allocated it simply goes to the magazine of the freeing thread, and makes its
+//  way back to the depot with the rest of the batch. The magazine of a thread is flushed on its exit.
+// The slabs sitting in the magazines of the other threads are not available to a thread whose
+//  magazine and the depot are both empty, so the magazines are kept small relative to SlabsCount.
 template <typename T, size_t SlabSize, size_t SlabsCount>
 requires PowerOfTwo<SlabsCount>
 class ReusableSlabSingletonAllocator {
 
-    inline static ReusableSlabAllocator<T, SlabSize, SlabsCount> instance;
+    using Depot = ReusableSlabAllocator<T, SlabSize, SlabsCount>;
+
+    inline static ArenaOptions options { };
+    inline static std::atomic<bool> is_created = false;
+
+    static Depot& instance() {
+        static Depot depot { [] { is_created = true; return options; }() };
+        return depot;
+    }
+
+    static constexpr size_t MagazineSize = std::clamp<size_t>(SlabsCount / 64, 1, 32);
+
+    // Holds up to two batches, so that alternating allocations and
+    //  deallocations around a full or empty magazine don't hit the depot
+    struct Magazine {
+        std::array<T*, 2 * MagazineSize> slabs;
+        size_t count = 0;
+
+        ~Magazine() noexcept {
+            if (count > 0) instance().deallocate_bulk({ slabs.data(), count });
+        }
+    };
+
+    inline static thread_local Magazine magazine;
 
 public:
 
-    using value_type = ReusableSlabAllocator<T, SlabSize, SlabsCount>::value_type;
+    using value_type = Depot::value_type;
+
+    // Sets the options of the arena of the shared instance. Has no effect,
+    //  and returns false, if the instance has already been created.
+    static bool configure(const ArenaOptions& options_) {
+        if (is_created) return false;
+        options = options_;
+        return true;
+    }
+
+    // Whether configure() can still take effect, as the shared instance hasn't been created yet
+    static bool configurable() {
+        return !is_created;
+    }
 
     T* allocate(std::size_t n = 1) {
-        return instance.allocate(n);
+        (void)n;
+        auto& local = magazine;
+        if (local.count == 0) [[unlikely]] {
+            local.count = instance().allocate_bulk({ local.slabs.data(), MagazineSize });
+            if (local.count == 0)
+                throw std::runtime_error("The slab allocator ran out of slabs");
+        }
+        return local.slabs[--local.count];
     }
 
     void deallocate(T* p, std::size_t n = 1) noexcept {
-        return instance.deallocate(p, n);
+        (void)n;
+        auto& local = magazine;
+        if (local.count == local.slabs.size()) [[unlikely]] {
+            // The older half goes back, and the recently freed (likely cached) slabs are kept
+            instance().deallocate_bulk({ local.slabs.data(), MagazineSize });
+            std::copy(local.slabs.begin() + MagazineSize, local.slabs.end(), local.slabs.begin());
+            local.count -= MagazineSize;
+        }
+        local.slabs[local.count++] = p;
+    }
+
+    void deallocate_bulk(std::span<T* const> slabs) noexcept {
+        for (auto slab : slabs) {
+            deallocate(slab);
+        }
+    }
+
+    std::span<T> region() const {
+        return instance().region();
+    }
+
+    std::span<T> committed_region() const {
+        return instance().committed_region();
+    }
+
+    [[nodiscard]] size_t slabs_count() const {
+        return instance().slabs_count();
     }
 
     template <typename U, typename... Args>
     void construct(U* p, Args&&... args) {
-        return instance.construct(p, std::forward<Args>(args)...);
+        return instance().construct(p, std::forward<Args>(args)...);
     }
 
     template <typename U>
     void destroy(U* p) noexcept {
-        return instance.destroy(p);
+        return instance().destroy(p);
     }
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include <tcpp/congestion-control/CongestionControl.hpp>
+
+namespace tcpp {
+
+// A model-based controller after BBR (draft-cardwell-iccrg-bbr-congestion-control). Rather than reacting to each
+//  loss, it estimates the bottleneck bandwidth and the round-trip propagation time, and keeps the window at a
+//  gain over their product: high while it searches for the bandwidth at the start, then cycling around it to
+//  probe for more, and briefly down to a few segments every now and then to measure the propagation time again.
+// The stack doesn't pace its segments, so the gains, which BBR applies to the pacing rate, go to the window.
+class BBR {
+public:
+
+    explicit BBR(uint32_t mss_);
+
+    [[nodiscard]] uint32_t window() const { return cwnd; }
+
+    void on_ack(const AckEvent& ack);
+
+    void on_rtt_sample(std::chrono::nanoseconds rtt, SteadyTime now);
+
+    // The window is held at what's in flight until the loss is recovered from (packet conservation)
+    void on_loss(uint32_t in_flight, SteadyTime now);
+
+    // A mild backoff, which the model grows back from within a round trip if the congestion clears
+    void on_ecn(uint32_t in_flight, SteadyTime now);
+
+    void on_timeout(uint32_t in_flight, SteadyTime now);
+
+private:
+
+    enum class Mode : uint8_t {
+        Startup,         // Doubles the delivery rate each round, until it stops growing
+        Drain,           // Drains the queue the startup has built
+        ProbeBandwidth,  // Cycles the gain around the estimated bandwidth-delay product
+        ProbeRTT,        // Drops to a few segments to let the queue drain and measure the propagation time
+    };
+
+    // The maximum of the samples of the last few rounds, as three samples of decreasing
+    //  values and increasing rounds (Kathleen Nichols' windowed min-max filter)
+    struct WindowedMax {
+        struct Sample {
+            uint64_t value;
+            uint32_t round;
+        };
+        std::array<Sample, 3> samples { };
+
+        uint64_t update(uint64_t value, uint32_t round, uint32_t window);
+    };
+
+    // The estimated bandwidth-delay product, or zero until there are samples of both
+    [[nodiscard]] uint64_t bdp() const;
+
+    [[nodiscard]] double gain() const;
+
+    void start_round(const AckEvent& ack);
+
+    void update_mode(const AckEvent& ack);
+
+    uint32_t mss;
+    uint32_t cwnd;
+    // The window to go back to after a loss, or after probing the round-trip time
+    uint32_t prior_cwnd = 0;
+    Mode mode = Mode::Startup;
+    uint8_t cycle_index = 0;
+    // The rounds in a row in which the bandwidth hasn't grown by much
+    uint8_t stalled_rounds = 0;
+    bool full_bandwidth_reached = false;
+    bool recovering = false;
+
+    // Rounds end once the bytes in flight at their start are delivered
+    uint32_t round = 0;
+    uint64_t delivered = 0;
+    uint64_t round_end = 0;
+    uint64_t round_start_delivered = 0;
+    SteadyTime round_start { };
+
+    // In bytes per second
+    WindowedMax bandwidth;
+    uint64_t full_bandwidth = 0;
+
+    std::chrono::nanoseconds min_rtt = std::chrono::nanoseconds::max();
+    SteadyTime min_rtt_stamp { };
+    // When the current phase of the cycle started, or when the probing of the round-trip time ends
+    SteadyTime mode_stamp { };
+};
+
+static_assert(CongestionControl<BBR>);
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <concepts>
+#include <algorithm>
+
+namespace tcpp {
+
+using SteadyTime = std::chrono::steady_clock::time_point;
+
+// What the connection tells its congestion controller on each acknowledgement of new data
+struct AckEvent {
+    // The bytes newly acknowledged, either cumulatively or selectively
+    uint32_t acked;
+    // The bytes in flight before the acknowledgement
+    uint32_t in_flight;
+    // Set while a loss is being recovered from, which the window isn't grown during
+    bool recovering;
+    SteadyTime now;
+};
+
+// RFC 6928
+constexpr uint32_t initial_window(const uint32_t mss) {
+    return std::min(10 * mss, std::max(2 * mss, 14600u));
+}
+
+// The congestion control of a connection, which bounds the bytes in flight by a congestion window
+//  along with the window of the peer. It's chosen at compile time, and is constructed with the
+//  maximum segment size of the peer once the handshake is done. All the sizes are in bytes.
+//  - window(): the congestion window.
+//  - on_ack(ack): on each acknowledgement of new data.
+//  - on_rtt_sample(rtt, now): on each round-trip time measured, which excludes the retransmissions.
+//  - on_loss(in_flight, now): once a loss is detected, at most once per window of data.
+//  - on_ecn(in_flight, now): once the peer echoes a congestion mark (RFC 3168), at most once per
+//     window of data, and not while a loss is being recovered from.
+//  - on_timeout(in_flight, now): once the retransmission timer expires.
+template <typename T>
+concept CongestionControl = std::constructible_from<T, uint32_t> && std::movable<T> && requires(
+    T controller, const T& const_controller, const AckEvent& ack, std::chrono::nanoseconds rtt, uint32_t in_flight, SteadyTime now
+) {
+    { const_controller.window() } -> std::same_as<uint32_t>;
+    controller.on_ack(ack);
+    controller.on_rtt_sample(rtt, now);
+    controller.on_loss(in_flight, now);
+    controller.on_ecn(in_flight, now);
+    controller.on_timeout(in_flight, now);
+};
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include <tcpp/congestion-control/CongestionControl.hpp>
+
+namespace tcpp {
+
+// RFC 9438. Past slow start, the window follows a cubic function of the time since the last congestion
+//  event, which flattens out around the window the congestion happened at, and so probes for more
+//  bandwidth slowly there and quickly away from it, regardless of the round-trip time. It's kept
+//  at least as large as the window Reno would've reached meanwhile.
+class Cubic {
+public:
+
+    explicit Cubic(uint32_t mss_);
+
+    [[nodiscard]] uint32_t window() const { return cwnd; }
+
+    void on_ack(const AckEvent& ack);
+
+    void on_rtt_sample(std::chrono::nanoseconds rtt, SteadyTime now);
+
+    void on_loss(uint32_t in_flight, SteadyTime now);
+
+    void on_ecn(const uint32_t in_flight, const SteadyTime now) { on_loss(in_flight, now); }
+
+    void on_timeout(uint32_t in_flight, SteadyTime now);
+
+private:
+
+    // RFC 9438 - Section 4.1
+    static constexpr double C = 0.4;
+    static constexpr double Beta = 0.7;
+
+    uint32_t mss;
+    uint32_t cwnd;
+    uint32_t ssthresh = UINT32_MAX;
+    // The rest of the windows are in segments. W_max is the window before the last congestion event,
+    //  and W_est the one Reno would have reached since the start of the epoch (RFC 9438 - Section 4.3).
+    double w_max = 0;
+    double w_est = 0;
+    // The time from the start of the epoch at which the cubic function reaches W_max, in seconds
+    double k = 0;
+    // The start of the current congestion avoidance epoch. Unset (zero) until the first acknowledgement in it.
+    SteadyTime epoch_start { };
+    std::chrono::nanoseconds smoothed_rtt { 0 };
+};
+
+static_assert(CongestionControl<Cubic>);
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include <tcpp/congestion-control/CongestionControl.hpp>
+
+namespace tcpp {
+
+// RFC 5681, along with the recovery of RFC 6582, which the connection carries out. The window grows
+//  by the bytes acknowledged in slow start, and by a segment per window in congestion avoidance.
+//  It's halved on each congestion signal, and drops to a single segment on a timeout.
+class NewReno {
+public:
+
+    explicit NewReno(uint32_t mss_);
+
+    [[nodiscard]] uint32_t window() const { return cwnd; }
+
+    void on_ack(const AckEvent& ack);
+
+    void on_rtt_sample(std::chrono::nanoseconds, SteadyTime) { }
+
+    void on_loss(uint32_t in_flight, SteadyTime now);
+
+    void on_ecn(const uint32_t in_flight, const SteadyTime now) { on_loss(in_flight, now); }
+
+    void on_timeout(uint32_t in_flight, SteadyTime now);
+
+private:
+
+    uint32_t mss;
+    uint32_t cwnd;
+    uint32_t ssthresh = UINT32_MAX;
+    // Acknowledged in congestion avoidance since the window last grew
+    uint32_t bytes_acked = 0;
+};
+
+static_assert(CongestionControl<NewReno>);
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
+
+namespace tcpp {
+
+// A single-producer single-consumer ring of bytes, for the streams of the connections. The bytes are
+//  written and read with (at most two) memcpys, and can be read and written in place as well.
+// A mirrored ring maps its memory twice, back to back, so that the bytes that wrap around the end of
+//  the ring continue right after it in memory. Any range of the ring is then contiguous, so the regions
+//  are always handed in a single piece. This requires the capacity to be a multiple of the page size.
+class ByteRing {
+public:
+
+    // The bytes available for reading in place, in order. The second region is
+    //  empty unless the bytes wrap around the end of a ring that isn't mirrored.
+    using Regions = std::array<std::span<const uint8_t>, 2>;
+
+    // The capacity is rounded up to a power of two, and to the page size if mirrored
+    explicit ByteRing(size_t capacity_, bool mirrored_ = false);
+
+    ByteRing(const ByteRing&) = delete;
+
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    ~ByteRing();
+
+    // Producer side
+
+    // Writes as many of the bytes as there's room for. Returns the number of bytes written.
+    size_t write(std::span<const uint8_t> bytes) {
+        auto push = push_position.load(std::memory_order::relaxed);
+        auto count = std::min(bytes.size(), free_bytes(push, bytes.size()));
+        auto offset = push & (ring_capacity - 1);
+        auto first = mirror ? count : std::min(count, ring_capacity - offset);
+        std::memcpy(data + offset, bytes.data(), first);
+        std::memcpy(data, bytes.data() + first, count - first);
+        push_position.store(push + count, std::memory_order::release);
+        return count;
+    }
+
+    // The free space, up to where the ring wraps around unless it's mirrored. The producer writes
+    //  the bytes in place, then publishes the first count of them with commit_write(count).
+    std::span<uint8_t> writable_region() {
+        auto push = push_position.load(std::memory_order::relaxed);
+        auto offset = push & (ring_capacity - 1);
+        auto contiguous = mirror ? ring_capacity : ring_capacity - offset;
+        return { data + offset, std::min(contiguous, free_bytes(push, contiguous)) };
+    }
+
+    void commit_write(const size_t count) {
+        push_position.store(push_position.load(std::memory_order::relaxed) + count, std::memory_order::release);
+    }
+
+    // The room left for the producer
+    [[nodiscard]] size_t free_space() {
+        return free_bytes(push_position.load(std::memory_order::relaxed), ring_capacity);
+    }
+
+    // Consumer side
+
+    // Reads as many bytes as are available and fit. Returns the number of bytes read.
+    size_t read(std::span<uint8_t> bytes) {
+        auto regions = readable_regions(bytes.size());
+        auto first = std::min(bytes.size(), regions[0].size());
+        auto second = std::min(bytes.size() - first, regions[1].size());
+        std::memcpy(bytes.data(), regions[0].data(), first);
+        std::memcpy(bytes.data() + first, regions[1].data(), second);
+        consume(first + second);
+        return first + second;
+    }
+
+    // The bytes available, in place. They remain valid until they're released with consume().
+    Regions readable_regions(const size_t wanted = SIZE_MAX) {
+        auto pop = pop_position.load(std::memory_order::relaxed);
+        auto count = filled_bytes(pop, wanted);
+        auto offset = pop & (ring_capacity - 1);
+        auto first = mirror ? count : std::min(count, ring_capacity - offset);
+        return { std::span<const uint8_t> { data + offset, first }, std::span<const uint8_t> { data, count - first } };
+    }
+
+    void consume(const size_t count) {
+        pop_position.store(pop_position.load(std::memory_order::relaxed) + count, std::memory_order::release);
+    }
+
+    // Copies the bytes starting at the offset past the first available one, without
+    //  consuming them. Returns the number of bytes copied, which may be less than asked.
+    size_t peek(const size_t offset, std::span<uint8_t> bytes) {
+        auto pop = pop_position.load(std::memory_order::relaxed);
+        auto available = filled_bytes(pop, offset + bytes.size());
+        if (available <= offset) return 0;
+        auto count = std::min(bytes.size(), available - offset);
+        auto start = (pop + offset) & (ring_capacity - 1);
+        auto first = mirror ? count : std::min(count, ring_capacity - start);
+        std::memcpy(bytes.data(), data + start, first);
+        std::memcpy(bytes.data() + first, data, count - first);
+        return count;
+    }
+
+    // The number of bytes available to the consumer
+    [[nodiscard]] size_t size() {
+        return filled_bytes(pop_position.load(std::memory_order::relaxed), SIZE_MAX);
+    }
+
+    // Only meaningful to the consumer. The ring may stop being empty right after.
+    [[nodiscard]] bool empty() const {
+        return push_position.load(std::memory_order::acquire) == pop_position.load(std::memory_order::relaxed);
+    }
+
+    [[nodiscard]] size_t capacity() const { return ring_capacity; }
+
+    [[nodiscard]] bool mirrored() const { return mirror; }
+
+private:
+
+    // Refreshes the cached cursor of the other side only if fewer bytes than wanted are known to be available
+    size_t free_bytes(const size_t push, const size_t wanted) {
+        if (ring_capacity - (push - cached_pop_position) < wanted) {
+            cached_pop_position = pop_position.load(std::memory_order::acquire);
+        }
+        return ring_capacity - (push - cached_pop_position);
+    }
+
+    size_t filled_bytes(const size_t pop, const size_t wanted) {
+        if (cached_push_position - pop < wanted) {
+            cached_push_position = push_position.load(std::memory_order::acquire);
+        }
+        return std::min(wanted, cached_push_position - pop);
+    }
+
+    size_t ring_capacity;
+    bool mirror;
+    // Twice the capacity when mirrored
+    size_t mapping_size;
+    uint8_t* data = nullptr;
+
+    // The positions keep increasing, the same way as the cursors of the SPSCBoundedWaitFreeQueue
+
+    // Loaded and stored by the producer, loaded only by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> push_position { };
+    // Exclusive to the producer
+    alignas(CACHE_LINE_SIZE) size_t cached_pop_position { };
+    // Loaded and stored by the consumer, loaded only by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> pop_position { };
+    // Exclusive to the consumer
+    alignas(CACHE_LINE_SIZE) size_t cached_push_position { };
+
+    // To avoid false sharing with any adjacent data
+    char padding_[CACHE_LINE_SIZE - sizeof(cached_push_position)] { };
+};
+
+}
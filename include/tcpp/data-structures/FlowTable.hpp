@@ -0,0 +1,296 @@
+#pragma once
+
+#include <bit>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+#include <tcpp/utils/EpochReclaimer.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace tcpp {
+
+// An open-addressing hash table with a fixed capacity, laid out the way
+//  of a swiss table. The slots are split into groups of 16, each with a
+//  control byte per slot holding 7 bits of the hash of its key. A lookup
+//  compares the 16 control bytes of a group at once, and only visits the
+//  slots that match, so it mostly touches the group and the entry itself.
+// Lookups take no locks. Insertions and erasures take one of a set of
+//  striped locks, chosen by the hash of the key, so that inserting the
+//  same key twice is serialized while unrelated keys proceed in parallel.
+// The entries are allocated separately and never move, so the references
+//  handed out remain valid. Erased entries are retired to the reclaimer,
+//  since a lookup may still be reading them.
+// The slots of the erased entries lengthen the probes until they're taken
+//  again. Once there are too many of them, the groups are rebuilt without
+//  them, and swapped with the old ones, which are retired as well.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlowTable {
+
+    static constexpr size_t GroupSize = 16;
+    static constexpr size_t StripesCount = 64;
+
+    // The control bytes of the free slots have their high bit set, while the ones of the
+    //  full slots hold the low 7 bits of the hash. A lookup stops at the first group with an
+    //  empty slot, which is why erased slots are marked as deleted instead of as empty.
+    static constexpr uint8_t Empty = 0x80;
+    static constexpr uint8_t Deleted = 0xFE;
+
+    struct Node {
+        template <typename... Args>
+        explicit Node(const Key& key_, Args&&... args) : key(key_), value(std::forward<Args>(args)...) { }
+
+        const Key key;
+        Value value;
+    };
+
+    struct alignas(64) Group {
+        // The 16 control bytes, 8 per word, so that they're read atomically
+        std::atomic<uint64_t> control[2] = { ~0ULL / 0xFF * Empty, ~0ULL / 0xFF * Empty };
+        std::atomic<Node*> slots[GroupSize] = { };
+    };
+
+public:
+
+    // The capacity is rounded up to a power of two, and at most 7/8 of it is used
+    explicit FlowTable(EpochReclaimer& reclaimer_, size_t capacity = 1 << 16)
+        : reclaimer(reclaimer_),
+          groups_count(std::bit_ceil(std::max(capacity, GroupSize) / GroupSize)),
+          max_size(groups_count * GroupSize / 8 * 7),
+          groups(new Group[groups_count]),
+          stripes(std::make_unique<std::mutex[]>(StripesCount)) { }
+
+    FlowTable(const FlowTable&) = delete;
+
+    FlowTable& operator=(const FlowTable&) = delete;
+
+    // Constructs the value in place from the arguments, unless the key exists. Returns the value with the key
+    //  along with whether it was inserted. The value is null if the table is full or has been made read-only.
+    template <typename... Args>
+    std::pair<Value*, bool> emplace(const Key& key, Args&&... args) {
+        const auto hash = Hash{}(key);
+        std::lock_guard lock(stripes[(hash >> 7) % StripesCount]);
+        if (auto node = find_node(key, hash); node != nullptr) {
+            return { &node->value, false };
+        }
+        // TODO review memory orders
+        if (is_read_only) return { nullptr, false };
+        // Reserved up front, so that there's always a free slot left for the writers of the other stripes
+        if (entries_count.fetch_add(1, std::memory_order_relaxed) >= max_size) {
+            entries_count.fetch_sub(1, std::memory_order_relaxed);
+            return { nullptr, false };
+        }
+
+        auto node = new Node(key, std::forward<Args>(args)...);
+        place(groups.load(std::memory_order_relaxed), node, hash);
+        return { &node->value, true };
+    }
+
+    [[nodiscard]] Value* find(const Key& key) const {
+        auto node = find_node(key, Hash{}(key));
+        return node == nullptr ? nullptr : &node->value;
+    }
+
+    [[nodiscard]] bool contains(const Key& key) const { return find(key) != nullptr; }
+
+    bool erase(const Key& key) {
+        const auto hash = Hash{}(key);
+        {
+            std::lock_guard lock(stripes[(hash >> 7) % StripesCount]);
+            if (is_read_only) return false;
+            const auto node = find_node(key, hash, [&](Group& group, size_t slot, Node* node) {
+                // Unpublished before the slot is freed, so that no writer claims it while it still holds the node
+                group.slots[slot].store(nullptr, std::memory_order_release);
+                set_control(group, slot, Deleted);
+                deleted_count.fetch_add(1, std::memory_order_relaxed);
+                entries_count.fetch_sub(1, std::memory_order_relaxed);
+                reclaimer.retire(node);
+            });
+            if (node == nullptr) return false;
+        }
+        if (deleted_count.load(std::memory_order_relaxed) > max_deleted()) rebuild();
+        return true;
+    }
+
+    // Calls the function with each of the keys and values. This is meant to be called once the
+    //  table is read-only, otherwise, the entries inserted or erased meanwhile may be skipped.
+    void for_each(auto&& func) {
+        const auto groups = this->groups.load(std::memory_order_acquire);
+        for (size_t i = 0; i < groups_count; i++) {
+            for (auto& slot : groups[i].slots) {
+                if (auto node = slot.load(std::memory_order_acquire); node != nullptr) {
+                    func(node->key, node->value);
+                }
+            }
+        }
+    }
+
+    void set_read_only() {
+        // Used before destruction, to ensure that no elements are
+        // inserted or removed while the entries are iterated over
+        is_read_only = true;
+    }
+
+    [[nodiscard]] size_t size() const { return entries_count.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] size_t capacity() const { return max_size; }
+
+    // The number of groups a lookup of the key visits
+    [[nodiscard]] size_t probe_length(const Key& key) const {
+        size_t length = 0;
+        find_node(key, Hash{}(key), [](auto&&...) { }, &length);
+        return length;
+    }
+
+    ~FlowTable() noexcept {
+        const auto groups = this->groups.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < groups_count; i++) {
+            for (auto& slot : groups[i].slots) {
+                delete slot.load(std::memory_order_relaxed);
+            }
+        }
+        delete[] groups;
+    }
+
+private:
+
+    // Probes the groups in the triangular sequence, which visits all of them since their count is a power of two.
+    //  Calls on_found with the slot of the key, if any, and returns the node. Counts the groups visited in length.
+    Node* find_node(const Key& key, const size_t hash, auto&& on_found, size_t* length = nullptr) const {
+        // The groups at the start of the lookup, which are kept until it's over even if they're swapped meanwhile
+        const auto groups = this->groups.load(std::memory_order_acquire);
+        const auto h2 = static_cast<uint8_t>(hash & 0x7F);
+        size_t index = hash >> 7;
+        for (size_t step = 1; step <= groups_count; index += step++) {
+            if (length != nullptr) ++*length;
+            auto& group = groups[index & (groups_count - 1)];
+            const auto lo = group.control[0].load(std::memory_order_acquire);
+            const auto hi = group.control[1].load(std::memory_order_acquire);
+            for (auto matches = match(lo, hi, h2); matches != 0; matches &= matches - 1) {
+                auto slot = static_cast<size_t>(std::countr_zero(matches));
+                auto node = group.slots[slot].load(std::memory_order_acquire);
+                // Null if the entry is still being inserted, or is being erased
+                if (node != nullptr && node->key == key) {
+                    on_found(group, slot, node);
+                    return node;
+                }
+            }
+            if (match(lo, hi, Empty) != 0) {
+                // Had the key been inserted, it would've taken this slot or an earlier one
+                break;
+            }
+        }
+        return nullptr;
+    }
+
+    Node* find_node(const Key& key, const size_t hash) const {
+        return find_node(key, hash, [](auto&&...) { });
+    }
+
+    // A mask with the bit of each of the slots with the control byte set
+    static uint32_t match(const uint64_t lo, const uint64_t hi, const uint8_t byte) {
+#if defined(__SSE2__)
+        auto control = _mm_set_epi64x(static_cast<long long>(hi), static_cast<long long>(lo));
+        auto equal = _mm_cmpeq_epi8(control, _mm_set1_epi8(static_cast<char>(byte)));
+        return static_cast<uint32_t>(_mm_movemask_epi8(equal));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GroupSize; i++) {
+            auto word = i < 8 ? lo : hi;
+            if (static_cast<uint8_t>(word >> (i % 8 * 8)) == byte) mask |= 1U << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Puts the node in the first free slot of its probe sequence. Called with the stripe of the key locked.
+    void place(Group* groups, Node* node, const size_t hash) {
+        const auto h2 = static_cast<uint8_t>(hash & 0x7F);
+        for (size_t index = hash >> 7, step = 1; ; index += step++) {
+            auto& group = groups[index & (groups_count - 1)];
+            const auto lo = group.control[0].load(std::memory_order_acquire);
+            const auto hi = group.control[1].load(std::memory_order_acquire);
+            const auto deleted = match(lo, hi, Deleted);
+            for (auto free = match(lo, hi, Empty) | deleted; free != 0; free &= free - 1) {
+                auto slot = static_cast<size_t>(std::countr_zero(free));
+                // Claimed by a writer of another stripe in between? Move on to the next free slot.
+                if (claim_slot(group, slot, h2)) {
+                    // A deleted slot is reused
+                    if (deleted & (1U << slot)) deleted_count.fetch_sub(1, std::memory_order_relaxed);
+                    // A lookup that matches the byte meanwhile skips the slot until the node is published
+                    group.slots[slot].store(node, std::memory_order_release);
+                    return;
+                }
+            }
+        }
+    }
+
+    // The deleted slots tolerated. Half of the slots a full table leaves free, so that the other half is
+    //  still empty, and ends the probes.
+    [[nodiscard]] size_t max_deleted() const { return (groups_count * GroupSize - max_size) / 2; }
+
+    // Moves the entries to fresh groups, without any deleted slots, then swaps the groups. The lookups that
+    //  started before the swap go on in the old groups, which are retired, and which still hold the entries.
+    //  Every stripe is locked meanwhile, in order, so that none of the entries is inserted or erased.
+    void rebuild() {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(StripesCount);
+        for (size_t i = 0; i < StripesCount; i++) locks.emplace_back(stripes[i]);
+        // Rebuilt by another erasure meanwhile?
+        if (deleted_count.load(std::memory_order_relaxed) <= max_deleted()) return;
+
+        const auto old = groups.load(std::memory_order_relaxed);
+        const auto fresh = new Group[groups_count];
+        for (size_t i = 0; i < groups_count; i++) {
+            for (auto& slot : old[i].slots) {
+                if (auto node = slot.load(std::memory_order_relaxed); node != nullptr) {
+                    place(fresh, node, Hash{}(node->key));
+                }
+            }
+        }
+        groups.store(fresh, std::memory_order_release);
+        deleted_count.store(0, std::memory_order_relaxed);
+        reclaimer.retire(new std::unique_ptr<Group[]>(old));
+    }
+
+    // Sets the control byte of the slot, as long as the slot is free if only_if_free is set
+    static bool exchange_control(Group& group, const size_t slot, const uint8_t byte, const bool only_if_free) {
+        auto& word = group.control[slot / 8];
+        const auto shift = slot % 8 * 8;
+        auto old = word.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do {
+            auto current = static_cast<uint8_t>(old >> shift);
+            if (only_if_free && current != Empty && current != Deleted) return false;
+            desired = (old & ~(0xFFULL << shift)) | static_cast<uint64_t>(byte) << shift;
+        } while (!word.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_relaxed));
+        return true;
+    }
+
+    static bool claim_slot(Group& group, const size_t slot, const uint8_t byte) {
+        return exchange_control(group, slot, byte, true);
+    }
+
+    static void set_control(Group& group, const size_t slot, const uint8_t byte) {
+        exchange_control(group, slot, byte, false);
+    }
+
+    EpochReclaimer& reclaimer;
+    const size_t groups_count;
+    const size_t max_size;
+    // Swapped with fresh ones by rebuild(), and owned by the table otherwise
+    std::atomic<Group*> groups;
+    std::unique_ptr<std::mutex[]> stripes;
+    std::atomic<size_t> entries_count = 0;
+    std::atomic<size_t> deleted_count = 0;
+    std::atomic<bool> is_read_only = false;
+};
+
+}
@@ -4,16 +4,77 @@
 
 namespace tcpp {
 
+// Same as the MPSC queue, except that the consumers claim positions with a CAS on the pop position as well
 template <typename T, size_t Capacity, typename Alloc = std::allocator<T>>
 requires PowerOfTwo<Capacity>
 class MPMCBoundedQueue : public MPSCBoundedQueue<T, Capacity, Alloc> {
 
+    using Base = MPSCBoundedQueue<T, Capacity, Alloc>;
+
 public:
 
     std::optional<T> pop() {
-        std::lock_guard lock(this->m);
-        return SPSCBoundedWaitFreeQueue<T, Capacity, Alloc>::pop();
+        auto position = this->pop_position.load(std::memory_order::relaxed);
+        while (true) {
+            auto& slot = this->slot_at(position);
+            auto sequence = slot.sequence.load(std::memory_order::acquire);
+            auto difference = static_cast<ptrdiff_t>(sequence - (position + 1));
+            if (difference == 0) {
+                // The element is ready. Claim it.
+                if (this->pop_position.compare_exchange_weak(position, position + 1, std::memory_order::relaxed)) {
+                    return take(slot, position);
+                }
+            } else if (difference < 0) {
+                // Empty
+                return std::nullopt;
+            } else {
+                // Another consumer took this position
+                position = this->pop_position.load(std::memory_order::relaxed);
+            }
+        }
+    }
+
+    // Claims as many of the ready elements as fit in the span with a single CAS, then takes them.
+    //  The elements past the pop position can only stop being ready once claimed, so whatever was
+    //  seen ready before the CAS is still there after it succeeds.
+    size_t pop_n(std::span<T> elements) {
+        auto position = this->pop_position.load(std::memory_order::relaxed);
+        while (!elements.empty()) {
+            size_t count = 0;
+            while (count < elements.size() &&
+                   this->slot_at(position + count).sequence.load(std::memory_order::acquire) == position + count + 1) {
+                count++;
+            }
+            if (count == 0) {
+                auto sequence = this->slot_at(position).sequence.load(std::memory_order::acquire);
+                if (static_cast<ptrdiff_t>(sequence - (position + 1)) < 0) {
+                    // Empty
+                    return 0;
+                }
+                // Another consumer took this position
+                position = this->pop_position.load(std::memory_order::relaxed);
+                continue;
+            }
+            if (this->pop_position.compare_exchange_weak(position, position + count, std::memory_order::relaxed)) {
+                for (size_t i = 0; i < count; i++) {
+                    elements[i] = std::move(take(this->slot_at(position + i), position + i).value());
+                }
+                return count;
+            }
+        }
+        return 0;
+    }
+
+private:
+
+    // The position is already claimed, so unlike the single consumer, this doesn't advance it
+    std::optional<T> take(typename Base::Slot& slot, const size_t position) {
+        auto element = slot.element();
+        std::optional<T> result = std::move(*element);
+        std::destroy_at(element);
+        slot.sequence.store(position + Capacity, std::memory_order::release);
+        return result;
     }
 };
 
-}
\ No newline at end of file
+}
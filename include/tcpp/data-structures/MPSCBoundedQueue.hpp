@@ -1,24 +1,151 @@
 #pragma once
 
+#include <new>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <optional>
+
+#include <tcpp/utils/Concepts.hpp>
 #include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
 
 namespace tcpp {
 
+// A lock-free bounded queue with a sequence number in each of its slots (Dmitry Vyukov's design).
+// The sequence of a slot tells whose turn it is: it equals the push position when the slot is
+//  free for that push, and the push position + 1 once the element is in it, ready to be popped.
+// Popping sets it to the position of the push one lap later. The producers claim positions
+//  with a CAS on the push position, and the consumer only touches the pop position.
 template <typename T, size_t Capacity, typename Alloc = std::allocator<T>>
 requires PowerOfTwo<Capacity>
-class MPSCBoundedQueue : public SPSCBoundedWaitFreeQueue<T, Capacity, Alloc> {
+class MPSCBoundedQueue {
 
 protected:
 
-    std::mutex m;
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* element() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+    using slot_allocator_traits = std::allocator_traits<SlotAlloc>;
 
 public:
 
+    using value_type = T;
+    using size_type = decltype(Capacity);
+
+    MPSCBoundedQueue() : slots(slot_allocator_traits::allocate(slot_allocator, Capacity)) {
+        for (size_t i = 0; i < Capacity; i++) {
+            auto slot = ::new (&slots[i]) Slot;
+            slot->sequence.store(i, std::memory_order::relaxed);
+        }
+    }
+
+    MPSCBoundedQueue(const MPSCBoundedQueue&) = delete;
+
+    MPSCBoundedQueue& operator=(const MPSCBoundedQueue&) = delete;
+
     template <typename... Args>
     bool push(Args&&... args) {
-        std::lock_guard lock(m);
-        return SPSCBoundedWaitFreeQueue<T, Capacity, Alloc>::push(std::forward<Args>(args)...);
+        auto position = push_position.load(std::memory_order::relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slot_at(position);
+            auto sequence = slot->sequence.load(std::memory_order::acquire);
+            auto difference = static_cast<ptrdiff_t>(sequence - position);
+            if (difference == 0) {
+                // The slot is free for this position. Claim it.
+                if (push_position.compare_exchange_weak(position, position + 1, std::memory_order::relaxed)) break;
+            } else if (difference < 0) {
+                // The slot still holds the element of the previous lap
+                return false;
+            } else {
+                // Another producer claimed this position
+                position = push_position.load(std::memory_order::relaxed);
+            }
+        }
+        ::new (slot->storage) T(std::forward<Args>(args)...);
+        slot->sequence.store(position + 1, std::memory_order::release);
+        return true;
+    }
+
+    // Pushes as many of the elements as possible.
+    // Returns the number of elements pushed, which is less than the size of the span only if the queue got full.
+    size_t push_n(std::span<const T> elements) {
+        for (size_t i = 0; i < elements.size(); i++) {
+            if (!push(elements[i])) return i;
+        }
+        return elements.size();
+    }
+
+    std::optional<value_type> pop() {
+        auto position = pop_position.load(std::memory_order::relaxed);
+        auto& slot = slot_at(position);
+        if (slot.sequence.load(std::memory_order::acquire) != position + 1) return std::nullopt;
+        return take(slot, position);
+    }
+
+    // Pops as many elements as are ready and fit in the span, storing the pop position once for all of them.
+    // Returns the number of elements popped.
+    size_t pop_n(std::span<T> elements) {
+        auto position = pop_position.load(std::memory_order::relaxed);
+        size_t count = 0;
+        while (count < elements.size()) {
+            auto& slot = slot_at(position + count);
+            if (slot.sequence.load(std::memory_order::acquire) != position + count + 1) break;
+            auto element = slot.element();
+            elements[count] = std::move(*element);
+            std::destroy_at(element);
+            slot.sequence.store(position + count + Capacity, std::memory_order::release);
+            count++;
+        }
+        pop_position.store(position + count, std::memory_order::relaxed);
+        return count;
+    }
+
+    // Only meaningful to the consumers. The queue may stop being empty right after.
+    bool empty() const {
+        auto position = pop_position.load(std::memory_order::relaxed);
+        return slot_at(position).sequence.load(std::memory_order::acquire) != position + 1;
     }
+
+    ~MPSCBoundedQueue() {
+        auto position = pop_position.load(std::memory_order::relaxed);
+        while (slot_at(position).sequence.load(std::memory_order::acquire) == position + 1) {
+            std::destroy_at(slot_at(position).element());
+            position++;
+        }
+        slot_allocator_traits::deallocate(slot_allocator, slots, Capacity);
+    }
+
+protected:
+
+    Slot& slot_at(const size_t position) const { return slots[position & (Capacity - 1)]; }
+
+    std::optional<value_type> take(Slot& slot, const size_t position) {
+        auto element = slot.element();
+        std::optional<value_type> result = std::move(*element);
+        std::destroy_at(element);
+        // Free for the push one lap later
+        slot.sequence.store(position + Capacity, std::memory_order::release);
+        pop_position.store(position + 1, std::memory_order::relaxed);
+        return result;
+    }
+
+    [[no_unique_address]] SlotAlloc slot_allocator;
+    Slot* slots;
+
+    // The positions keep increasing forever, and wrap around the slots.
+    //  Given that they're 64-bits, it's very unlikely that any of them will overflow.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> push_position = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> pop_position = 0;
+
+    // To avoid false sharing with any adjacent data
+    char padding_[CACHE_LINE_SIZE - sizeof(pop_position)] { };
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/utils/Connections.hpp>
+#include <tcpp/utils/EpochReclaimer.hpp>
+
+namespace tcpp {
+
+// Maps the local endpoints to what's bound to them, indexed directly by the port. Each
+//  port has a second level for the addresses bound on it, along with a wildcard
+//  (AnyAddress) binding that matches the addresses without a binding of their own.
+// Lookups take no locks. The bindings of a port are never modified in place. Instead,
+//  the writers, which are serialized, publish a modified copy of them, RCU-style.
+// The replaced bindings and the unbound values are retired to
+//  the reclaimer, since a lookup may still be reading them, unless
+//  the values are detached, in which case the caller keeps them.
+template <typename Value>
+class PortDemux {
+
+    struct Bindings {
+        Value* wildcard = nullptr;
+        std::vector<std::pair<IpAddress, Value*>> addresses;
+    };
+
+    static constexpr size_t PortsCount = 1 << 16;
+
+public:
+
+    explicit PortDemux(EpochReclaimer& reclaimer_)
+        : reclaimer(reclaimer_),
+          ports(std::make_unique<std::atomic<Bindings*>[]>(PortsCount)) { }
+
+    PortDemux(const PortDemux&) = delete;
+
+    PortDemux& operator=(const PortDemux&) = delete;
+
+    // Constructs the value in place from the arguments. Returns null if the endpoint is already bound.
+    template <typename... Args>
+    Value* bind(const Endpoint endpoint, Args&&... args) {
+        std::lock_guard lock(writers);
+        auto& slot = ports[endpoint.port];
+        auto current = slot.load(std::memory_order_relaxed);
+        if (current != nullptr && find_in(*current, endpoint.ip, false) != nullptr) {
+            return nullptr;
+        }
+
+        auto value = new Value(std::forward<Args>(args)...);
+        auto updated = current == nullptr ? new Bindings { } : new Bindings { *current };
+        if (endpoint.ip == AnyAddress) {
+            updated->wildcard = value;
+        } else {
+            updated->addresses.emplace_back(endpoint.ip, value);
+        }
+        publish(slot, updated);
+        return value;
+    }
+
+    // The value is retired along with the bindings. Returns whether the endpoint was bound.
+    bool unbind(const Endpoint endpoint) {
+        auto value = detach(endpoint);
+        if (value == nullptr) {
+            return false;
+        }
+        reclaimer.retire(value.release());
+        return true;
+    }
+
+    // Unbinds the endpoint, and hands its value over to the caller instead of retiring it,
+    //  for when it has to outlive the readers. Null if the endpoint wasn't bound.
+    std::unique_ptr<Value> detach(const Endpoint endpoint) {
+        std::lock_guard lock(writers);
+        auto& slot = ports[endpoint.port];
+        auto current = slot.load(std::memory_order_relaxed);
+        auto value = current == nullptr ? nullptr : find_in(*current, endpoint.ip, false);
+        if (value == nullptr) {
+            return nullptr;
+        }
+
+        auto updated = new Bindings { *current };
+        if (endpoint.ip == AnyAddress) {
+            updated->wildcard = nullptr;
+        } else {
+            std::erase_if(updated->addresses, [&](auto& binding) { return binding.first == endpoint.ip; });
+        }
+        publish(slot, updated);
+        return std::unique_ptr<Value>(value);
+    }
+
+    // The value bound to the exact address, or the wildcard one of the port. Null if neither is bound.
+    [[nodiscard]] Value* find(const Endpoint endpoint) const {
+        auto bindings = ports[endpoint.port].load(std::memory_order_acquire);
+        return bindings == nullptr ? nullptr : find_in(*bindings, endpoint.ip, true);
+    }
+
+    ~PortDemux() noexcept {
+        for (size_t port = 0; port < PortsCount; port++) {
+            if (auto bindings = ports[port].load(std::memory_order_relaxed); bindings != nullptr) {
+                delete bindings->wildcard;
+                for (auto [_, value] : bindings->addresses) {
+                    delete value;
+                }
+                delete bindings;
+            }
+        }
+    }
+
+private:
+
+    static Value* find_in(const Bindings& bindings, const IpAddress ip, const bool fallback_to_wildcard) {
+        if (ip == AnyAddress) {
+            return bindings.wildcard;
+        }
+        for (auto [address, value] : bindings.addresses) {
+            if (address == ip) return value;
+        }
+        return fallback_to_wildcard ? bindings.wildcard : nullptr;
+    }
+
+    // Called with the writers lock held
+    void publish(std::atomic<Bindings*>& slot, Bindings* updated) {
+        if (auto old = slot.exchange(updated, std::memory_order_acq_rel); old != nullptr) {
+            reclaimer.retire(old);
+        }
+    }
+
+    EpochReclaimer& reclaimer;
+
+    // 64K pointers, one per port, most of which stay null
+    std::unique_ptr<std::atomic<Bindings*>[]> ports;
+
+    std::mutex writers;
+};
+
+}
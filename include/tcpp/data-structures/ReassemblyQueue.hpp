@@ -0,0 +1,153 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/allocators/PacketHandle.hpp>
+#include <tcpp/utils/SequenceNumbers.hpp>
+
+namespace tcpp {
+
+// The segments received ahead of a hole in the sequence space, held in their buffers as they arrived
+//  until the hole is filled. They're kept sorted by their sequence numbers, without any overlaps: the
+//  parts of a new segment that are already held are trimmed off, and the segments it fully covers are
+//  replaced by it. The number of segments held is bounded, and the ones furthest ahead are given up
+//  first to make room for the ones closer to the hole.
+class ReassemblyQueue {
+public:
+
+    struct Segment {
+        // The payload covers seq up to end, not including it. A fin follows it if set.
+        uint32_t seq;
+        uint32_t end;
+        bool fin;
+        // Where the payload starts in the buffer
+        uint16_t offset;
+        PacketHandle packet;
+
+        [[nodiscard]] std::span<const uint8_t> payload() const {
+            return { packet.get() + offset, end - seq };
+        }
+    };
+
+    // A contiguous range of the sequence space covered by the segments held, not including its end
+    struct Range {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    explicit ReassemblyQueue(const size_t capacity_ = 256) : capacity(capacity_) {
+        segments.reserve(capacity);
+    }
+
+    // Takes the ownership of the packet, whose payload starts at the offset and at the sequence number.
+    //  Returns false if none of it is kept, in which case the packet is left to the caller.
+    bool insert(const PacketBuffer packet, const size_t offset, const uint32_t seq, const size_t length, const bool fin) {
+        Segment segment {
+            .seq = seq,
+            .end = static_cast<uint32_t>(seq + length),
+            .fin = fin,
+            .offset = static_cast<uint16_t>(offset),
+            .packet = { },
+        };
+
+        // Nothing is taken past a fin, and the segments before it are trimmed to it below
+        if (!segments.empty() && segments.back().fin && seq_le(limit(segments.back()), segment.seq)) return false;
+
+        // The first segment that ends after the new one starts, which is the only one that may overlap its start
+        auto it = std::find_if(segments.begin(), segments.end(), [&](auto& held) {
+            return seq_lt(segment.seq, limit(held));
+        });
+        if (it != segments.end() && seq_le(it->seq, segment.seq)) {
+            // Nothing new in it, or something past the fin
+            if (seq_le(limit(segment), limit(*it)) || it->fin) return false;
+            segment.offset = static_cast<uint16_t>(segment.offset + (it->end - segment.seq));
+            segment.seq = it->end;
+            ++it;
+        }
+        // The segments fully covered by the new one are replaced by it
+        auto covered = it;
+        while (covered != segments.end() && seq_le(limit(*covered), limit(segment))) {
+            ++covered;
+        }
+        it = segments.erase(it, covered);
+        // The part overlapping the next segment is trimmed off the end
+        if (it != segments.end() && seq_lt(it->seq, limit(segment))) {
+            segment.end = it->seq;
+            segment.fin = false;
+            if (segment.end == segment.seq) return false;
+        }
+
+        const auto index = it - segments.begin();
+        if (segments.size() == capacity) {
+            // The segment furthest ahead makes room for this one, unless it's this one
+            if (it == segments.end()) return false;
+            segments.pop_back();
+        }
+        segment.packet = PacketHandle { packet };
+        segments.insert(segments.begin() + index, std::move(segment));
+        return true;
+    }
+
+    // The segment closest to the hole, if any
+    [[nodiscard]] Segment* front() {
+        return segments.empty() ? nullptr : &segments.front();
+    }
+
+    void pop_front() {
+        segments.erase(segments.begin());
+    }
+
+    // The ranges held, with the adjacent segments merged, as many as fit. The one holding the recent sequence
+    //  number goes first, if any, and the rest follow in order (RFC 2018 - Section 4). Returns their count.
+    size_t ranges(const std::span<Range> result, const uint32_t recent) const {
+        if (result.empty()) return 0;
+        // The first one is left for the recent range until it's found
+        size_t count = 1;
+        bool recent_found = false;
+        auto add = [&](const Range range) {
+            if (!recent_found && seq_le(range.begin, recent) && seq_lt(recent, range.end)) {
+                result[0] = range;
+                recent_found = true;
+            } else if (count < result.size()) {
+                result[count++] = range;
+            }
+        };
+        std::optional<Range> current;
+        for (auto& segment : segments) {
+            if (current && current->end == segment.seq) {
+                current->end = limit(segment);
+                continue;
+            }
+            if (current) add(*current);
+            current = Range { segment.seq, limit(segment) };
+        }
+        if (current) add(*current);
+        if (!recent_found) {
+            std::move(result.begin() + 1, result.begin() + static_cast<ptrdiff_t>(count), result.begin());
+            count--;
+        }
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const { return segments.empty(); }
+
+    [[nodiscard]] size_t size() const { return segments.size(); }
+
+    void clear() { segments.clear(); }
+
+private:
+
+    // The end of the sequence space the segment occupies, including the fin
+    static uint32_t limit(const Segment& segment) { return segment.end + (segment.fin ? 1 : 0); }
+
+    const size_t capacity;
+    std::vector<Segment> segments;
+};
+
+}
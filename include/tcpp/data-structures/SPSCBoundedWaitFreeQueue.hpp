@@ -1,8 +1,11 @@
 #pragma once
 
+#include <span>
 #include <atomic>
 #include <memory>
 #include <optional>
+#include <algorithm>
+#include <type_traits>
 
 #include <tcpp/utils/Concepts.hpp>
 
@@ -42,6 +45,70 @@ public:
         return result;
     }
 
+    // Pushes as many of the elements as there's room for, loading the pop
+    //  cursor at most once and storing the push cursor once for all of them.
+    // Returns the number of elements pushed.
+    size_t push_n(std::span<const value_type> elements) {
+        auto push_val = push_ptr.load(std::memory_order::relaxed);
+        auto count = std::min<size_type>(elements.size(), free_slots(push_val, elements.size()));
+        // At most two contiguous pieces, split where the ring wraps around
+        auto first = std::min<size_type>(count, capacity - (push_val & (capacity - 1)));
+        std::uninitialized_copy_n(elements.data(), first, element_ptr(push_val));
+        std::uninitialized_copy_n(elements.data() + first, count - first, buffer);
+        push_ptr.store(push_val + count, std::memory_order::release);
+        return count;
+    }
+
+    // Pops as many elements as are available and fit in the span, loading the push
+    //  cursor at most once and storing the pop cursor once for all of them.
+    // Returns the number of elements popped.
+    size_t pop_n(std::span<value_type> elements) {
+        auto pop_val = pop_ptr.load(std::memory_order::relaxed);
+        auto count = std::min<size_type>(elements.size(), filled_slots(pop_val, elements.size()));
+        auto first = std::min<size_type>(count, capacity - (pop_val & (capacity - 1)));
+        std::move(element_ptr(pop_val), element_ptr(pop_val) + first, elements.data());
+        std::move(buffer, buffer + (count - first), elements.data() + first);
+        std::destroy_n(element_ptr(pop_val), first);
+        std::destroy_n(buffer, count - first);
+        pop_ptr.store(pop_val + count, std::memory_order::release);
+        return count;
+    }
+
+    // The free slots, up to where the ring wraps around. The producer writes the elements
+    //  in place, then publishes the first count of them with commit_push(count).
+    std::span<value_type> push_region() requires std::is_trivially_copyable_v<T> {
+        auto push_val = push_ptr.load(std::memory_order::relaxed);
+        auto contiguous = capacity - (push_val & (capacity - 1));
+        return { element_ptr(push_val), std::min<size_type>(contiguous, free_slots(push_val, contiguous)) };
+    }
+
+    void commit_push(const size_type count) requires std::is_trivially_copyable_v<T> {
+        push_ptr.store(push_ptr.load(std::memory_order::relaxed) + count, std::memory_order::release);
+    }
+
+    // The filled slots, up to where the ring wraps around. The consumer reads the elements
+    //  in place, then releases the first count of them with commit_pop(count).
+    std::span<value_type> pop_region() requires std::is_trivially_copyable_v<T> {
+        auto pop_val = pop_ptr.load(std::memory_order::relaxed);
+        auto contiguous = capacity - (pop_val & (capacity - 1));
+        return { element_ptr(pop_val), std::min<size_type>(contiguous, filled_slots(pop_val, contiguous)) };
+    }
+
+    void commit_pop(const size_type count) requires std::is_trivially_copyable_v<T> {
+        pop_ptr.store(pop_ptr.load(std::memory_order::relaxed) + count, std::memory_order::release);
+    }
+
+    // The number of elements as seen from either side, which is exact for the cursor of the side.
+    //  The producer may count elements that are already popped, and the consumer may miss new ones.
+    size_type size() const {
+        return push_ptr.load(std::memory_order::acquire) - pop_ptr.load(std::memory_order::acquire);
+    }
+
+    // Only meaningful to the consumer. The queue may stop being empty right after.
+    bool empty() const {
+        return push_ptr.load(std::memory_order::acquire) == pop_ptr.load(std::memory_order::relaxed);
+    }
+
     ~SPSCBoundedWaitFreeQueue() {
         // TODO relaxed then acquire?
         size_type pop_index = pop_ptr.load(std::memory_order::relaxed);
@@ -73,6 +140,22 @@ protected:
         return true;
     }
 
+    // The number of free slots, refreshing the cached pop cursor only if fewer than wanted are known to be free
+    size_type free_slots(size_type push_ptr_, size_type wanted) {
+        if (capacity - (push_ptr_ - cached_pop_ptr) < wanted) {
+            cached_pop_ptr = pop_ptr.load(std::memory_order::acquire);
+        }
+        return capacity - (push_ptr_ - cached_pop_ptr);
+    }
+
+    // The number of filled slots, refreshing the cached push cursor only if fewer than wanted are known to be filled
+    size_type filled_slots(size_type pop_ptr_, size_type wanted) {
+        if (cached_push_ptr - pop_ptr_ < wanted) {
+            cached_push_ptr = push_ptr.load(std::memory_order::acquire);
+        }
+        return cached_push_ptr - pop_ptr_;
+    }
+
     bool is_full(size_type push, size_type pop) { return (push - pop) == capacity; }
 
     bool is_empty(size_type push, size_type pop) { return push == pop; }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <span>
+
+#include <tcpp/utils/WaitStrategy.hpp>
+
+namespace tcpp {
+
+// A queue whose consumer can park while it's empty. Every push
+//  notifies the parking spot, which is cheap unless the consumer is parked.
+template <typename Queue>
+class WaitableQueue : public Queue {
+
+    ParkingSpot spot;
+
+public:
+
+    using value_type = typename Queue::value_type;
+
+    template <typename... Args>
+    bool push(Args&&... args) {
+        bool pushed = Queue::push(std::forward<Args>(args)...);
+        if (pushed) spot.notify();
+        return pushed;
+    }
+
+    size_t push_n(std::span<const value_type> elements) {
+        auto count = Queue::push_n(elements);
+        if (count > 0) spot.notify();
+        return count;
+    }
+
+    ParkingSpot& parking_spot() { return spot; }
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <netinet/in.h>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/structs/Base.hpp>
+
+namespace tcpp::structs {
+
+// Only the Ethernet/IPv4 flavor of ARP. The addresses are not aligned
+//  in the packet, hence the packing.
+struct [[gnu::packed]] ARP : Base<ARP> {
+    // _n = network byte order
+    uint16_t hardware_type_n;
+    uint16_t protocol_type_n;
+    uint8_t hardware_len;
+    uint8_t protocol_len;
+    uint16_t operation_n;
+    MacAddress sender_mac;
+    IpAddress sender_ip_n;
+    MacAddress target_mac;
+    IpAddress target_ip_n;
+
+    [[nodiscard]] uint16_t operation() const { return ntohs(operation_n); }
+
+    // Whether it's the Ethernet/IPv4 flavor
+    [[nodiscard]] bool is_ethernet_ipv4() const {
+        return ntohs(hardware_type_n) == HARDWARE_ETHERNET && ntohs(protocol_type_n) == PROTOCOL_IPV4 &&
+               hardware_len == sizeof(MacAddress) && protocol_len == sizeof(IpAddress);
+    }
+
+    // Fills in everything but the addresses
+    void set_ethernet_ipv4(const uint16_t operation) {
+        hardware_type_n = htons(HARDWARE_ETHERNET);
+        protocol_type_n = htons(PROTOCOL_IPV4);
+        hardware_len = sizeof(MacAddress);
+        protocol_len = sizeof(IpAddress);
+        operation_n = htons(operation);
+    }
+
+    constexpr static uint16_t HARDWARE_ETHERNET = 1;
+    constexpr static uint16_t PROTOCOL_IPV4 = 0x0800;
+
+    constexpr static uint16_t OPERATION_REQUEST = 1;
+    constexpr static uint16_t OPERATION_REPLY = 2;
+};
+
+static_assert(sizeof(ARP) == 28);
+
+}
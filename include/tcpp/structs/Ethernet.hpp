@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <netinet/in.h>
+
+#include <tcpp/TypeDefs.hpp>
+#include <tcpp/structs/Base.hpp>
+
+namespace tcpp::structs {
+
+struct IPv4;
+struct ARP;
+
+struct Ethernet : Base<Ethernet> {
+    // _n = network byte order
+    MacAddress dest_mac;
+    MacAddress source_mac;
+    uint16_t ethertype_n;
+
+    template <typename Self>
+    auto& ip_payload(this Self& self) { assert(self.ethertype() == ETHERTYPE_IPV4); return self.template extract<IPv4>(self.payload_offset()); }
+
+    template <typename Self>
+    auto& arp_payload(this Self& self) { assert(self.ethertype() == ETHERTYPE_ARP); return self.template extract<ARP>(self.payload_offset()); }
+
+    [[nodiscard]] uint16_t ethertype() const { return ntohs(ethertype_n); }
+
+    void set_ethertype(const uint16_t value) { ethertype_n = htons(value); }
+
+    [[nodiscard]] constexpr size_t payload_offset() const { return sizeof(*this); }
+
+    constexpr static uint16_t ETHERTYPE_IPV4 = 0x0800;
+    constexpr static uint16_t ETHERTYPE_ARP = 0x0806;
+
+    constexpr static MacAddress BROADCAST_MAC = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+};
+
+static_assert(sizeof(Ethernet) == 14);
+
+}
@@ -48,6 +48,10 @@ struct IPv4 : Base<IPv4> {
 
     void compute_and_set_ip_tcp_checksums();
 
+    // Leaves only the checksum of the pseudo-header in the TCP checksum field,
+    //  for the checksum offload to compute the checksum over the rest of the segment.
+    void compute_and_set_tcp_partial_checksum();
+
     void compute_and_set_ip_udp_checksums();
 
     void set_source_ip(uint32_t value);
@@ -84,6 +88,11 @@ struct IPv4 : Base<IPv4> {
 
     constexpr static uint8_t IPPROTOCOL_UDP = 0x11;
     constexpr static uint8_t IPPROTOCOL_TCP = 0x06;
+
+    // The two lowest bits of the tos field (RFC 3168 - Section 5)
+    constexpr static uint8_t ECN_MASK = 0b11;
+    constexpr static uint8_t ECN_ECT0 = 0b10;
+    constexpr static uint8_t ECN_CE = 0b11;
 };
 
 }
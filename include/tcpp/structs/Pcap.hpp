@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+namespace tcpp::structs {
+
+// The classic libpcap file format. The file starts with this header,
+//  followed by a record header before each of the packets.
+struct PcapFileHeader {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t  thiszone;   // Always 0
+    uint32_t sigfigs;    // Always 0
+    uint32_t snaplen;    // The maximum number of bytes captured of each of the packets
+    uint32_t linktype;
+
+    // Written in the native byte order. Reading any of them byte-swapped means the whole file is.
+    constexpr static uint32_t MAGIC_MICROSECONDS = 0xA1B2C3D4;
+    constexpr static uint32_t MAGIC_NANOSECONDS = 0xA1B23C4D;
+
+    constexpr static uint32_t LINKTYPE_ETHERNET = 1;
+    constexpr static uint32_t LINKTYPE_RAW = 101;  // Starts at the IP header
+    constexpr static uint32_t LINKTYPE_IPV4 = 228;
+};
+
+struct PcapRecordHeader {
+    uint32_t ts_sec;
+    uint32_t ts_frac;   // Microseconds or nanoseconds, depending on the magic
+    uint32_t incl_len;  // The number of bytes captured
+    uint32_t orig_len;  // The size of the packet on the wire
+};
+
+static_assert(sizeof(PcapFileHeader) == 24);
+static_assert(sizeof(PcapRecordHeader) == 16);
+
+}
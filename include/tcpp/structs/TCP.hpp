@@ -1,6 +1,10 @@
 #pragma once
 
+#include <span>
+#include <array>
 #include <cstdint>
+#include <optional>
+#include <algorithm>
 #include <netinet/in.h>
 
 #include <tcpp/structs/Base.hpp>
@@ -42,6 +46,35 @@ struct TCP : Base<TCP> {
     uint16_t checksum_n;
     uint16_t urgent_ptr_n;
 
+    static constexpr uint8_t OPTION_END = 0;
+    static constexpr uint8_t OPTION_NOP = 1;
+    static constexpr uint8_t OPTION_MSS = 2;
+    static constexpr size_t MSS_OPTION_SIZE = 4;
+    static constexpr uint8_t OPTION_WINDOW_SCALE = 3;
+    static constexpr size_t WINDOW_SCALE_OPTION_SIZE = 3;
+    static constexpr uint8_t MAX_WINDOW_SCALE = 14;
+    static constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+    static constexpr size_t SACK_PERMITTED_OPTION_SIZE = 2;
+    static constexpr uint8_t OPTION_SACK = 5;
+    // The most blocks that fit in the 40 bytes of options, along with the two padding nops
+    static constexpr size_t MAX_SACK_BLOCKS = 4;
+    // The window scale and the sack permitted options padded with nops, one and two of them respectively
+    static constexpr size_t PADDED_WINDOW_SCALE_OPTION_SIZE = 1 + WINDOW_SCALE_OPTION_SIZE;
+    static constexpr size_t PADDED_SACK_PERMITTED_OPTION_SIZE = 2 + SACK_PERMITTED_OPTION_SIZE;
+    // All the options of a syn: the maximum segment size, the window scale, and sack permitted
+    static constexpr size_t SYN_OPTIONS_SIZE =
+        MSS_OPTION_SIZE + PADDED_WINDOW_SCALE_OPTION_SIZE + PADDED_SACK_PERMITTED_OPTION_SIZE;
+
+    // A block of a sack option (RFC 2018 - Section 3): a range of the sequence space
+    //  received out of order, from begin up to end, not including it
+    struct SackBlock {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // The size of a sack option with that many blocks, padded with two nops
+    static constexpr size_t padded_sack_option_size(const size_t blocks) { return 4 + blocks * 8; }
+
     [[nodiscard]] uint16_t source_port() const { return ntohs(source_port_n); }
 
     [[nodiscard]] uint16_t dest_port() const { return ntohs(dest_port_n); }
@@ -71,6 +104,109 @@ struct TCP : Base<TCP> {
     void set_checksum(const uint16_t value) { checksum_n = htons(value); }
 
     void set_urgent_ptr(const uint16_t value) { urgent_ptr_n = htons(value); }
+
+    // The options are between the fixed part of the header and the payload
+    [[nodiscard]] std::span<const uint8_t> options() const {
+        auto header = reinterpret_cast<const uint8_t*>(this);
+        return { header + sizeof(TCP), payload_offset() > sizeof(TCP) ? payload_offset() - sizeof(TCP) : 0 };
+    }
+
+    // The bytes of the option of the kind that follow its kind and length, if it's present.
+    //  Nothing if it's not, or if the options are malformed.
+    [[nodiscard]] std::optional<std::span<const uint8_t>> find_option(const uint8_t kind) const {
+        auto bytes = options();
+        size_t i = 0;
+        while (i < bytes.size() && bytes[i] != OPTION_END) {
+            if (bytes[i] == OPTION_NOP) {
+                i++;
+                continue;
+            }
+            if (i + 1 >= bytes.size() || bytes[i + 1] < 2 || i + bytes[i + 1] > bytes.size()) break;
+            if (bytes[i] == kind) {
+                return bytes.subspan(i + 2, bytes[i + 1] - 2u);
+            }
+            i += bytes[i + 1];
+        }
+        return std::nullopt;
+    }
+
+    // The value of the maximum segment size option, or 0 if it's not present (or malformed)
+    [[nodiscard]] uint16_t mss_option() const {
+        auto value = find_option(OPTION_MSS);
+        if (!value || value->size() != MSS_OPTION_SIZE - 2) return 0;
+        return static_cast<uint16_t>((*value)[0] << 8 | (*value)[1]);
+    }
+
+    // The shift count of the window scale option (RFC 7323 - Section 2.2), or -1 if it's not present.
+    //  Counts above the maximum are taken as the maximum (RFC 7323 - Section 2.3).
+    [[nodiscard]] int window_scale_option() const {
+        auto value = find_option(OPTION_WINDOW_SCALE);
+        if (!value || value->size() != WINDOW_SCALE_OPTION_SIZE - 2) return -1;
+        return std::min<int>((*value)[0], MAX_WINDOW_SCALE);
+    }
+
+    // RFC 2018 - Section 2, only ever sent on a syn
+    [[nodiscard]] bool sack_permitted_option() const {
+        auto value = find_option(OPTION_SACK_PERMITTED);
+        return value && value->empty();
+    }
+
+    // Fills in the blocks of the sack option, in the order they're sent, and returns their
+    //  count. Zero if the option isn't present, or if its length isn't a whole number of blocks.
+    size_t sack_option(std::array<SackBlock, MAX_SACK_BLOCKS>& blocks) const {
+        auto value = find_option(OPTION_SACK);
+        if (!value || value->empty() || value->size() % 8 != 0) return 0;
+        const auto count = std::min(value->size() / 8, MAX_SACK_BLOCKS);
+        for (size_t i = 0; i < count; i++) {
+            blocks[i] = { read_u32(value->subspan(i * 8)), read_u32(value->subspan(i * 8 + 4)) };
+        }
+        return count;
+    }
+
+    // Each of the options is appended at the end of the header, which must have room for it,
+    //  and the header is extended over it. The options are padded to keep the header aligned.
+
+    void set_mss_option(const uint16_t mss) {
+        append_option({ OPTION_MSS, MSS_OPTION_SIZE, static_cast<uint8_t>(mss >> 8), static_cast<uint8_t>(mss) });
+    }
+
+    void set_window_scale_option(const uint8_t shift) {
+        append_option({ OPTION_NOP, OPTION_WINDOW_SCALE, WINDOW_SCALE_OPTION_SIZE, shift });
+    }
+
+    void set_sack_permitted_option() {
+        append_option({ OPTION_NOP, OPTION_NOP, OPTION_SACK_PERMITTED, SACK_PERMITTED_OPTION_SIZE });
+    }
+
+    // At most MAX_SACK_BLOCKS of the blocks are sent
+    void set_sack_option(const std::span<const SackBlock> blocks) {
+        const auto count = std::min(blocks.size(), MAX_SACK_BLOCKS);
+        const auto length = static_cast<uint8_t>(padded_sack_option_size(count) - 2);
+        append_option({ OPTION_NOP, OPTION_NOP, OPTION_SACK, length });
+        for (auto [begin, end] : blocks.first(count)) {
+            append_option(u32_bytes(begin));
+            append_option(u32_bytes(end));
+        }
+    }
+
+private:
+
+    static uint32_t read_u32(const std::span<const uint8_t> bytes) {
+        return uint32_t { bytes[0] } << 24 | uint32_t { bytes[1] } << 16 | uint32_t { bytes[2] } << 8 | bytes[3];
+    }
+
+    static std::array<uint8_t, 4> u32_bytes(const uint32_t value) {
+        return {
+            static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+            static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)
+        };
+    }
+
+    void append_option(const std::array<uint8_t, 4> option) {
+        auto end = reinterpret_cast<uint8_t*>(this) + payload_offset();
+        std::copy(option.begin(), option.end(), end);
+        data_offset = (data_offset + 1) & 0xF;
+    }
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace tcpp::structs {
+
+// The header preceding every packet of a tun device with IFF_VNET_HDR. This mirrors struct
+//  virtio_net_hdr, since <linux/virtio_net.h> can't be included in C++ (it has a field named "class").
+// The fields are in the native byte order, which is the legacy virtio layout the tun device uses by default.
+struct VirtioNetHeader {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;      // The length of the headers to replicate in each of the segments
+    uint16_t gso_size;     // The payload size of each of the segments
+    uint16_t csum_start;   // Where to start checksumming from
+    uint16_t csum_offset;  // Where to store the checksum, relative to csum_start
+
+    constexpr static uint8_t FLAG_NEEDS_CSUM = 1;
+    constexpr static uint8_t FLAG_DATA_VALID = 2;
+
+    constexpr static uint8_t GSO_NONE = 0;
+    constexpr static uint8_t GSO_TCPV4 = 1;
+};
+
+static_assert(sizeof(VirtioNetHeader) == 10);
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+namespace tcpp {
+
+struct BatchStats {
+    uint64_t batches = 0;
+    uint64_t packets = 0;
+    uint64_t max_batch = 0;
+    // histogram[i] = the number of batches with a size in the range [2^i, 2^(i+1))
+    std::array<uint64_t, 32> histogram { };
+
+    [[nodiscard]] double average_batch() const {
+        return batches == 0 ? 0.0 : static_cast<double>(packets) / static_cast<double>(batches);
+    }
+
+    BatchStats& operator+=(const BatchStats& other) {
+        batches += other.batches;
+        packets += other.packets;
+        max_batch = std::max(max_batch, other.max_batch);
+        for (size_t i = 0; i < histogram.size(); i++)
+            histogram[i] += other.histogram[i];
+        return *this;
+    }
+};
+
+// Written by a single thread, and can be read concurrently by any other thread.
+// The counters are only eventually consistent with each other while being written.
+class BatchStatsRecorder {
+
+    std::atomic<uint64_t> batches = 0;
+    std::atomic<uint64_t> packets = 0;
+    std::atomic<uint64_t> max_batch = 0;
+    std::array<std::atomic<uint64_t>, 32> histogram { };
+
+    // Only one writer, no need for read-modify-write operations
+    static void increment(std::atomic<uint64_t>& counter, const uint64_t value = 1) {
+        counter.store(counter.load(std::memory_order::relaxed) + value, std::memory_order::relaxed);
+    }
+
+public:
+
+    void record(const uint64_t batch_size) {
+        if (batch_size == 0) return;
+        increment(batches);
+        increment(packets, batch_size);
+        if (batch_size > max_batch.load(std::memory_order::relaxed))
+            max_batch.store(batch_size, std::memory_order::relaxed);
+        increment(histogram[std::bit_width(batch_size) - 1]);
+    }
+
+    [[nodiscard]] BatchStats snapshot() const {
+        BatchStats result;
+        result.batches = batches.load(std::memory_order::relaxed);
+        result.packets = packets.load(std::memory_order::relaxed);
+        result.max_batch = max_batch.load(std::memory_order::relaxed);
+        for (size_t i = 0; i < histogram.size(); i++)
+            result.histogram[i] = histogram[i].load(std::memory_order::relaxed);
+        return result;
+    }
+};
+
+}
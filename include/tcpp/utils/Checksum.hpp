@@ -15,6 +15,9 @@ struct Checksum16BE {
     Checksum16BE& add_be(uint16_t x);
     Checksum16BE& add_be(uint32_t x);
     [[nodiscard]] uint16_t get() const;
+    // The folded sum without taking the one's complement, in big-endian. This is the partial
+    //  checksum left in the packet for whoever computes the rest of it (like a NIC)
+    [[nodiscard]] uint16_t get_partial() const;
     operator uint16_t() const { return get(); }
 };
 
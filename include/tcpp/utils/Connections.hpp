@@ -1,6 +1,7 @@
 #pragma once
 
 #include <tuple>
+#include <functional>
 
 #include <tcpp/TypeDefs.hpp>
 
@@ -23,8 +24,13 @@ struct ConnectionID {
         return std::tie(lhs.source_ip, lhs.dest_ip, lhs.source_port, lhs.dest_port) <=>
                std::tie(rhs.source_ip, rhs.dest_ip, rhs.source_port, rhs.dest_port);
     }
+
+    friend bool operator==(const ConnectionID& lhs, const ConnectionID& rhs) = default;
 };
 
+// Binding to this address accepts the connections to all the addresses of the port
+constexpr IpAddress AnyAddress = 0;
+
 struct Endpoint {
     IpAddress ip = 0xFFFFFFFF;
     Port port = 0xFFFF;
@@ -35,4 +41,21 @@ struct Endpoint {
     }
 };
 
-}
\ No newline at end of file
+}
+
+template <>
+struct std::hash<tcpp::ConnectionID> {
+    size_t operator()(const tcpp::ConnectionID& id) const noexcept {
+        // Pack the 4-tuple into 64 bits, then mix it with the
+        //  64-bit finalizer of MurmurHash3 so that connections
+        //  that differ only in the ports spread over all the bits
+        uint64_t key = (static_cast<uint64_t>(id.source_ip) << 32 | id.dest_ip) ^
+                       (static_cast<uint64_t>(id.source_port) << 16 | id.dest_port) * 0x9E3779B97F4A7C15ULL;
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        key *= 0xC4CEB9FE1A85EC53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace tcpp {
+
+// Epoch-based reclamation of the objects unlinked from the lock-free lookup tables.
+// Each of the reader threads has a slot, and pins the current epoch in it while it
+//  may be holding pointers taken from the tables. An unlinked object is retired along
+//  with the epoch at the time, and is freed once the epoch advances twice. The epoch
+//  advances only once all the pinned readers have observed it, so by then, none of
+//  them can still be holding a pointer to the object.
+// The readers must not stay pinned while blocked, otherwise nothing is freed meanwhile.
+class EpochReclaimer {
+
+    struct alignas(64) Reader {
+        // The pinned epoch shifted left by one, with the low bit set while pinned. Zero otherwise.
+        std::atomic<uint64_t> state = 0;
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        void* object;
+        void (*deleter)(void*);
+    };
+
+public:
+
+    class Guard {
+    public:
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() { reclaimer.unpin(reader); }
+    private:
+        friend class EpochReclaimer;
+        Guard(EpochReclaimer& reclaimer_, size_t reader_) : reclaimer(reclaimer_), reader(reader_) { }
+        EpochReclaimer& reclaimer;
+        size_t reader;
+    };
+
+    // The readers are identified by their indices, from 0 up to readers_count - 1
+    explicit EpochReclaimer(const size_t readers_count_)
+        : readers_count(readers_count_),
+          readers(std::make_unique<Reader[]>(readers_count_)) { }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // Only one thread at a time may use the same reader index
+    [[nodiscard]] Guard pin(const size_t reader) {
+        readers[reader].state.store(epoch.load(std::memory_order_acquire) << 1 | 1, std::memory_order_relaxed);
+        // The pin must be visible before the reads of the tables that follow it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return { *this, reader };
+    }
+
+    // Takes the ownership of an object that has been unlinked from everywhere a reader might find it
+    template <typename T>
+    void retire(T* object) {
+        {
+            std::lock_guard lock(m);
+            retired.push_back({ epoch.load(std::memory_order_relaxed), object, [](void* p) { delete static_cast<T*>(p); } });
+            pending.store(retired.size(), std::memory_order_relaxed);
+        }
+        collect();
+    }
+
+    // Advances the epoch if possible, then frees what no reader can see anymore.
+    // Called on every retirement, and meant to be called by the readers while they're idle.
+    void collect() {
+        if (pending.load(std::memory_order_relaxed) == 0) return;
+        std::vector<Retired> to_free;
+        {
+            std::lock_guard lock(m);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto current = epoch.load(std::memory_order_relaxed);
+            bool all_observed = true;
+            for (size_t i = 0; i < readers_count; i++) {
+                auto state = readers[i].state.load(std::memory_order_acquire);
+                if ((state & 1) && (state >> 1) != current) {
+                    all_observed = false;
+                    break;
+                }
+            }
+            if (all_observed) {
+                epoch.store(current + 1, std::memory_order_release);
+            }
+            const auto now = epoch.load(std::memory_order_relaxed);
+            std::erase_if(retired, [&](const Retired& entry) {
+                if (entry.epoch + 2 > now) return false;
+                to_free.push_back(entry);
+                return true;
+            });
+            pending.store(retired.size(), std::memory_order_relaxed);
+        }
+        // Freed outside the lock, since the destructors might retire objects of their own
+        for (auto& entry : to_free) {
+            entry.deleter(entry.object);
+        }
+    }
+
+    [[nodiscard]] size_t pending_count() const { return pending.load(std::memory_order_relaxed); }
+
+    // No reader may be pinned by now
+    ~EpochReclaimer() noexcept {
+        for (auto& entry : retired) {
+            entry.deleter(entry.object);
+        }
+    }
+
+private:
+
+    void unpin(const size_t reader) {
+        readers[reader].state.store(0, std::memory_order_release);
+    }
+
+    const size_t readers_count;
+    std::unique_ptr<Reader[]> readers;
+    std::atomic<uint64_t> epoch = 1;
+
+    std::mutex m;
+    std::vector<Retired> retired;
+    std::atomic<size_t> pending = 0;
+};
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+#include <tcpp/utils/Connections.hpp>
+
+namespace tcpp {
+
+// RFC 9293 - Section 3.4.1 (and RFC 6528): ISN = M + F(id, secret), where M is a clock ticking every 4 microseconds,
+//  and F is SipHash-2-4 keyed with a secret drawn once per process. The numbers of each connection id keep increasing
+//  with time, while an off-path attacker can't guess those of a connection from the ones it sees for its own.
+uint32_t initial_sequence_number(const ConnectionID& id);
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <span>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include <tcpp/utils/FileDescriptor.hpp>
+
+namespace tcpp {
+
+// A minimal wrapper over the raw io_uring system calls. It's not thread-safe,
+//  and is meant to be driven by a single thread. The submission queue entries
+//  are filled in by the caller, the ring only takes care of the bookkeeping.
+class IoUring {
+public:
+
+    explicit IoUring(unsigned entries);
+
+    IoUring(const IoUring&) = delete;
+
+    IoUring& operator=(const IoUring&) = delete;
+
+    IoUring(IoUring&&) = delete;
+
+    IoUring& operator=(IoUring&&) = delete;
+
+    ~IoUring();
+
+    // Returns a zeroed submission queue entry, or nullptr if the submission queue is full.
+    // The entry is only submitted to the kernel at the next call to submit().
+    [[nodiscard]] io_uring_sqe* get_sqe();
+
+    // Submits all the pending entries with a single system call, and waits
+    //  for at least min_complete completions (if any) or until the timeout.
+    // Returns the number of entries submitted, or -errno.
+    int submit(unsigned min_complete = 0, std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+    // Returns the next completion, or nullptr if there is none. The completion
+    //  remains valid until it's marked as seen using advance()
+    [[nodiscard]] io_uring_cqe* peek_cqe() const;
+
+    void advance(unsigned count = 1);
+
+    // Registers the buffers as fixed buffers, which can then be used in the
+    //  *_FIXED operations without the kernel mapping them on every operation.
+    // Returns false if the kernel refused (for example, due to RLIMIT_MEMLOCK).
+    bool register_buffers(std::span<const iovec> buffers);
+
+    // Replaces the first of the registered buffers with the given ones, in place, for when the memory
+    //  they cover has grown. The operations already submitted keep using the old ones.
+    // Returns false if the kernel refused, in which case the old ones are left registered.
+    bool update_buffers(std::span<const iovec> buffers);
+
+    [[nodiscard]] bool buffers_registered() const { return !registered.empty(); }
+
+    // The index of the registered buffer containing the range, or -1 if none
+    [[nodiscard]] int buffer_index(const void* data, size_t size) const;
+
+    [[nodiscard]] unsigned entries() const { return sq_entries; }
+
+private:
+
+    void map_rings();
+
+    FileDescriptor fd;
+    io_uring_params params { };
+
+    void* sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void* cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+
+    // The cursors shared with the kernel. Heads of the submission queue
+    //  and tails of the completion queue are written by the kernel.
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    // Entries handed out by get_sqe() but not yet submitted
+    unsigned pending = 0;
+
+    std::vector<iovec> registered;
+};
+
+}
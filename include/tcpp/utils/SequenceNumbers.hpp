@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace tcpp {
+
+// Comparisons of sequence numbers, modulo 2^32 (RFC 9293 - Section 3.4)
+
+inline bool seq_lt(const uint32_t lhs, const uint32_t rhs) { return static_cast<int32_t>(lhs - rhs) < 0; }
+
+inline bool seq_le(const uint32_t lhs, const uint32_t rhs) { return static_cast<int32_t>(lhs - rhs) <= 0; }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+namespace tcpp {
+
+// How a consumer thread waits for its queue while it's empty
+enum class WaitStrategy {
+    // Keeps polling. The lowest latency, at the cost of a whole core.
+    BusyPoll,
+    // Spins for a while, then yields to the scheduler between polls
+    SpinYield,
+    // Spins for a while, then sleeps until a producer wakes it up
+    SpinPark,
+};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Where a single consumer sleeps while its queue is empty. The producers pay for a
+//  wakeup (a futex system call) only when the consumer is actually parked.
+class ParkingSpot {
+
+    std::atomic<bool> parked = false;
+    std::atomic<uint32_t> epoch = 0;
+
+public:
+
+    // Called by the consumer. Sleeps unless ready() is true. ready() is checked after the
+    //  consumer is marked as parked, so a producer that makes it true either sees the
+    //  mark and wakes the consumer up, or is seen by the check. No wakeup is lost.
+    template <typename Ready>
+    void park(Ready&& ready) {
+        parked.store(true, std::memory_order::relaxed);
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        // Acquire, so that if a wakeup is already seen here, so is what the producer published before it
+        auto current = epoch.load(std::memory_order::acquire);
+        if (!ready()) {
+            // Returns once the epoch is changed by a wakeup (or spuriously)
+            epoch.wait(current, std::memory_order::acquire);
+        }
+        parked.store(false, std::memory_order::relaxed);
+    }
+
+    // Called by the producers after publishing what the consumer waits for
+    void notify() {
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        if (parked.load(std::memory_order::relaxed)) {
+            wake();
+        }
+    }
+
+    // Wakes the consumer up unconditionally (after requesting it to stop, for example)
+    void wake() {
+        epoch.fetch_add(1, std::memory_order::release);
+        epoch.notify_one();
+    }
+};
+
+// The state of a consumer thread between unsuccessful polls. The strategy kicks in
+//  only after spinning for a number of polls, which is reset once something is found.
+class Backoff {
+
+    const WaitStrategy strategy;
+    const uint32_t spins;
+    uint32_t idle_polls = 0;
+
+public:
+
+    explicit Backoff(const WaitStrategy strategy_, const uint32_t spins_) : strategy(strategy_), spins(spins_) { }
+
+    // Called after a poll that found nothing. ready() tells whether there's something to poll again.
+    template <typename Ready>
+    void idle(ParkingSpot& spot, Ready&& ready) {
+        if (strategy == WaitStrategy::BusyPoll || idle_polls < spins) {
+            idle_polls++;
+            cpu_relax();
+        } else if (strategy == WaitStrategy::SpinYield) {
+            std::this_thread::yield();
+        } else {
+            spot.park(std::forward<Ready>(ready));
+        }
+    }
+
+    void reset() { idle_polls = 0; }
+};
+
+}
@@ -0,0 +1,101 @@
+#include <array>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include <tcpp/LoopbackDevice.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/utils/WaitStrategy.hpp>
+#include <tcpp/data-structures/WaitableQueue.hpp>
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
+
+namespace tcpp {
+
+struct LoopbackDevice::Link {
+
+    // Pushed to by the sender of a queue, popped from by the receiver of the same queue on the other side,
+    //  which parks on it while it's empty
+    using Wire = WaitableQueue<SPSCBoundedWaitFreeQueue<std::span<uint8_t>, WireCapacity>>;
+
+    // The polls of an empty wire before the receiver parks
+    static constexpr uint32_t SpinsBeforeParking = 64;
+
+    explicit Link(const size_t queues) {
+        for (auto& side_wires : wires) {
+            side_wires.reserve(queues);
+            for (size_t i = 0; i < queues; i++) {
+                side_wires.push_back(std::make_unique<Wire>());
+            }
+        }
+    }
+
+    Link(const Link&) = delete;
+
+    Link& operator=(const Link&) = delete;
+
+    ~Link() {
+        // Packets that were never received
+        PacketAllocator allocator;
+        for (auto& side_wires : wires) {
+            for (auto& wire : side_wires) {
+                while (auto packet = wire->pop()) {
+                    allocator.deallocate(packet->data());
+                }
+            }
+        }
+    }
+
+    // The packets on their way to each of the sides, for each of the queues
+    std::array<std::vector<std::unique_ptr<Wire>>, 2> wires;
+    std::array<std::atomic<bool>, 2> closed { };
+};
+
+LoopbackDevice::LoopbackDevice(std::shared_ptr<Link> link_, const size_t side_)
+    : link(std::move(link_)), side(side_) { }
+
+ReceivedPacket LoopbackDevice::receive_packet(const size_t queue) {
+    auto& wire = *link->wires[side][queue];
+    auto& closed = link->closed[side];
+    Backoff backoff(WaitStrategy::SpinPark, Link::SpinsBeforeParking);
+    auto ready = [&] { return !wire.empty() || closed.load(std::memory_order::relaxed); };
+    while (!closed.load(std::memory_order::relaxed)) {
+        if (auto packet = wire.pop()) {
+            return { .data = packet.value(), .checksum_valid = true };
+        }
+        backoff.idle(wire.parking_spot(), ready);
+    }
+    return { };
+}
+
+void LoopbackDevice::send_packets(const std::span<const std::span<uint8_t>> packets, const size_t queue) {
+    auto& wire = *link->wires[1 - side][queue];
+    PacketAllocator allocator;
+    for (auto packet : packets) {
+        if (!wire.push(packet)) {
+            allocator.deallocate(packet.data());
+        }
+    }
+}
+
+size_t LoopbackDevice::queues_count() const {
+    return link->wires[side].size();
+}
+
+void LoopbackDevice::close() {
+    link->closed[side].store(true, std::memory_order::relaxed);
+    // The receivers parked on the wires wake up to find the device closed
+    for (auto& wire : link->wires[side]) {
+        wire->parking_spot().wake();
+    }
+}
+
+LoopbackPair::LoopbackPair(const size_t queues)
+    : first(std::make_shared<LoopbackDevice::Link>(queues), 0),
+      second(first.link, 1)
+{
+    if (queues == 0) {
+        throw std::invalid_argument("A loopback pair needs at least one queue");
+    }
+}
+
+}
@@ -0,0 +1,447 @@
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <shared_mutex>
+#include <unordered_map>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#include <tcpp/PacketSocketDevice.hpp>
+#include <tcpp/structs/Ethernet.hpp>
+#include <tcpp/structs/ARP.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/utils/IPv4.hpp>
+#include <tcpp/utils/FileDescriptor.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
+
+namespace tcpp {
+
+// The frames of both of the rings. Large enough for a full Ethernet frame after the frame header.
+static constexpr size_t FrameSize = 2048;
+
+// Where the frame starts in a slot of the transmit ring, right after the frame header
+static constexpr size_t TxDataOffset = TPACKET3_HDRLEN - sizeof(sockaddr_ll);
+
+static constexpr size_t TxFramesPerBlock = 32;
+
+// How long a receiving thread blocks in poll() before it checks whether the device is closed
+static constexpr int PollTimeoutMilliseconds = 100;
+
+// How long before another ARP request is broadcast for a neighbour that hasn't replied
+static constexpr auto ArpRequestInterval = std::chrono::seconds(1);
+
+static uint32_t load_status(uint32_t& status) {
+    return std::atomic_ref { status }.load(std::memory_order::acquire);
+}
+
+static void store_status(uint32_t& status, const uint32_t value) {
+    std::atomic_ref { status }.store(value, std::memory_order::release);
+}
+
+struct PacketSocketDevice::Shared {
+    IpAddress ip = 0;
+    MacAddress mac { };
+    int ifindex = 0;
+
+    // A plain packet socket for sending ARP packets. The sockets of the queues can't
+    //  be used for this, since anything sent through them goes through their rings.
+    FileDescriptor control_fd;
+
+    std::shared_mutex neighbours_mutex;
+    std::unordered_map<IpAddress, MacAddress> neighbours;
+    // Incremented on every change to the neighbours, so that the cached entries can be validated
+    std::atomic<uint64_t> neighbours_version = 0;
+
+    // When the last ARP request was sent for each of the unresolved neighbours
+    std::mutex arp_requests_mutex;
+    std::unordered_map<IpAddress, std::chrono::steady_clock::time_point> arp_requests;
+
+    std::atomic<bool> closed = false;
+};
+
+struct PacketSocketDevice::Queue {
+
+    Queue() = default;
+
+    Queue(const Queue&) = delete;
+
+    Queue& operator=(const Queue&) = delete;
+
+    ~Queue() {
+        if (ring != nullptr) munmap(ring, ring_size);
+    }
+
+    tpacket_block_desc& block(const size_t index) const {
+        return *reinterpret_cast<tpacket_block_desc*>(ring + index * rx.tp_block_size);
+    }
+
+    tpacket3_hdr& tx_slot(const size_t index) const {
+        auto tx_ring = ring + static_cast<size_t>(rx.tp_block_size) * rx.tp_block_nr;
+        return *reinterpret_cast<tpacket3_hdr*>(tx_ring + index * tx.tp_frame_size);
+    }
+
+    FileDescriptor fd;
+    // The receive ring followed by the transmit ring
+    uint8_t* ring = nullptr;
+    size_t ring_size = 0;
+    tpacket_req3 rx { };
+    tpacket_req3 tx { };
+
+    // Exclusive to the receiving thread
+    size_t current_block = 0;
+    bool holding_block = false;
+    uint32_t remaining_packets = 0;
+    tpacket3_hdr* next_packet = nullptr;
+    // The last neighbour learned, to avoid taking the lock for every packet of the same neighbour
+    IpAddress learned_ip = 0;
+    MacAddress learned_mac { };
+
+    // Exclusive to the sending thread
+    alignas(CACHE_LINE_SIZE) size_t current_tx_frame = 0;
+    // The last neighbour sent to, valid as long as the neighbours don't change
+    IpAddress cached_ip = 0;
+    MacAddress cached_mac { };
+    uint64_t cached_version = ~0ULL;
+};
+
+PacketSocketDevice::PacketSocketDevice(std::vector<std::unique_ptr<Queue>> queues_, std::unique_ptr<Shared> shared_)
+    : queues(std::move(queues_)), shared(std::move(shared_)) { }
+
+static void learn_neighbour(auto& shared, auto& queue, const IpAddress ip, const MacAddress& mac) {
+    if (queue.learned_ip == ip && queue.learned_mac == mac) return;
+    queue.learned_ip = ip;
+    queue.learned_mac = mac;
+    {
+        // Mostly known already, even when the neighbours alternate, which only needs the shared lock
+        std::shared_lock lock(shared.neighbours_mutex);
+        auto it = shared.neighbours.find(ip);
+        if (it != shared.neighbours.end() && it->second == mac) return;
+    }
+    // Checked again, since another queue may have learned it meanwhile
+    std::unique_lock lock(shared.neighbours_mutex);
+    auto [it, inserted] = shared.neighbours.try_emplace(ip, mac);
+    if (!inserted && it->second == mac) return;
+    it->second = mac;
+    shared.neighbours_version.fetch_add(1, std::memory_order::release);
+    lock.unlock();
+
+    std::lock_guard requests_lock(shared.arp_requests_mutex);
+    shared.arp_requests.erase(ip);
+}
+
+// Whether an ARP request should be sent for the neighbour, at most once per interval
+static bool claim_arp_request(auto& shared, const IpAddress ip) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock(shared.arp_requests_mutex);
+    auto [it, inserted] = shared.arp_requests.try_emplace(ip, now);
+    if (inserted) return true;
+    if (now - it->second < ArpRequestInterval) return false;
+    it->second = now;
+    return true;
+}
+
+ReceivedPacket PacketSocketDevice::receive_packet(const size_t queue) {
+    auto& q = *queues[queue];
+    while (!shared->closed.load(std::memory_order::relaxed)) {
+        if (q.remaining_packets == 0) {
+            if (q.holding_block) {
+                // Hand the block back to the kernel
+                store_status(q.block(q.current_block).hdr.bh1.block_status, TP_STATUS_KERNEL);
+                q.current_block = (q.current_block + 1) % q.rx.tp_block_nr;
+                q.holding_block = false;
+            }
+            auto& block = q.block(q.current_block);
+            if ((load_status(block.hdr.bh1.block_status) & TP_STATUS_USER) == 0) {
+                // Only waits when there's nothing to process
+                pollfd pfd { .fd = q.fd, .events = POLLIN | POLLERR, .revents = 0 };
+                (void)poll(&pfd, 1, PollTimeoutMilliseconds);
+                continue;
+            }
+            q.holding_block = true;
+            q.remaining_packets = block.hdr.bh1.num_pkts;
+            q.next_packet = reinterpret_cast<tpacket3_hdr*>(
+                reinterpret_cast<uint8_t*>(&block) + block.hdr.bh1.offset_to_first_pkt);
+            continue;
+        }
+
+        auto& header = *q.next_packet;
+        q.remaining_packets--;
+        q.next_packet = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(&header) + header.tp_next_offset);
+
+        // In case the kernel doesn't support PACKET_IGNORE_OUTGOING
+        auto& address = *reinterpret_cast<sockaddr_ll*>(reinterpret_cast<uint8_t*>(&header) + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+        if (address.sll_pkttype == PACKET_OUTGOING) continue;
+
+        std::span frame { reinterpret_cast<uint8_t*>(&header) + header.tp_mac, header.tp_snaplen };
+        if (frame.size() < sizeof(structs::Ethernet)) continue;
+        auto& ethernet = structs::Ethernet::from_ptr(frame.data());
+
+        if (ethernet.ethertype() == structs::Ethernet::ETHERTYPE_ARP) {
+            handle_arp(queue, frame);
+            continue;
+        }
+
+        if (ethernet.ethertype() != structs::Ethernet::ETHERTYPE_IPV4) continue;
+        if (frame.size() < sizeof(structs::Ethernet) + sizeof(structs::IPv4)) continue;
+        // The kernel aligns the network header in the ring, so the overlay is aligned as well
+        auto& ip = ethernet.ip_payload();
+        const size_t size = ip.total_len();
+        if (ip.version != 4 || ip.dest_addr_n != shared->ip) continue;
+        if (size < sizeof(structs::IPv4) || size > frame.size() - sizeof(structs::Ethernet)) continue;
+
+        learn_neighbour(*shared, q, ip.source_addr_n, ethernet.source_mac);
+
+        // Only the IP packet is copied out, into a buffer the caller owns
+        auto buffer = PacketAllocator{}.allocate(size);
+        std::memcpy(buffer, &ip, size);
+        // Packets from the local kernel (over veth) may carry partial checksums, which are never completed
+        const bool checksum_valid = (header.tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY)) != 0;
+        return { .data = { buffer, size }, .checksum_valid = checksum_valid };
+    }
+    return { };
+}
+
+void PacketSocketDevice::handle_arp(const size_t queue, const std::span<uint8_t> frame) {
+    if (frame.size() < sizeof(structs::Ethernet) + sizeof(structs::ARP)) return;
+    auto& arp = structs::Ethernet::from_ptr(frame.data()).arp_payload();
+    if (!arp.is_ethernet_ipv4()) return;
+
+    // Learned from both the requests and the replies
+    const IpAddress sender_ip = arp.sender_ip_n;
+    const MacAddress sender_mac = arp.sender_mac;
+    learn_neighbour(*shared, *queues[queue], sender_ip, sender_mac);
+
+    if (arp.operation() == structs::ARP::OPERATION_REQUEST && arp.target_ip_n == shared->ip) {
+        send_arp(structs::ARP::OPERATION_REPLY, sender_mac, sender_ip);
+    }
+}
+
+void PacketSocketDevice::send_arp(const uint16_t operation, const MacAddress& target_mac, const IpAddress target_ip) {
+    const bool request = operation == structs::ARP::OPERATION_REQUEST;
+
+    std::array<uint8_t, sizeof(structs::Ethernet) + sizeof(structs::ARP)> frame { };
+    auto& ethernet = structs::Ethernet::from_ptr(frame.data());
+    ethernet.dest_mac = request ? structs::Ethernet::BROADCAST_MAC : target_mac;
+    ethernet.source_mac = shared->mac;
+    ethernet.set_ethertype(structs::Ethernet::ETHERTYPE_ARP);
+
+    auto& arp = ethernet.arp_payload();
+    arp.set_ethernet_ipv4(operation);
+    arp.sender_mac = shared->mac;
+    arp.sender_ip_n = shared->ip;
+    arp.target_mac = request ? MacAddress { } : target_mac;
+    arp.target_ip_n = target_ip;
+
+    sockaddr_ll address { };
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETH_P_ARP);
+    address.sll_ifindex = shared->ifindex;
+    address.sll_halen = sizeof(MacAddress);
+    std::copy(ethernet.dest_mac.begin(), ethernet.dest_mac.end(), address.sll_addr);
+    // Rare enough to go through a system call of its own
+    (void)sendto(shared->control_fd, frame.data(), frame.size(), MSG_DONTWAIT,
+                 reinterpret_cast<sockaddr*>(&address), sizeof(address));
+}
+
+static void deallocate_all(const std::span<const std::span<uint8_t>> packets) {
+    std::array<PacketBuffer, 64> buffers { };
+    size_t count = 0;
+    for (auto packet : packets) {
+        buffers[count++] = packet.data();
+        if (count == buffers.size()) {
+            PacketAllocator{}.deallocate_bulk(buffers);
+            count = 0;
+        }
+    }
+    PacketAllocator{}.deallocate_bulk({ buffers.data(), count });
+}
+
+void PacketSocketDevice::send_packets(const std::span<const std::span<uint8_t>> packets, const size_t queue) {
+    auto& q = *queues[queue];
+    size_t queued = 0;
+    IpAddress unresolved = 0;
+
+    const auto version = shared->neighbours_version.load(std::memory_order::acquire);
+    std::shared_lock lock(shared->neighbours_mutex, std::defer_lock);
+
+    for (auto packet : packets) {
+        const size_t frame_size = sizeof(structs::Ethernet) + packet.size();
+        if (frame_size > FrameSize - TxDataOffset) continue;
+
+        auto& ip = structs::IPv4::from_ptr(packet.data());
+        const IpAddress destination = ip.dest_addr_n;
+        if (destination != q.cached_ip || version != q.cached_version) {
+            // Taken at most once per batch
+            if (!lock.owns_lock()) lock.lock();
+            auto it = shared->neighbours.find(destination);
+            if (it == shared->neighbours.end()) {
+                unresolved = destination;
+                continue;
+            }
+            q.cached_ip = destination;
+            q.cached_mac = it->second;
+            q.cached_version = version;
+        }
+
+        auto& slot = q.tx_slot(q.current_tx_frame);
+        const auto status = load_status(slot.tp_status);
+        if (status != TP_STATUS_AVAILABLE && status != TP_STATUS_WRONG_FORMAT) {
+            // The ring is full. The rest of the batch is dropped.
+            break;
+        }
+
+        auto data = reinterpret_cast<uint8_t*>(&slot) + TxDataOffset;
+        auto& ethernet = structs::Ethernet::from_ptr(data);
+        ethernet.dest_mac = q.cached_mac;
+        ethernet.source_mac = shared->mac;
+        ethernet.set_ethertype(structs::Ethernet::ETHERTYPE_IPV4);
+        std::memcpy(data + sizeof(structs::Ethernet), packet.data(), packet.size());
+
+        slot.tp_len = static_cast<uint32_t>(frame_size);
+        slot.tp_snaplen = static_cast<uint32_t>(frame_size);
+        slot.tp_next_offset = 0;
+        store_status(slot.tp_status, TP_STATUS_SEND_REQUEST);
+        q.current_tx_frame = (q.current_tx_frame + 1) % q.tx.tp_frame_nr;
+        queued++;
+    }
+    if (lock.owns_lock()) lock.unlock();
+
+    if (queued > 0) {
+        // One system call for the whole batch. It doesn't wait for the frames to be sent.
+        (void)sendto(q.fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+    }
+
+    // The packets are copied into the ring by now
+    deallocate_all(packets);
+
+    if (unresolved != 0 && claim_arp_request(*shared, unresolved)) {
+        send_arp(structs::ARP::OPERATION_REQUEST, { }, unresolved);
+    }
+}
+
+MacAddress PacketSocketDevice::mac() const {
+    return shared->mac;
+}
+
+void PacketSocketDevice::close() {
+    shared->closed.store(true, std::memory_order::relaxed);
+}
+
+PacketSocketDevice::PacketSocketDevice(PacketSocketDevice&&) noexcept = default;
+
+PacketSocketDevice& PacketSocketDevice::operator=(PacketSocketDevice&&) noexcept = default;
+
+PacketSocketDevice::~PacketSocketDevice() = default;
+
+static void set_socket_option(const int fd, const int option, const void* value, const socklen_t size, const char* name) {
+    if (setsockopt(fd, SOL_PACKET, option, value, size) < 0) {
+        throw std::runtime_error(std::string("setsockopt(") + name + ")");
+    }
+}
+
+PacketSocketDevice PacketSocketBuilder::build() {
+    if (ip4.empty()) {
+        throw std::invalid_argument("A packet socket device needs an address");
+    }
+    if (queues == 0) {
+        throw std::invalid_argument("A packet socket device needs at least one queue");
+    }
+    const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (block_size == 0 || block_size % page_size != 0 || block_size % FrameSize != 0 || blocks_count == 0) {
+        throw std::invalid_argument("The blocks must be a multiple of the page size");
+    }
+    if (tx_frames == 0) {
+        throw std::invalid_argument("The transmit ring needs at least one frame");
+    }
+
+    auto shared = std::make_unique<PacketSocketDevice::Shared>();
+    shared->ip = string_to_network_ip(ip4);
+    shared->ifindex = static_cast<int>(if_nametoindex(interface_name.c_str()));
+    if (shared->ifindex == 0) {
+        throw std::runtime_error("No interface named " + interface_name);
+    }
+
+    shared->control_fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (shared->control_fd < 0) throw std::runtime_error("Opening a packet socket");
+
+    ifreq ifr { };
+    if (interface_name.size() >= IFNAMSIZ) {
+        throw std::invalid_argument("Interface name is too long");
+    }
+    std::strncpy(ifr.ifr_name, interface_name.data(), IFNAMSIZ - 1);
+    if (ioctl(shared->control_fd, SIOCGIFHWADDR, &ifr) < 0) {
+        throw std::runtime_error("ioctl(SIOCGIFHWADDR)");
+    }
+    std::copy_n(reinterpret_cast<const uint8_t*>(ifr.ifr_hwaddr.sa_data), sizeof(MacAddress), shared->mac.begin());
+
+    // Distinguishes the fanout group of this device from those of any other process
+    static std::atomic<uint16_t> devices_count = 0;
+    const auto fanout_group = static_cast<uint16_t>(getpid() + devices_count.fetch_add(1));
+
+    std::vector<std::unique_ptr<PacketSocketDevice::Queue>> result;
+    result.reserve(queues);
+    for (size_t i = 0; i < queues; i++) {
+        auto queue = std::make_unique<PacketSocketDevice::Queue>();
+        queue->fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_ALL));
+        if (queue->fd < 0) throw std::runtime_error("Opening a packet socket");
+
+        int version = TPACKET_V3;
+        set_socket_option(queue->fd, PACKET_VERSION, &version, sizeof(version), "PACKET_VERSION");
+
+        // Both are optimizations, so they're not required
+        int enabled = 1;
+        (void)setsockopt(queue->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &enabled, sizeof(enabled));
+        (void)setsockopt(queue->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &enabled, sizeof(enabled));
+
+        auto& rx = queue->rx;
+        rx.tp_block_size = static_cast<unsigned>(block_size);
+        rx.tp_block_nr = static_cast<unsigned>(blocks_count);
+        rx.tp_frame_size = static_cast<unsigned>(FrameSize);
+        rx.tp_frame_nr = static_cast<unsigned>(block_size / FrameSize * blocks_count);
+        rx.tp_retire_blk_tov = block_timeout;
+        set_socket_option(queue->fd, PACKET_RX_RING, &rx, sizeof(rx), "PACKET_RX_RING");
+
+        auto& tx = queue->tx;
+        tx.tp_block_size = static_cast<unsigned>(FrameSize * TxFramesPerBlock);
+        tx.tp_block_nr = static_cast<unsigned>((tx_frames + TxFramesPerBlock - 1) / TxFramesPerBlock);
+        tx.tp_frame_size = static_cast<unsigned>(FrameSize);
+        tx.tp_frame_nr = static_cast<unsigned>(tx.tp_block_nr * TxFramesPerBlock);
+        set_socket_option(queue->fd, PACKET_TX_RING, &tx, sizeof(tx), "PACKET_TX_RING");
+
+        queue->ring_size = static_cast<size_t>(rx.tp_block_size) * rx.tp_block_nr +
+                           static_cast<size_t>(tx.tp_block_size) * tx.tp_block_nr;
+        auto ring = mmap(nullptr, queue->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, queue->fd, 0);
+        if (ring == MAP_FAILED) throw std::runtime_error("mmap(packet rings)");
+        queue->ring = static_cast<uint8_t*>(ring);
+
+        sockaddr_ll address { };
+        address.sll_family = AF_PACKET;
+        address.sll_protocol = htons(ETH_P_ALL);
+        address.sll_ifindex = shared->ifindex;
+        if (bind(queue->fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            throw std::runtime_error("bind(packet socket)");
+        }
+
+        if (queues > 1) {
+            int fanout = fanout_group | (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16;
+            set_socket_option(queue->fd, PACKET_FANOUT, &fanout, sizeof(fanout), "PACKET_FANOUT");
+        }
+
+        result.push_back(std::move(queue));
+    }
+
+    return { std::move(result), std::move(shared) };
+}
+
+}
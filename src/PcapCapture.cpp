@@ -0,0 +1,113 @@
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <tcpp/PcapCapture.hpp>
+#include <tcpp/structs/Pcap.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
+
+namespace tcpp {
+
+struct PcapCapture::Record {
+
+    Record(const std::span<const uint8_t> packet, const std::chrono::system_clock::time_point time, const bool checksum_offloaded) {
+        const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch());
+        header.ts_sec = static_cast<uint32_t>(since_epoch.count() / 1'000'000'000);
+        header.ts_frac = static_cast<uint32_t>(since_epoch.count() % 1'000'000'000);
+        header.orig_len = static_cast<uint32_t>(packet.size());
+        header.incl_len = static_cast<uint32_t>(std::min(packet.size(), SnapLength));
+        std::memcpy(data.data(), packet.data(), header.incl_len);
+        // Only a whole segment can be checksummed
+        if (checksum_offloaded && header.incl_len == header.orig_len) {
+            auto& ip = structs::IPv4::from_ptr(data.data());
+            if (ip.version == 4 && ip.protocol == structs::IPv4::IPPROTOCOL_TCP) ip.compute_and_set_tcp_checksum();
+        }
+    }
+
+    // Laid out the way it's written to the file
+    structs::PcapRecordHeader header;
+    std::array<uint8_t, SnapLength> data;
+};
+
+struct PcapCapture::Ring : SPSCBoundedWaitFreeQueue<Record, RingCapacity> { };
+
+PcapCapture::PcapCapture(const std::string& path, const size_t queues)
+    : file(path, std::ios::binary | std::ios::trunc)
+{
+    if (queues == 0) {
+        throw std::invalid_argument("A capture needs at least one queue");
+    }
+    if (!file) {
+        throw std::runtime_error("Opening " + path);
+    }
+
+    structs::PcapFileHeader header {
+        .magic = structs::PcapFileHeader::MAGIC_NANOSECONDS,
+        .version_major = 2,
+        .version_minor = 4,
+        .thiszone = 0,
+        .sigfigs = 0,
+        .snaplen = SnapLength,
+        .linktype = structs::PcapFileHeader::LINKTYPE_RAW,
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    rings.reserve(2 * queues);
+    for (size_t i = 0; i < 2 * queues; i++) {
+        rings.push_back(std::make_unique<Ring>());
+    }
+
+    writer_thread = std::jthread { [this](std::stop_token token) { writer(std::move(token)); } };
+}
+
+void PcapCapture::record_received(const size_t queue, const std::span<const uint8_t> packet) {
+    record(2 * queue, packet);
+}
+
+void PcapCapture::record_sent(const size_t queue, const std::span<const uint8_t> packet, const bool checksum_offloaded) {
+    record(2 * queue + 1, packet, checksum_offloaded);
+}
+
+void PcapCapture::record(const size_t ring, const std::span<const uint8_t> packet, const bool checksum_offloaded) {
+    // Copied straight into the slot of the ring
+    if (!rings[ring]->push(packet, std::chrono::system_clock::now(), checksum_offloaded)) {
+        dropped.fetch_add(1, std::memory_order::relaxed);
+    }
+}
+
+size_t PcapCapture::drain() {
+    size_t written = 0;
+    for (auto& ring : rings) {
+        // Written straight out of the ring. Only what's contiguous is taken at once,
+        //  which is at most a whole ring, so a busy ring doesn't starve the rest.
+        auto records = ring->pop_region();
+        for (auto& record : records) {
+            file.write(reinterpret_cast<const char*>(&record.header), sizeof(record.header));
+            file.write(reinterpret_cast<const char*>(record.data.data()), record.header.incl_len);
+        }
+        ring->commit_pop(records.size());
+        written += records.size();
+    }
+    return written;
+}
+
+void PcapCapture::writer(std::stop_token token) {
+    while (!token.stop_requested()) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    // Whatever was recorded before the stop
+    while (drain() != 0) { }
+    file.flush();
+}
+
+PcapCapture::~PcapCapture() {
+    writer_thread.request_stop();
+    writer_thread.join();
+}
+
+}
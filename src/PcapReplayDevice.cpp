@@ -0,0 +1,244 @@
+#include <bit>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <condition_variable>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tcpp/PcapReplayDevice.hpp>
+#include <tcpp/structs/Pcap.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/structs/TCP.hpp>
+#include <tcpp/utils/Connections.hpp>
+#include <tcpp/utils/FileDescriptor.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
+
+namespace tcpp {
+
+struct PcapReplayDevice::Replay {
+
+    struct Packet {
+        const uint8_t* data;
+        uint32_t size;
+        // Since the first packet of the file
+        std::chrono::nanoseconds time;
+    };
+
+    struct Queue {
+        std::vector<Packet> packets;
+        // Only advanced by the receiver of the queue
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> next = 0;
+    };
+
+    Replay(const std::string& path, const ReplayTiming timing_, const size_t queues_count)
+        : timing(timing_), queues(queues_count)
+    {
+        if (queues_count == 0) {
+            throw std::invalid_argument("A replay device needs at least one queue");
+        }
+
+        FileDescriptor fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Opening " + path);
+        struct stat status { };
+        if (fstat(fd, &status) < 0) throw std::runtime_error("fstat(" + path + ")");
+        mapping_size = static_cast<size_t>(status.st_size);
+        if (mapping_size < sizeof(structs::PcapFileHeader)) {
+            throw std::runtime_error(path + " is not a pcap file");
+        }
+        // Prefaulted, so that replaying doesn't hit the disk
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::runtime_error("mmap(" + path + ")");
+        }
+
+        try {
+            index(path);
+        } catch (...) {
+            munmap(mapping, mapping_size);
+            throw;
+        }
+    }
+
+    // Finds all the replayable packets, and splits them over the queues
+    void index(const std::string& path) {
+        auto file = static_cast<const uint8_t*>(mapping);
+
+        structs::PcapFileHeader header { };
+        std::memcpy(&header, file, sizeof(header));
+        bool swapped = false;
+        bool nanoseconds = false;
+        switch (header.magic) {
+            case structs::PcapFileHeader::MAGIC_MICROSECONDS: break;
+            case structs::PcapFileHeader::MAGIC_NANOSECONDS: nanoseconds = true; break;
+            case std::byteswap(structs::PcapFileHeader::MAGIC_MICROSECONDS): swapped = true; break;
+            case std::byteswap(structs::PcapFileHeader::MAGIC_NANOSECONDS): swapped = nanoseconds = true; break;
+            default: throw std::runtime_error(path + " is not a pcap file");
+        }
+        auto field = [swapped](const uint32_t value) { return swapped ? std::byteswap(value) : value; };
+
+        // The upper bits may carry the FCS length, which doesn't matter here
+        const auto linktype = field(header.linktype) & 0xFFFF;
+        size_t link_header_size = 0;
+        if (linktype == structs::PcapFileHeader::LINKTYPE_ETHERNET) {
+            link_header_size = 14;
+        } else if (linktype != structs::PcapFileHeader::LINKTYPE_RAW &&
+                   linktype != structs::PcapFileHeader::LINKTYPE_IPV4) {
+            throw std::runtime_error(path + " has an unsupported link type");
+        }
+
+        std::chrono::nanoseconds first_time { -1 };
+        size_t offset = sizeof(header);
+        while (offset + sizeof(structs::PcapRecordHeader) <= mapping_size) {
+            structs::PcapRecordHeader record { };
+            std::memcpy(&record, file + offset, sizeof(record));
+            offset += sizeof(record);
+            const size_t captured = field(record.incl_len);
+            if (offset + captured > mapping_size) break;  // Truncated file
+            auto data = file + offset;
+            offset += captured;
+
+            std::chrono::nanoseconds time =
+                std::chrono::seconds(field(record.ts_sec)) +
+                (nanoseconds ? std::chrono::nanoseconds(field(record.ts_frac)) : std::chrono::microseconds(field(record.ts_frac)));
+            if (first_time.count() < 0) first_time = time;
+
+            if (captured < link_header_size + sizeof(structs::IPv4)) continue;
+            if (link_header_size != 0) {
+                // Only IPv4 frames
+                if (data[12] != 0x08 || data[13] != 0x00) continue;
+                data += link_header_size;
+            }
+
+            auto& ip = structs::IPv4::from_ptr(const_cast<uint8_t*>(data));
+            if (ip.version != 4) continue;
+            // Anything after the IP packet (like the padding of short frames) is dropped, and
+            //  packets cut short by the snapshot length or too large for a buffer are skipped
+            const size_t size = ip.total_len();
+            if (size < sizeof(structs::IPv4) || size > captured - link_header_size) continue;
+            if (size > PacketAllocator::LargeCapacity) continue;
+
+            size_t queue = 0;
+            if (queues.size() > 1 && ip.protocol == structs::IPv4::IPPROTOCOL_TCP &&
+                size >= ip.payload_offset() + sizeof(structs::TCP)) {
+                queue = std::hash<ConnectionID>{}(ip.connection_id()) % queues.size();
+            }
+            queues[queue].packets.push_back({ data, static_cast<uint32_t>(size), time - first_time });
+            total_packets++;
+        }
+    }
+
+    Replay(const Replay&) = delete;
+
+    Replay& operator=(const Replay&) = delete;
+
+    ~Replay() {
+        munmap(mapping, mapping_size);
+    }
+
+    const ReplayTiming timing;
+
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    std::vector<Queue> queues;
+    size_t total_packets = 0;
+
+    // The recorded timing is relative to when the first packet is received on any of the queues
+    std::once_flag started;
+    std::chrono::steady_clock::time_point start;
+
+    // The receivers waiting for the time of their next packet are woken up when it's closed
+    std::mutex close_mutex;
+    std::condition_variable close_condition;
+    std::atomic<bool> closed = false;
+    std::atomic<size_t> sent = 0;
+};
+
+PcapReplayDevice::PcapReplayDevice(const std::string& path, const ReplayTiming timing_, const size_t queues)
+    : replay(std::make_unique<Replay>(path, timing_, queues)) { }
+
+ReceivedPacket PcapReplayDevice::receive_packet(const size_t queue) {
+    auto& state = replay->queues[queue];
+    const auto next = state.next.load(std::memory_order::relaxed);
+    if (replay->closed.load(std::memory_order::relaxed) || next == state.packets.size()) {
+        return { };
+    }
+    const auto& packet = state.packets[next];
+
+    if (replay->timing == ReplayTiming::Recorded) {
+        std::call_once(replay->started, [this] { replay->start = std::chrono::steady_clock::now(); });
+        // Packets that are already late don't take the lock
+        const auto deadline = replay->start + packet.time;
+        if (std::chrono::steady_clock::now() < deadline) {
+            std::unique_lock lock(replay->close_mutex);
+            const auto closed = replay->close_condition.wait_until(lock, deadline, [this] {
+                return replay->closed.load(std::memory_order::relaxed);
+            });
+            if (closed) return { };
+        }
+    }
+
+    auto buffer = PacketAllocator{}.allocate(packet.size);
+    std::memcpy(buffer, packet.data, packet.size);
+    state.next.store(next + 1, std::memory_order::relaxed);
+    // The checksums are verified, since the file may have been captured before they're computed
+    return { .data = { buffer, packet.size } };
+}
+
+void PcapReplayDevice::send_packets(const std::span<const std::span<uint8_t>> packets, size_t) {
+    std::array<PacketBuffer, 64> buffers { };
+    size_t count = 0;
+    for (auto packet : packets) {
+        buffers[count++] = packet.data();
+        if (count == buffers.size()) {
+            PacketAllocator{}.deallocate_bulk(buffers);
+            count = 0;
+        }
+    }
+    PacketAllocator{}.deallocate_bulk({ buffers.data(), count });
+    replay->sent.fetch_add(packets.size(), std::memory_order::relaxed);
+}
+
+size_t PcapReplayDevice::queues_count() const {
+    return replay->queues.size();
+}
+
+void PcapReplayDevice::close() {
+    {
+        std::lock_guard lock(replay->close_mutex);
+        replay->closed.store(true, std::memory_order::relaxed);
+    }
+    replay->close_condition.notify_all();
+}
+
+size_t PcapReplayDevice::packets_count() const {
+    return replay->total_packets;
+}
+
+size_t PcapReplayDevice::replayed_count() const {
+    size_t result = 0;
+    for (auto& queue : replay->queues) {
+        result += queue.next.load(std::memory_order::relaxed);
+    }
+    return result;
+}
+
+size_t PcapReplayDevice::sent_count() const {
+    return replay->sent.load(std::memory_order::relaxed);
+}
+
+PcapReplayDevice::PcapReplayDevice(PcapReplayDevice&&) noexcept = default;
+
+PcapReplayDevice& PcapReplayDevice::operator=(PcapReplayDevice&&) noexcept = default;
+
+PcapReplayDevice::~PcapReplayDevice() = default;
+
+}
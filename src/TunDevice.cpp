@@ -11,28 +11,371 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <iostream>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <algorithm>
 
+#include <tcpp/TypeDefs.hpp>
 #include <tcpp/TunDevice.hpp>
+#include <tcpp/utils/IoUring.hpp>
 #include <tcpp/utils/FileDescriptor.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/structs/TCP.hpp>
+#include <tcpp/structs/VirtioNet.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/data-structures/SPSCBoundedWaitFreeQueue.hpp>
 
 namespace tcpp {
 
-ssize_t TunDevice::receive(std::span<uint8_t> buffer) const {
-    return read(fd, buffer.data(), buffer.size());
+// The virtio-net header sits in the headroom, right before the IP header.
+//  It's read and written along with the packet, in the same system call.
+static_assert(PacketHeadroom >= sizeof(structs::VirtioNetHeader));
+
+static std::span<uint8_t> with_vnet_header(const PacketBuffer buffer, const size_t size, const bool vnet_header) {
+    const auto header_size = vnet_header ? sizeof(structs::VirtioNetHeader) : 0;
+    return { buffer - header_size, size + header_size };
+}
+
+// The size of the buffers to receive packets into. Once the offloads are
+//  enabled, the kernel can coalesce segments into frames of up to 64KB.
+static size_t receive_capacity(const bool vnet_header) {
+    return vnet_header ? PacketAllocator::LargeCapacity : PacketAllocator::RegularCapacity;
+}
+
+// n: the number of bytes read, including the virtio-net header if there is one
+static ReceivedPacket finish_receive(const PacketBuffer buffer, const size_t n, const bool vnet_header) {
+    if (!vnet_header) return { { buffer, n }, false };
+    if (n <= sizeof(structs::VirtioNetHeader)) return { { buffer, 0 }, false };
+    auto& header = *reinterpret_cast<const structs::VirtioNetHeader*>(buffer - sizeof(structs::VirtioNetHeader));
+    // Packets needing a checksum come from the local stack, which leaves only the partial
+    //  checksum of the pseudo-header in them. There is nothing meaningful to verify.
+    const bool checksum_valid = header.flags & (structs::VirtioNetHeader::FLAG_DATA_VALID | structs::VirtioNetHeader::FLAG_NEEDS_CSUM);
+    return { { buffer, n - sizeof(structs::VirtioNetHeader) }, checksum_valid };
+}
+
+// Fills in the virtio-net header, and leaves the TCP checksum to the kernel (or the NIC)
+static void prepare_transmit(const PacketBuffer buffer) {
+    auto& header = *reinterpret_cast<structs::VirtioNetHeader*>(buffer - sizeof(structs::VirtioNetHeader));
+    header = { };
+    header.gso_type = structs::VirtioNetHeader::GSO_NONE;
+
+    auto& ip = structs::IPv4::from_ptr(buffer);
+    if (ip.version != 4 || ip.protocol != structs::IPv4::IPPROTOCOL_TCP) return;
+
+    auto& tcp = ip.tcp_payload();
+    ip.compute_and_set_tcp_partial_checksum();
+    header.flags = structs::VirtioNetHeader::FLAG_NEEDS_CSUM;
+    header.csum_start = static_cast<uint16_t>(ip.payload_offset());
+    header.csum_offset = static_cast<uint16_t>(offsetof(structs::TCP, checksum_n));
+
+    const auto headers_size = ip.payload_offset() + tcp.payload_offset();
+    const auto gso_size = PacketAllocator::metadata(buffer).gso_size;
+    if (gso_size > 0 && ip.total_len() - headers_size > gso_size) {
+        header.gso_type = structs::VirtioNetHeader::GSO_TCPV4;
+        header.gso_size = gso_size;
+        header.hdr_len = static_cast<uint16_t>(headers_size);
+    }
+}
+
+struct alignas(CACHE_LINE_SIZE) TunDevice::WriteCounters {
+    std::atomic<uint64_t> failed = 0;
+    std::atomic<uint64_t> short_writes = 0;
+
+    // n: the result of the write, and size: the bytes it was given
+    void record(const ssize_t n, const size_t size) {
+        if (n < 0) failed.fetch_add(1, std::memory_order::relaxed);
+        else if (static_cast<size_t>(n) < size) short_writes.fetch_add(1, std::memory_order::relaxed);
+    }
+};
+
+// Receiving and sending use separate rings, since each
+//  of them is driven by a different thread of the stack
+struct TunDevice::QueueRings {
+
+    QueueRings(const int fd_, const unsigned entries, const bool vnet_header_, WriteCounters& write_counters_)
+        : rx(entries), tx(entries), fd(fd_), vnet_header(vnet_header_), write_counters(write_counters_)
+    {
+        // Registration can fail because of the limits on locked memory.
+        //  Plain reads and writes are used instead in this case.
+        const auto buffers = allocator_regions();
+        rx_updatable = rx.register_buffers(buffers);
+        tx_updatable = tx.register_buffers(buffers);
+
+        PacketAllocator allocator;
+        for (unsigned i = 0; i < entries; i++) {
+            prepare_read(allocator.allocate(receive_capacity(vnet_header)));
+        }
+        (void)rx.submit();
+    }
+
+    // The memory backing the buffers so far, one region for each of the size classes
+    static std::array<iovec, PacketAllocator::SizeClassesCount> allocator_regions() {
+        std::array<iovec, PacketAllocator::SizeClassesCount> buffers { };
+        const auto regions = PacketAllocator::regions();
+        for (size_t i = 0; i < regions.size(); i++) {
+            buffers[i] = { regions[i].data(), regions[i].size() };
+        }
+        return buffers;
+    }
+
+    // The index of the fixed buffer holding the span, or -1 if none. Only the memory that's backed can be
+    //  registered, since the kernel pins it, so the regions are registered again as the arenas grow, the
+    //  first time a buffer is found past them. Plain operations are used from then on if that fails.
+    static int fixed_buffer_index(IoUring& ring, bool& updatable, const std::span<const uint8_t> span) {
+        const auto index = ring.buffer_index(span.data(), span.size());
+        if (index >= 0 || !updatable) return index;
+        if (!ring.update_buffers(allocator_regions())) {
+            updatable = false;
+            return -1;
+        }
+        return ring.buffer_index(span.data(), span.size());
+    }
+
+    void prepare_read(const PacketBuffer buffer) {
+        auto sqe = rx.get_sqe();
+        // There are never more reads in flight than the entries of the ring
+        assert(sqe != nullptr);
+        const auto span = with_vnet_header(buffer, receive_capacity(vnet_header), vnet_header);
+        const auto index = fixed_buffer_index(rx, rx_updatable, span);
+        sqe->opcode = index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe->buf_index = static_cast<uint16_t>(std::max(index, 0));
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(span.data());
+        sqe->len = static_cast<uint32_t>(span.size());
+        sqe->off = static_cast<uint64_t>(-1);
+        sqe->user_data = reinterpret_cast<uint64_t>(buffer);
+        rx_in_flight++;
+    }
+
+    void prepare_write(const std::span<uint8_t> packet) {
+        while (tx_in_flight == tx.entries()) {
+            // Make room by waiting for the earliest writes to complete
+            (void)tx.submit(1);
+            reap_writes();
+        }
+        auto sqe = tx.get_sqe();
+        assert(sqe != nullptr);
+        if (vnet_header) prepare_transmit(packet.data());
+        const auto span = with_vnet_header(packet.data(), packet.size(), vnet_header);
+        const auto index = fixed_buffer_index(tx, tx_updatable, span);
+        sqe->opcode = index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->buf_index = static_cast<uint16_t>(std::max(index, 0));
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(span.data());
+        sqe->len = static_cast<uint32_t>(span.size());
+        sqe->off = static_cast<uint64_t>(-1);
+        sqe->user_data = reinterpret_cast<uint64_t>(packet.data());
+        tx_in_flight++;
+    }
+
+    // Returns the buffers of the completed writes to the allocator, in bulk, counting the ones that failed
+    void reap_writes() {
+        std::array<PacketBuffer, 64> buffers { };
+        size_t count = 0;
+        while (auto cqe = tx.peek_cqe()) {
+            const auto buffer = reinterpret_cast<PacketBuffer>(cqe->user_data);
+            const auto size = structs::IPv4::from_ptr(buffer).total_len();
+            write_counters.record(cqe->res, with_vnet_header(buffer, size, vnet_header).size());
+            buffers[count++] = buffer;
+            tx.advance();
+            tx_in_flight--;
+            if (count == buffers.size()) {
+                PacketAllocator{}.deallocate_bulk(buffers);
+                count = 0;
+            }
+        }
+        PacketAllocator{}.deallocate_bulk({ buffers.data(), count });
+    }
+
+    // Cancels the reads in flight and waits for them to complete, returning their buffers to the allocator
+    void cancel_reads() {
+        if (cancelled) return;
+        cancelled = true;
+        if (auto sqe = rx.get_sqe()) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = 0;
+        }
+        PacketAllocator allocator;
+        // If the kernel doesn't support cancellation by fd, the buffers
+        //  of the reads in flight are given up on after the timeout
+        for (int attempts = 0; attempts < 10 && rx_in_flight > 0; attempts++) {
+            (void)rx.submit(1, std::chrono::milliseconds(100));
+            while (auto cqe = rx.peek_cqe()) {
+                if (cqe->user_data != 0) {
+                    allocator.deallocate(reinterpret_cast<PacketBuffer>(cqe->user_data));
+                    rx_in_flight--;
+                }
+                rx.advance();
+            }
+        }
+    }
+
+    ~QueueRings() {
+        cancel_reads();
+        for (int attempts = 0; attempts < 10 && tx_in_flight > 0; attempts++) {
+            (void)tx.submit(1, std::chrono::milliseconds(100));
+            reap_writes();
+        }
+    }
+
+    IoUring rx;
+    IoUring tx;
+    const int fd;
+    const bool vnet_header;
+    WriteCounters& write_counters;
+    unsigned rx_in_flight = 0;
+    unsigned tx_in_flight = 0;
+    // Whether the fixed buffers of each of the rings are registered, and can still be updated
+    bool rx_updatable = false;
+    bool tx_updatable = false;
+    bool cancelled = false;
+    // Set by close(), from a thread other than the one driving the rings
+    std::atomic<bool> closed = false;
+};
+
+TunDevice::TunDevice(std::vector<FileDescriptor> fds_, std::string name_, const bool vnet_header_)
+    : fds(std::move(fds_)), name(std::move(name_)), vnet_header(vnet_header_),
+      write_counters(std::make_unique<WriteCounters[]>(fds.size())) { }
+
+TunDevice::TunDevice(TunDevice&&) noexcept = default;
+
+TunDevice& TunDevice::operator=(TunDevice&&) noexcept = default;
+
+void TunDevice::setup_io_uring(const unsigned entries) {
+    rings.reserve(fds.size());
+    for (size_t i = 0; i < fds.size(); i++) {
+        rings.push_back(std::make_unique<QueueRings>(fds[i], entries, vnet_header, write_counters[i]));
+    }
+}
+
+TunDevice::WriteErrors TunDevice::write_errors() const {
+    WriteErrors result;
+    for (size_t i = 0; i < fds.size(); i++) {
+        result.failed += write_counters[i].failed.load(std::memory_order::relaxed);
+        result.short_writes += write_counters[i].short_writes.load(std::memory_order::relaxed);
+    }
+    return result;
+}
+
+ssize_t TunDevice::receive(std::span<uint8_t> buffer, const size_t queue) const {
+    return read(fds[queue], buffer.data(), buffer.size());
+}
+
+ssize_t TunDevice::send(std::span<const uint8_t> buffer, const size_t queue) const {
+    return write(fds[queue], buffer.data(), buffer.size());
+}
+
+size_t TunDevice::send_batch(std::span<const std::span<const uint8_t>> packets, const size_t queue) const {
+    // A tun file descriptor takes exactly one packet per write(), and there
+    //  is no multi-packet variant of write() for it. The batch still saves
+    //  the caller from the per-packet bookkeeping around the calls.
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (send(packets[i], queue) < 0) return i;
+    }
+    return packets.size();
 }
 
-ssize_t TunDevice::send(std::span<const uint8_t> buffer) const {
-    return write(fd, buffer.data(), buffer.size());
+ReceivedPacket TunDevice::receive_packet(const size_t queue) {
+    PacketAllocator allocator;
+
+    if (rings.empty()) {
+        auto buffer = allocator.allocate(receive_capacity(vnet_header));
+        auto n = receive(with_vnet_header(buffer, receive_capacity(vnet_header), vnet_header), queue);
+        auto packet = n > 0 ? finish_receive(buffer, static_cast<size_t>(n), vnet_header) : ReceivedPacket { };
+        if (packet.data.empty()) {
+            allocator.deallocate(buffer);
+            return { };
+        }
+        return packet;
+    }
+
+    auto& ring = *rings[queue];
+    while (!ring.closed.load(std::memory_order::acquire)) {
+        auto cqe = ring.rx.peek_cqe();
+        if (cqe == nullptr) {
+            // Wake up periodically to check whether the device is closed
+            (void)ring.rx.submit(1, std::chrono::milliseconds(100));
+            continue;
+        }
+
+        auto buffer = reinterpret_cast<PacketBuffer>(cqe->user_data);
+        auto n = cqe->res;
+        ring.rx.advance();
+        ring.rx_in_flight--;
+
+        auto packet = n > 0 ? finish_receive(buffer, static_cast<size_t>(n), vnet_header) : ReceivedPacket { };
+        if (packet.data.empty()) {
+            // The device is gone (or some other problem)
+            allocator.deallocate(buffer);
+            break;
+        }
+
+        // Keep the same number of reads in flight. This is submitted
+        //  along with the wait for the next packet, in the next call.
+        ring.prepare_read(allocator.allocate(receive_capacity(vnet_header)));
+        return packet;
+    }
+
+    ring.cancel_reads();
+    return { };
+}
+
+void TunDevice::send_packets(const std::span<const std::span<uint8_t>> packets, const size_t queue) {
+    PacketAllocator allocator;
+
+    if (rings.empty()) {
+        std::array<PacketBuffer, 64> buffers { };
+        size_t count = 0;
+        for (auto packet : packets) {
+            if (vnet_header) prepare_transmit(packet.data());
+            const auto span = with_vnet_header(packet.data(), packet.size(), vnet_header);
+            write_counters[queue].record(send(span, queue), span.size());
+            buffers[count++] = packet.data();
+            if (count == buffers.size()) {
+                allocator.deallocate_bulk(buffers);
+                count = 0;
+            }
+        }
+        allocator.deallocate_bulk({ buffers.data(), count });
+        return;
+    }
+
+    // All the packets are submitted with a single system call (unless the ring
+    //  fills up), and the buffers are freed as their completions are reaped.
+    auto& ring = *rings[queue];
+    for (auto packet : packets) {
+        ring.prepare_write(packet);
+    }
+    (void)ring.tx.submit();
+    ring.reap_writes();
 }
 
 void TunDevice::close() {
+    if (!rings.empty()) {
+        // Closing the file descriptors doesn't interrupt the reads in flight in
+        //  the rings. The receiving threads notice this flag instead, and cancel
+        //  their reads. The file descriptors are closed at the destruction.
+        for (auto& ring : rings) {
+            ring->closed.store(true, std::memory_order::release);
+        }
+        return;
+    }
+
     already_closed = true;
-    ::close(fd);
+    for (auto& fd : fds) {
+        ::close(fd);
+    }
 }
 
 TunDevice::~TunDevice() {
     if (already_closed) {
-        fd.set_without_closing(-1);
+        for (auto& fd : fds) {
+            fd.set_without_closing(-1);
+        }
     }
 }
 
@@ -41,19 +384,46 @@ void TunBuilder::allocate_tun() {
         throw std::invalid_argument("Device name is too long");
     }
 
-    fd = open("/dev/net/tun", O_RDWR);
-    if (fd < 0) throw std::runtime_error("Opening /dev/net/tun");
+    if (queues == 0) {
+        throw std::invalid_argument("A tun device needs at least one queue");
+    }
 
-    ifreq ifr { };
-    ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
-    // TODO correct?
-    if (!name.empty()) std::strncpy(ifr.ifr_name, name.data(), name.size() + 1);
+    fds.clear();
+    fds.reserve(queues);
 
-    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
-        throw std::runtime_error("ioctl(TUNSETIFF)");
-    }
+    for (size_t i = 0; i < queues; i++) {
+        FileDescriptor fd = open("/dev/net/tun", O_RDWR);
+        if (fd < 0) throw std::runtime_error("Opening /dev/net/tun");
+
+        ifreq ifr { };
+        ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+        if (queues > 1) ifr.ifr_flags |= IFF_MULTI_QUEUE;
+        if (offloads) ifr.ifr_flags |= IFF_VNET_HDR;
+        // TODO correct?
+        // After the first queue is attached, the name is known (even if
+        //  it was chosen by the kernel), and the rest of the queues attach to it.
+        if (!name.empty()) std::strncpy(ifr.ifr_name, name.data(), name.size() + 1);
+
+        if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+            throw std::runtime_error("ioctl(TUNSETIFF)");
+        }
 
-    if (name.empty()) name = ifr.ifr_name;
+        if (name.empty()) name = ifr.ifr_name;
+
+        if (offloads) {
+            int header_size = sizeof(structs::VirtioNetHeader);
+            if (ioctl(fd, TUNSETVNETHDRSZ, &header_size) < 0) {
+                throw std::runtime_error("ioctl(TUNSETVNETHDRSZ)");
+            }
+            // The kernel is allowed to hand us packets with partial checksums,
+            //  and to coalesce TCP segments into larger ones.
+            if (ioctl(fd, TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4) < 0) {
+                throw std::runtime_error("ioctl(TUNSETOFFLOAD)");
+            }
+        }
+
+        fds.push_back(std::move(fd));
+    }
 }
 
 struct TunBuilderHelper {
@@ -118,7 +488,11 @@ TunDevice TunBuilder::build() {
     allocate_tun();
     TunBuilderHelper helper { name, ip4, netmask };
     helper.build();
-    return TunDevice { std::move(fd), helper.ifr.ifr_name };
+    TunDevice device { std::move(fds), helper.ifr.ifr_name, offloads };
+    if (io_uring_entries > 0) {
+        device.setup_io_uring(io_uring_entries);
+    }
+    return device;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <tcpp/allocators/Arena.hpp>
+
+namespace tcpp {
+
+// From linux/mempolicy.h, which isn't needed otherwise
+constexpr int MPOL_PREFERRED = 1;
+
+static size_t round_up(const size_t size, const size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+Arena::Arena(const size_t reserved_size_, const ArenaOptions& options_)
+    : options(options_),
+      reserved_size(round_up(std::min(reserved_size_, options_.max_size), HugePageSize))
+{
+    // Over-reserved by a huge page, so that the range can start at a huge page boundary
+    const auto mapping_size = reserved_size + HugePageSize;
+    auto mapping = mmap(nullptr, mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("mmap(arena reservation)");
+    }
+    auto start = reinterpret_cast<uintptr_t>(mapping);
+    auto aligned = round_up(start, HugePageSize);
+    if (aligned > start) {
+        munmap(mapping, aligned - start);
+    }
+    if (auto tail = start + mapping_size - (aligned + reserved_size); tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + reserved_size), tail);
+    }
+    base = reinterpret_cast<uint8_t*>(aligned);
+
+    if (grow(options.initial_size) == 0 && reserved_size > 0) {
+        munmap(base, reserved_size);
+        throw std::runtime_error("The arena couldn't be backed by memory");
+    }
+}
+
+Arena::~Arena() {
+    munmap(base, reserved_size);
+}
+
+size_t Arena::grow(const size_t size) {
+    const auto committed = committed_size.load(std::memory_order_relaxed);
+    const auto added = std::min(round_up(std::max<size_t>(size, 1), HugePageSize), reserved_size - committed);
+    if (added == 0) return 0;
+    auto address = base + committed;
+
+    if (!options.huge_pages || !map_huge_pages(address, added)) {
+        // Regular pages, which the kernel may still back with transparent huge pages
+        if (mprotect(address, added, PROT_READ | PROT_WRITE) != 0) return 0;
+        if (options.huge_pages) (void)madvise(address, added, MADV_HUGEPAGE);
+        explicit_huge_pages = false;
+    }
+
+    if (options.numa_node >= 0) {
+        // Before the memory is touched, which is when it gets placed. The mask is as long as it takes to hold
+        //  the node, and the kernel reads one bit less than it's told to (see mbind(2)).
+        constexpr size_t word_bits = sizeof(unsigned long) * CHAR_BIT;
+        const auto node = static_cast<size_t>(options.numa_node);
+        std::vector<unsigned long> nodes(node / word_bits + 1);
+        nodes[node / word_bits] = 1UL << (node % word_bits);
+        (void)syscall(SYS_mbind, address, added, MPOL_PREFERRED, nodes.data(), nodes.size() * word_bits + 1, 0);
+    }
+    if (options.lock_memory) {
+        (void)mlock(address, added);
+    }
+
+    committed_size.store(committed + added, std::memory_order_release);
+    return added;
+}
+
+// The huge pages are mapped elsewhere first and only then moved over the reservation, since
+//  a failed MAP_FIXED mapping may leave a hole in the reserved range for others to map into
+bool Arena::map_huge_pages(uint8_t* address, const size_t size) {
+    auto mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping == MAP_FAILED) {
+        // None are reserved, or not enough of them are left
+        return false;
+    }
+    if (mremap(mapping, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, address) == MAP_FAILED) {
+        munmap(mapping, size);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+
+#include <tcpp/congestion-control/BBR.hpp>
+
+namespace tcpp {
+
+// 2 / ln(2), the smallest gain that doubles the delivery rate each round
+static constexpr double StartupGain = 2.885;
+// On top of the bandwidth-delay product, for the acknowledgements that arrive late or in bulk
+static constexpr double CwndGain = 2;
+// Probes for more bandwidth for a round, drains the queue that may have built up for another, then cruises
+static constexpr std::array<double, 8> CycleGains { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+static constexpr uint32_t BandwidthRounds = 10;
+static constexpr auto MinRttWindow = std::chrono::seconds(10);
+static constexpr auto ProbeRttDuration = std::chrono::milliseconds(200);
+static constexpr uint32_t MinWindowSegments = 4;
+static constexpr uint64_t MaxWindow = 1 << 30;
+static constexpr double EcnBackoff = 0.7;
+
+uint64_t BBR::WindowedMax::update(const uint64_t value, const uint32_t round, const uint32_t window) {
+    const Sample sample { value, round };
+    if (value >= samples[0].value || round - samples[2].round > window) {
+        // A new maximum, or nothing left in the window
+        samples.fill(sample);
+        return value;
+    }
+    if (value >= samples[1].value) {
+        samples[1] = samples[2] = sample;
+    } else if (value >= samples[2].value) {
+        samples[2] = sample;
+    }
+
+    // The best sample has expired, or the others have gone stale for a quarter and a half of the window
+    const auto age = round - samples[0].round;
+    if (age > window) {
+        samples[0] = samples[1];
+        samples[1] = samples[2];
+        samples[2] = sample;
+        if (round - samples[0].round > window) {
+            samples[0] = samples[1];
+            samples[1] = samples[2];
+        }
+    } else if (samples[1].round == samples[0].round && age > window / 4) {
+        samples[1] = samples[2] = sample;
+    } else if (samples[2].round == samples[1].round && age > window / 2) {
+        samples[2] = sample;
+    }
+    return samples[0].value;
+}
+
+BBR::BBR(const uint32_t mss_) : mss(mss_), cwnd(initial_window(mss_)) { }
+
+uint64_t BBR::bdp() const {
+    if (bandwidth.samples[0].value == 0 || min_rtt == std::chrono::nanoseconds::max()) return 0;
+    return static_cast<uint64_t>(static_cast<double>(bandwidth.samples[0].value) * std::chrono::duration<double>(min_rtt).count());
+}
+
+double BBR::gain() const {
+    switch (mode) {
+        case Mode::Startup: return StartupGain;
+        case Mode::Drain: return 1;
+        case Mode::ProbeBandwidth: return CwndGain * CycleGains[cycle_index];
+        case Mode::ProbeRTT: return 0;
+    }
+    return 1;
+}
+
+void BBR::on_ack(const AckEvent& ack) {
+    delivered += ack.acked;
+    if (delivered >= round_end) {
+        start_round(ack);
+    }
+    update_mode(ack);
+
+    const uint32_t min_window = MinWindowSegments * mss;
+    if (mode == Mode::ProbeRTT) {
+        cwnd = std::min(cwnd, min_window);
+        return;
+    }
+    if (ack.recovering) {
+        // Packet conservation: a segment is sent for each one that leaves the network
+        recovering = true;
+        cwnd = std::max(cwnd, ack.in_flight);
+        return;
+    }
+    if (recovering) {
+        recovering = false;
+        cwnd = std::max(cwnd, prior_cwnd);
+    }
+
+    const auto target = static_cast<uint64_t>(gain() * static_cast<double>(bdp()));
+    uint64_t next = cwnd;
+    if (full_bandwidth_reached && target > 0) {
+        next = std::min(next + ack.acked, target);
+    } else if (next < target || target == 0) {
+        next += ack.acked;
+    }
+    cwnd = static_cast<uint32_t>(std::clamp<uint64_t>(next, min_window, MaxWindow));
+}
+
+void BBR::start_round(const AckEvent& ack) {
+    if (round_start != SteadyTime { } && ack.now > round_start) {
+        // The delivery rate over the whole round
+        const auto elapsed = std::chrono::duration<double>(ack.now - round_start).count();
+        const auto rate = static_cast<double>(delivered - round_start_delivered) / elapsed;
+        bandwidth.update(static_cast<uint64_t>(rate), round, BandwidthRounds);
+    }
+    round++;
+    round_start = ack.now;
+    round_start_delivered = delivered;
+    round_end = delivered + (ack.in_flight - std::min(ack.acked, ack.in_flight));
+
+    // The bandwidth is taken as found once it grows by less than a quarter for three rounds in a row
+    if (!full_bandwidth_reached) {
+        const auto current = bandwidth.samples[0].value;
+        if (current >= full_bandwidth + full_bandwidth / 4) {
+            full_bandwidth = current;
+            stalled_rounds = 0;
+        } else if (++stalled_rounds >= 3) {
+            full_bandwidth_reached = true;
+        }
+    }
+}
+
+void BBR::update_mode(const AckEvent& ack) {
+    switch (mode) {
+        case Mode::Startup:
+            if (full_bandwidth_reached) mode = Mode::Drain;
+            break;
+        case Mode::Drain:
+            if (ack.in_flight <= bdp()) {
+                mode = Mode::ProbeBandwidth;
+                // Starts cruising, rather than probing into the queue just drained
+                cycle_index = 2;
+                mode_stamp = ack.now;
+            }
+            break;
+        case Mode::ProbeBandwidth:
+            if (ack.now - mode_stamp > min_rtt) {
+                cycle_index = static_cast<uint8_t>((cycle_index + 1) % CycleGains.size());
+                mode_stamp = ack.now;
+            }
+            break;
+        case Mode::ProbeRTT:
+            if (ack.now >= mode_stamp) {
+                min_rtt_stamp = ack.now;
+                mode = full_bandwidth_reached ? Mode::ProbeBandwidth : Mode::Startup;
+                mode_stamp = ack.now;
+                cwnd = std::max(cwnd, prior_cwnd);
+            }
+            break;
+    }
+}
+
+void BBR::on_rtt_sample(const std::chrono::nanoseconds rtt, const SteadyTime now) {
+    const bool expired = min_rtt_stamp != SteadyTime { } && now - min_rtt_stamp > MinRttWindow;
+    if (rtt <= min_rtt || expired) {
+        min_rtt = rtt;
+        min_rtt_stamp = now;
+    }
+    if (expired && mode != Mode::ProbeRTT) {
+        prior_cwnd = cwnd;
+        mode = Mode::ProbeRTT;
+        mode_stamp = now + ProbeRttDuration;
+        cwnd = std::min(cwnd, MinWindowSegments * mss);
+    }
+}
+
+void BBR::on_loss(const uint32_t in_flight, SteadyTime) {
+    // Probing the round-trip time saved the window already
+    if (mode != Mode::ProbeRTT) prior_cwnd = cwnd;
+    cwnd = std::max(in_flight, MinWindowSegments * mss);
+}
+
+void BBR::on_ecn(const uint32_t in_flight, SteadyTime) {
+    const auto reduced = static_cast<uint32_t>(std::min(cwnd, in_flight) * EcnBackoff);
+    cwnd = std::max(reduced, MinWindowSegments * mss);
+}
+
+void BBR::on_timeout(const uint32_t, SteadyTime) {
+    if (mode != Mode::ProbeRTT) prior_cwnd = cwnd;
+    // Grown back from a single segment as the retransmissions are acknowledged, rather than restored
+    //  on the first acknowledgement, which would send everything that was in flight again at once
+    cwnd = mss;
+}
+
+}
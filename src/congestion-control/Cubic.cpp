@@ -0,0 +1,65 @@
+#include <cmath>
+#include <algorithm>
+
+#include <tcpp/congestion-control/Cubic.hpp>
+
+namespace tcpp {
+
+Cubic::Cubic(const uint32_t mss_) : mss(mss_), cwnd(initial_window(mss_)) { }
+
+void Cubic::on_ack(const AckEvent& ack) {
+    if (ack.recovering) return;
+    if (cwnd < ssthresh) {
+        // By at most two segments per acknowledgement (RFC 3465 - Section 2.2)
+        cwnd += std::min(ack.acked, 2 * mss);
+        return;
+    }
+
+    const double segments = static_cast<double>(cwnd) / mss;
+    const double acked = static_cast<double>(ack.acked) / mss;
+    if (epoch_start == SteadyTime { }) {
+        // RFC 9438 - Section 4.2. Past W_max (or with none yet), the function starts off flat from the current window.
+        epoch_start = ack.now;
+        if (w_max <= segments) {
+            w_max = segments;
+            k = 0;
+        } else {
+            k = std::cbrt((w_max - segments) / C);
+        }
+        w_est = segments;
+    }
+
+    // The target is where the function is an RTT from now, but no more than half the window away
+    const auto t = std::chrono::duration<double>(ack.now - epoch_start + smoothed_rtt).count();
+    const double target = std::clamp(C * std::pow(t - k, 3) + w_max, segments, 1.5 * segments);
+
+    // RFC 9438 - Section 4.3, the Reno-friendly region
+    constexpr double alpha = 3 * (1 - Beta) / (1 + Beta);
+    w_est += alpha * acked / segments;
+
+    const double next = w_est > target ? w_est : segments + (target - segments) / segments * acked;
+    cwnd = std::max(cwnd, static_cast<uint32_t>(next * mss));
+}
+
+void Cubic::on_rtt_sample(const std::chrono::nanoseconds rtt, SteadyTime) {
+    // RFC 6298 - Section 2
+    smoothed_rtt = smoothed_rtt.count() == 0 ? rtt : (7 * smoothed_rtt + rtt) / 8;
+}
+
+// RFC 9438 - Sections 4.6 and 4.7
+void Cubic::on_loss(const uint32_t, SteadyTime) {
+    const double segments = static_cast<double>(cwnd) / mss;
+    // Fast convergence: a flow whose window keeps shrinking releases bandwidth to the newer ones
+    w_max = segments < w_max ? segments * (1 + Beta) / 2 : segments;
+    ssthresh = std::max(static_cast<uint32_t>(cwnd * Beta), 2 * mss);
+    cwnd = ssthresh;
+    epoch_start = { };
+}
+
+// RFC 9438 - Section 4.8
+void Cubic::on_timeout(const uint32_t in_flight, const SteadyTime now) {
+    on_loss(in_flight, now);
+    cwnd = mss;
+}
+
+}
@@ -0,0 +1,36 @@
+#include <algorithm>
+
+#include <tcpp/congestion-control/NewReno.hpp>
+
+namespace tcpp {
+
+NewReno::NewReno(const uint32_t mss_) : mss(mss_), cwnd(initial_window(mss_)) { }
+
+void NewReno::on_ack(const AckEvent& ack) {
+    if (ack.recovering) return;
+    if (cwnd < ssthresh) {
+        // By at most two segments per acknowledgement (RFC 3465 - Section 2.2)
+        cwnd += std::min(ack.acked, 2 * mss);
+        return;
+    }
+    bytes_acked += ack.acked;
+    if (bytes_acked >= cwnd) {
+        bytes_acked -= cwnd;
+        cwnd += mss;
+    }
+}
+
+// RFC 5681 - Section 3.2, equation (4)
+void NewReno::on_loss(const uint32_t in_flight, SteadyTime) {
+    ssthresh = std::max(in_flight / 2, 2 * mss);
+    cwnd = ssthresh;
+    bytes_acked = 0;
+}
+
+// RFC 5681 - Section 3.1, the loss window
+void NewReno::on_timeout(const uint32_t in_flight, const SteadyTime now) {
+    on_loss(in_flight, now);
+    cwnd = mss;
+}
+
+}
@@ -0,0 +1,60 @@
+#include <bit>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <tcpp/data-structures/ByteRing.hpp>
+#include <tcpp/utils/FileDescriptor.hpp>
+
+namespace tcpp {
+
+static size_t ring_size(const size_t capacity, const bool mirrored) {
+    auto size = std::bit_ceil(std::max<size_t>(capacity, 1));
+    if (mirrored) {
+        // Both the page size and the capacity are powers of two
+        size = std::max(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    }
+    return size;
+}
+
+ByteRing::ByteRing(const size_t capacity_, const bool mirrored_)
+    : ring_capacity(ring_size(capacity_, mirrored_)),
+      mirror(mirrored_),
+      mapping_size(mirrored_ ? 2 * ring_capacity : ring_capacity)
+{
+    if (!mirror) {
+        auto mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("mmap(ring)");
+        }
+        data = static_cast<uint8_t*>(mapping);
+        return;
+    }
+
+    // Reserve a range for both of the views first, then map the same memory over each of its halves
+    FileDescriptor fd { memfd_create("tcpp-ring", MFD_CLOEXEC) };
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(ring_capacity)) != 0) {
+        throw std::runtime_error("memfd_create(ring)");
+    }
+    auto reserved = mmap(nullptr, mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        throw std::runtime_error("mmap(ring reservation)");
+    }
+    auto base = static_cast<uint8_t*>(reserved);
+    for (auto view : { base, base + ring_capacity }) {
+        auto mapping = mmap(view, ring_capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            munmap(reserved, mapping_size);
+            throw std::runtime_error("mmap(ring view)");
+        }
+    }
+    // The mappings keep the memory alive after the descriptor is closed
+    data = base;
+}
+
+ByteRing::~ByteRing() {
+    munmap(data, mapping_size);
+}
+
+}
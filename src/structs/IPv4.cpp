@@ -51,6 +51,16 @@ void IPv4::compute_and_set_ip_tcp_checksums() {
     compute_and_set_checksum();
 }
 
+void IPv4::compute_and_set_tcp_partial_checksum() {
+    auto& tcp = tcp_payload();
+    Checksum16BE checksum;
+    checksum.add_be(source_addr_n)
+        .add_be(dest_addr_n)
+        .add(protocol)
+        .add(static_cast<uint16_t>(payload_size()));
+    tcp.checksum_n = checksum.get_partial();
+}
+
 void IPv4::compute_and_set_ip_udp_checksums() {
     compute_and_set_udp_checksum();
     compute_and_set_checksum();
@@ -26,13 +26,20 @@ Checksum16BE& Checksum16BE::add_be(const uint32_t x) {
     return add_be(static_cast<uint16_t>(x >> 16)).add_be(static_cast<uint16_t>(x & 0xFFFF));
 }
 
-uint16_t Checksum16BE::get() const {
+static uint16_t fold(const uint32_t sum) {
     // End-around carry will happen at most twice
-    uint16_t result = (sum & 0xFFFF) + (sum >> 16);
+    uint32_t result = (sum & 0xFFFF) + (sum >> 16);
     result = (result & 0xFFFF) + (result >> 16);
+    return static_cast<uint16_t>(result);
+}
 
+uint16_t Checksum16BE::get() const {
     // Take one's complement then reverse back to big-endian
-    return reverse_bytes(~result);
+    return reverse_bytes(static_cast<uint16_t>(~fold(sum)));
+}
+
+uint16_t Checksum16BE::get_partial() const {
+    return reverse_bytes(fold(sum));
 }
 
 Checksum16BE checksum16_be(const uint16_t* data, const size_t size, uint16_t initial_value) {
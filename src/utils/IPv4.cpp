@@ -60,18 +60,17 @@ std::string network_ip_to_string(uint32_t ip) {
     return result;
 }
 
-IpAddress string_to_network_ip(const char* ip) {
+IpAddress string_to_network_ip(const std::string& ip) {
     in_addr ip_addr;
 
-    if (inet_pton(AF_INET, ip, &ip_addr) != 1)
+    if (inet_pton(AF_INET, ip.c_str(), &ip_addr) != 1)
         throw std::invalid_argument("Invalid IP address");
 
     return ip_addr.s_addr;
 }
 
 IpAddress operator""_nip(const char* ip, size_t size) {
-    (void)size;
-    return string_to_network_ip(ip);
+    return string_to_network_ip(std::string(ip, size));
 }
 
 }
\ No newline at end of file
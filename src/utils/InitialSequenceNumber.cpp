@@ -0,0 +1,58 @@
+#include <array>
+#include <chrono>
+#include <random>
+
+#include <tcpp/utils/InitialSequenceNumber.hpp>
+
+namespace tcpp {
+
+static uint64_t rotate_left(const uint64_t x, const int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+static void sip_round(std::array<uint64_t, 4>& v) {
+    v[0] += v[1]; v[1] = rotate_left(v[1], 13); v[1] ^= v[0]; v[0] = rotate_left(v[0], 32);
+    v[2] += v[3]; v[3] = rotate_left(v[3], 16); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = rotate_left(v[3], 21); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = rotate_left(v[1], 17); v[1] ^= v[2]; v[2] = rotate_left(v[2], 32);
+}
+
+// SipHash-2-4 of the 12 bytes of the id, taken as a 64-bit and a 32-bit word
+static uint64_t sip_hash(const std::array<uint64_t, 2>& key, const ConnectionID& id) {
+    std::array<uint64_t, 4> v {
+        key[0] ^ 0x736f6d6570736575ULL,
+        key[1] ^ 0x646f72616e646f6dULL,
+        key[0] ^ 0x6c7967656e657261ULL,
+        key[1] ^ 0x7465646279746573ULL,
+    };
+    const std::array<uint64_t, 2> words {
+        static_cast<uint64_t>(id.source_ip) << 32 | id.dest_ip,
+        // The last word carries the length of the message in its top byte
+        12ULL << 56 | static_cast<uint64_t>(id.source_port) << 16 | id.dest_port,
+    };
+    for (auto word : words) {
+        v[3] ^= word;
+        sip_round(v);
+        sip_round(v);
+        v[0] ^= word;
+    }
+    v[2] ^= 0xFF;
+    for (int i = 0; i < 4; i++) sip_round(v);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+static std::array<uint64_t, 2> draw_secret() {
+    std::random_device device;
+    std::array<uint64_t, 2> secret { };
+    for (auto& word : secret) {
+        word = static_cast<uint64_t>(device()) << 32 | device();
+    }
+    return secret;
+}
+
+uint32_t initial_sequence_number(const ConnectionID& id) {
+    static const auto secret = draw_secret();
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const auto ticks = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count() / 4);
+    return ticks + static_cast<uint32_t>(sip_hash(secret, id));
+}
+
+}
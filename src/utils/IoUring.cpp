@@ -0,0 +1,170 @@
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <tcpp/utils/IoUring.hpp>
+
+namespace tcpp {
+
+static int io_uring_setup(const unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete,
+                          const unsigned flags, const void* arg, const size_t arg_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+static int io_uring_register(const int fd, const unsigned opcode, const void* arg, const unsigned args_count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, args_count));
+}
+
+static unsigned load_acquire(const unsigned* p) {
+    return std::atomic_ref(*const_cast<unsigned*>(p)).load(std::memory_order::acquire);
+}
+
+static void store_release(unsigned* p, const unsigned value) {
+    std::atomic_ref(*p).store(value, std::memory_order::release);
+}
+
+IoUring::IoUring(const unsigned entries) {
+    fd = io_uring_setup(entries, &params);
+    if (fd < 0) throw std::runtime_error("io_uring_setup failed");
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        // Needed to wait for completions with a timeout
+        throw std::runtime_error("io_uring is not recent enough (no IORING_FEAT_EXT_ARG)");
+    }
+    map_rings();
+}
+
+void IoUring::map_rings() {
+    // The rings are mapped separately, which works whether
+    //  the kernel supports IORING_FEAT_SINGLE_MMAP or not
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) throw std::runtime_error("Mapping the io_uring submission queue failed");
+
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) throw std::runtime_error("Mapping the io_uring completion queue failed");
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) throw std::runtime_error("Mapping the io_uring submission entries failed");
+    sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+    auto sq = static_cast<uint8_t*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto cq = static_cast<uint8_t*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    if (sqes) munmap(sqes, sqes_size);
+    if (cq_ring && cq_ring != MAP_FAILED) munmap(cq_ring, cq_ring_size);
+    if (sq_ring && sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    const auto tail = *sq_tail + pending;
+    if (tail - load_acquire(sq_head) >= sq_entries) return nullptr;
+    const auto index = tail & sq_mask;
+    auto sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    pending++;
+    return sqe;
+}
+
+int IoUring::submit(const unsigned min_complete, const std::chrono::milliseconds timeout) {
+    const auto to_submit = pending;
+    if (to_submit > 0) {
+        // Publish the entries to the kernel
+        store_release(sq_tail, *sq_tail + to_submit);
+        pending = 0;
+    }
+    if (to_submit == 0 && min_complete == 0) return 0;
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg { };
+    __kernel_timespec ts { };
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout != std::chrono::milliseconds::max()) {
+            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+            ts.tv_sec = seconds.count();
+            ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count();
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+    }
+
+    int result;
+    do {
+        result = flags & IORING_ENTER_EXT_ARG ?
+            io_uring_enter(fd, to_submit, min_complete, flags, &arg, sizeof(arg)) :
+            io_uring_enter(fd, to_submit, min_complete, flags, nullptr, _NSIG / 8);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        // Timing out while waiting isn't an error for the caller
+        return errno == ETIME ? static_cast<int>(to_submit) : -errno;
+    }
+    return result;
+}
+
+io_uring_cqe* IoUring::peek_cqe() const {
+    const auto head = *cq_head;
+    if (head == load_acquire(cq_tail)) return nullptr;
+    return &cqes[head & cq_mask];
+}
+
+void IoUring::advance(const unsigned count) {
+    store_release(cq_head, *cq_head + count);
+}
+
+bool IoUring::register_buffers(const std::span<const iovec> buffers) {
+    if (io_uring_register(fd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) < 0)
+        return false;
+    registered.assign(buffers.begin(), buffers.end());
+    return true;
+}
+
+bool IoUring::update_buffers(const std::span<const iovec> buffers) {
+    if (buffers.size() > registered.size()) return false;
+    io_uring_rsrc_update2 update { };
+    update.offset = 0;
+    update.data = reinterpret_cast<uint64_t>(buffers.data());
+    update.nr = static_cast<uint32_t>(buffers.size());
+    if (io_uring_register(fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) < 0)
+        return false;
+    std::copy(buffers.begin(), buffers.end(), registered.begin());
+    return true;
+}
+
+int IoUring::buffer_index(const void* data, const size_t size) const {
+    const auto begin = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < registered.size(); i++) {
+        const auto buffer = static_cast<const uint8_t*>(registered[i].iov_base);
+        if (begin >= buffer && begin + size <= buffer + registered[i].iov_len)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+}
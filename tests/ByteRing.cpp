@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <thread>
+#include <vector>
+#include <numeric>
+
+#include <tcpp/data-structures/ByteRing.hpp>
+
+static std::vector<uint8_t> sequence(size_t count, uint8_t start = 0) {
+    std::vector<uint8_t> bytes(count);
+    std::iota(bytes.begin(), bytes.end(), start);
+    return bytes;
+}
+
+TEST(byte_ring, WrapsAround) {
+    tcpp::ByteRing ring(16);
+    ASSERT_EQ(ring.capacity(), 16);
+    std::array<uint8_t, 16> out { };
+
+    ASSERT_EQ(ring.write(sequence(12)), 12);
+    ASSERT_EQ(ring.read({ out.data(), 10 }), 10);
+    // Crosses the end of the ring, and only 14 bytes fit
+    auto bytes = sequence(16, 12);
+    ASSERT_EQ(ring.write(bytes), 14);
+
+    auto regions = ring.readable_regions();
+    ASSERT_EQ(regions[0].size(), 6);
+    ASSERT_EQ(regions[1].size(), 10);
+    ASSERT_EQ(regions[0][0], 10);
+    ASSERT_EQ(regions[1][0], 16);
+
+    ASSERT_EQ(ring.read(out), 16);
+    ASSERT_EQ(std::vector<uint8_t>(out.begin(), out.end()), sequence(16, 10));
+    ASSERT_TRUE(ring.empty());
+}
+
+TEST(byte_ring, MirroredRegionsAreContiguous) {
+    tcpp::ByteRing ring(1, true);
+    ASSERT_TRUE(ring.mirrored());
+    const auto capacity = ring.capacity();
+    ASSERT_GE(capacity, 4096);
+
+    ASSERT_EQ(ring.write(sequence(capacity - 8)), capacity - 8);
+    ring.consume(capacity - 8);
+    ASSERT_EQ(ring.write(sequence(32, 7)), 32);
+
+    auto regions = ring.readable_regions();
+    ASSERT_EQ(regions[0].size(), 32);
+    ASSERT_TRUE(regions[1].empty());
+    ASSERT_EQ(std::vector<uint8_t>(regions[0].begin(), regions[0].end()), sequence(32, 7));
+
+    // Written in place across the end of the ring as well
+    auto region = ring.writable_region();
+    ASSERT_EQ(region.size(), capacity - 32);
+    region[0] = 1;
+    ring.commit_write(1);
+    ring.consume(32);
+    ASSERT_EQ(ring.readable_regions()[0][0], 1);
+}
+
+TEST(byte_ring, StreamsBetweenThreads) {
+    constexpr size_t total = 1 << 20;
+    tcpp::ByteRing ring(1 << 12);
+    std::jthread producer([&] {
+        size_t written = 0;
+        std::array<uint8_t, 1000> chunk { };
+        while (written < total) {
+            auto count = std::min(chunk.size(), total - written);
+            for (size_t i = 0; i < count; i++) chunk[i] = static_cast<uint8_t>((written + i) % 251);
+            size_t done = 0;
+            while (done < count) done += ring.write({ chunk.data() + done, count - done });
+            written += count;
+        }
+    });
+    size_t read = 0;
+    std::array<uint8_t, 777> buffer { };
+    while (read < total) {
+        auto count = ring.read(buffer);
+        for (size_t i = 0; i < count; i++) ASSERT_EQ(buffer[i], (read + i) % 251);
+        read += count;
+    }
+}
@@ -182,3 +182,16 @@ TEST(checksum, OddSizeTCPHeaderChecksum) {
     ip.compute_and_set_tcp_checksum();
     ASSERT_EQ(tcp.checksum(), 0xc9b3);
 }
+
+TEST(checksum, TCPPartialChecksum) {
+    // Completing the partial checksum the way a checksum offload does should result in the full checksum
+    std::array<uint8_t, sizeof(odd_size_tcp_packet)> packet { };
+    std::copy_n(odd_size_tcp_packet, packet.size(), packet.data());
+    auto& ip = tcpp::structs::IPv4::from_ptr(packet.data());
+    auto& tcp = ip.tcp_payload();
+    ip.compute_and_set_tcp_partial_checksum();
+    auto segment = reinterpret_cast<const uint8_t*>(&tcp);
+    tcp.checksum_n = tcpp::checksum16_be(segment, ip.payload_size());
+    ASSERT_EQ(tcp.checksum(), 0xc9b3);
+    ASSERT_TRUE(ip.has_valid_tcp_checksum());
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include <tcpp/congestion-control/NewReno.hpp>
+#include <tcpp/congestion-control/Cubic.hpp>
+#include <tcpp/congestion-control/BBR.hpp>
+
+using namespace std::chrono_literals;
+
+constexpr uint32_t MSS = 1000;
+
+// A window's worth of acknowledgements, a segment each, spread over a round trip
+template <tcpp::CongestionControl Controller>
+static void ack_window(Controller& controller, tcpp::SteadyTime& now, const std::chrono::nanoseconds rtt, const bool recovering = false) {
+    const auto window = controller.window();
+    const auto segments = std::max(window / MSS, 1u);
+    for (uint32_t i = 0; i < segments; i++) {
+        now += rtt / segments;
+        controller.on_rtt_sample(rtt, now);
+        controller.on_ack({ MSS, window - i * MSS, recovering, now });
+    }
+}
+
+TEST(congestion_control, NewRenoHalvesOnLossAndGrowsBySegments) {
+    tcpp::NewReno reno { MSS };
+    tcpp::SteadyTime now { };
+    ASSERT_EQ(reno.window(), 10 * MSS);
+    // Slow start doubles the window each round trip
+    ack_window(reno, now, 10ms);
+    ASSERT_EQ(reno.window(), 20 * MSS);
+
+    reno.on_loss(reno.window(), now);
+    ASSERT_EQ(reno.window(), 10 * MSS);
+    // Nothing grows while recovering, and a segment per window afterward
+    ack_window(reno, now, 10ms, true);
+    ASSERT_EQ(reno.window(), 10 * MSS);
+    ack_window(reno, now, 10ms);
+    ASSERT_EQ(reno.window(), 11 * MSS);
+
+    reno.on_timeout(reno.window(), now);
+    ASSERT_EQ(reno.window(), MSS);
+}
+
+TEST(congestion_control, CubicBacksOffByBetaAndReturnsToTheLastMaximum) {
+    tcpp::Cubic cubic { MSS };
+    tcpp::SteadyTime now { };
+    for (int i = 0; i < 3; i++) ack_window(cubic, now, 100ms);
+    const auto maximum = cubic.window();
+
+    cubic.on_loss(maximum, now);
+    ASSERT_EQ(cubic.window(), static_cast<uint32_t>(maximum * 0.7));
+    // K is about 4 seconds for a maximum of 80 segments. The window is back around it by then, and grows past it after.
+    const auto loss = now;
+    while (now < loss + 4s) ack_window(cubic, now, 100ms);
+    ASSERT_GT(cubic.window(), maximum * 0.9);
+    ASSERT_LT(cubic.window(), maximum * 1.1);
+    while (now < loss + 10s) ack_window(cubic, now, 100ms);
+    ASSERT_GT(cubic.window(), maximum * 1.5);
+}
+
+TEST(congestion_control, BBRSettlesAroundTheBandwidthDelayProduct) {
+    tcpp::BBR bbr { MSS };
+    tcpp::SteadyTime now { };
+    // A bottleneck of 10MB/s, with a round-trip time of 10ms and a deep queue, which the window beyond the
+    //  bandwidth-delay product of 100KB fills up, and so delays the acknowledgements further
+    constexpr double bandwidth = 10e6;
+    constexpr uint32_t bdp = 100'000;
+    for (int round = 0; round < 200; round++) {
+        const auto window = bbr.window();
+        const auto queued = std::max<int64_t>(int64_t { window } - bdp, 0);
+        const auto queueing = std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(queued) / bandwidth * 1e9));
+        ack_window(bbr, now, 10ms + queueing);
+    }
+    // Twice the product, with the gain of the cycle it's at
+    ASSERT_GT(bbr.window(), bdp);
+    ASSERT_LT(bbr.window(), 3 * bdp);
+}
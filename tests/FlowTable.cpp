@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <tcpp/utils/Connections.hpp>
+#include <tcpp/data-structures/FlowTable.hpp>
+
+static tcpp::ConnectionID flow(uint32_t i) {
+    return { 0x0A000002 + (i >> 16), 0x0A000001, static_cast<tcpp::Port>(i), 4000 };
+}
+
+TEST(flow_table, InsertFindErase) {
+    tcpp::EpochReclaimer reclaimer(0);
+    tcpp::FlowTable<tcpp::ConnectionID, int> table(reclaimer, 1 << 10);
+    for (uint32_t i = 0; i < 500; i++) {
+        auto [value, inserted] = table.emplace(flow(i), static_cast<int>(i));
+        ASSERT_TRUE(inserted);
+        ASSERT_EQ(*value, static_cast<int>(i));
+    }
+    auto [existing, inserted] = table.emplace(flow(7), -1);
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(*existing, 7);
+    ASSERT_EQ(table.size(), 500);
+
+    for (uint32_t i = 0; i < 500; i += 2) ASSERT_TRUE(table.erase(flow(i)));
+    ASSERT_FALSE(table.erase(flow(0)));
+    for (uint32_t i = 0; i < 500; i++) {
+        auto value = table.find(flow(i));
+        if (i % 2 == 0) ASSERT_EQ(value, nullptr);
+        else ASSERT_EQ(*value, static_cast<int>(i));
+    }
+    // The erased slots are reused
+    for (uint32_t i = 1000; i < 1250; i++) ASSERT_TRUE(table.emplace(flow(i), 0).second);
+    ASSERT_EQ(table.size(), 500);
+}
+
+TEST(flow_table, ProbesStayShortUnderChurn) {
+    tcpp::EpochReclaimer reclaimer(0);
+    tcpp::FlowTable<tcpp::ConnectionID, int> table(reclaimer, 1 << 12);
+    // Half full all along, while the flows come and go many times over the capacity
+    constexpr uint32_t live = 2048;
+    for (uint32_t i = 0; i < 200'000; i++) {
+        ASSERT_TRUE(table.emplace(flow(i), 0).second);
+        if (i >= live) {
+            ASSERT_TRUE(table.erase(flow(i - live)));
+        }
+    }
+    ASSERT_EQ(table.size(), live);
+
+    // The deleted slots are cleared out along the way, so the misses stop about as early as in a fresh table
+    size_t longest = 0;
+    size_t total = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        const auto length = table.probe_length(flow(1'000'000 + i));
+        longest = std::max(longest, length);
+        total += length;
+    }
+    ASSERT_LE(longest, 4);
+    ASSERT_LE(total, 1500);
+}
+
+TEST(flow_table, RefusesOnceFullOrReadOnly) {
+    tcpp::EpochReclaimer reclaimer(0);
+    tcpp::FlowTable<tcpp::ConnectionID, int> table(reclaimer, 64);
+    const auto capacity = static_cast<uint32_t>(table.capacity());
+    ASSERT_EQ(capacity, 56);
+    for (uint32_t i = 0; i < capacity; i++) ASSERT_TRUE(table.emplace(flow(i), 0).second);
+    ASSERT_EQ(table.emplace(flow(capacity), 0).first, nullptr);
+    ASSERT_TRUE(table.contains(flow(0)));
+
+    table.set_read_only();
+    ASSERT_FALSE(table.erase(flow(0)));
+    size_t visited = 0;
+    table.for_each([&](const tcpp::ConnectionID&, int&) { visited++; });
+    ASSERT_EQ(visited, capacity);
+}
+
+TEST(flow_table, ConcurrentInsertsAndLookups) {
+    constexpr uint32_t writers = 4;
+    constexpr uint32_t count = 5'000;
+    tcpp::EpochReclaimer reclaimer(0);
+    tcpp::FlowTable<tcpp::ConnectionID, uint32_t> table(reclaimer, 1 << 15);
+
+    std::atomic<bool> done = false;
+    std::jthread reader([&] {
+        // Whatever is found must be complete
+        while (!done) {
+            for (uint32_t i = 0; i < writers * count; i += 97) {
+                if (auto value = table.find(flow(i)); value != nullptr) {
+                    ASSERT_EQ(*value, i);
+                }
+            }
+        }
+    });
+    {
+        std::vector<std::jthread> threads;
+        for (uint32_t w = 0; w < writers; w++) {
+            threads.emplace_back([&table, w] {
+                // Each of the flows is inserted by two of the writers, only one of which succeeds
+                for (uint32_t i = 0; i < 2 * count; i++) {
+                    auto id = (w * count + i) % (writers * count);
+                    auto [value, inserted] = table.emplace(flow(id), id);
+                    ASSERT_NE(value, nullptr);
+                    ASSERT_EQ(*value, id);
+                }
+            });
+        }
+    }
+    done = true;
+    ASSERT_EQ(table.size(), writers * count);
+    for (uint32_t i = 0; i < writers * count; i++) ASSERT_EQ(*table.find(flow(i)), i);
+}
+
+TEST(flow_table, LookupsGoOnAcrossRebuilds) {
+    tcpp::EpochReclaimer reclaimer(1);
+    tcpp::FlowTable<tcpp::ConnectionID, uint32_t> table(reclaimer, 1 << 10);
+    // These are never erased, so they're found in whichever groups the lookups start in
+    constexpr uint32_t kept = 256;
+    for (uint32_t i = 0; i < kept; i++) ASSERT_TRUE(table.emplace(flow(i), i).second);
+
+    std::atomic<bool> done = false;
+    std::jthread reader([&] {
+        while (!done) {
+            auto guard = reclaimer.pin(0);
+            for (uint32_t i = 0; i < kept; i++) {
+                auto value = table.find(flow(i));
+                ASSERT_NE(value, nullptr);
+                ASSERT_EQ(*value, i);
+            }
+        }
+    });
+    for (uint32_t i = kept; i < 100'000; i++) {
+        ASSERT_TRUE(table.emplace(flow(i), i).second);
+        ASSERT_TRUE(table.erase(flow(i)));
+    }
+    done = true;
+}
+
+// Counts the instances alive, to tell whether the erased entries are freed
+struct Tracked {
+    static inline size_t alive = 0;
+    explicit Tracked(const uint32_t value_) : value(value_) { alive++; }
+    Tracked(const Tracked&) = delete;
+    ~Tracked() { alive--; }
+    uint32_t value;
+};
+
+TEST(flow_table, MemoryAndLookupsStayFlatUnderChurn) {
+    tcpp::EpochReclaimer reclaimer(1);
+    {
+        tcpp::FlowTable<tcpp::ConnectionID, Tracked> table(reclaimer, 1 << 12);
+        constexpr uint32_t live = 1024;
+        for (uint32_t i = 0; i < live; i++) ASSERT_TRUE(table.emplace(flow(i), i).second);
+        const auto probes = [&] {
+            size_t total = 0;
+            for (uint32_t i = 0; i < live; i++) total += table.probe_length(flow(1'000'000 + i));
+            return total;
+        };
+        const auto fresh_probes = probes();
+
+        // The way a handler goes about it: the connection is looked up while pinned, and is released afterwards
+        for (uint32_t i = live; i < 100'000; i++) {
+            {
+                auto guard = reclaimer.pin(0);
+                ASSERT_EQ(table.find(flow(i - live))->value, i - live);
+            }
+            ASSERT_TRUE(table.erase(flow(i - live)));
+            ASSERT_TRUE(table.emplace(flow(i), i).second);
+
+            // Only the last few erased entries, and maybe some old groups, are waiting to be freed
+            ASSERT_LE(reclaimer.pending_count(), 4);
+            ASSERT_LE(Tracked::alive, live + 4);
+        }
+        ASSERT_LE(probes(), fresh_probes * 2);
+    }
+    for (int i = 0; i < 4; i++) reclaimer.collect();
+    ASSERT_EQ(Tracked::alive, 0);
+}
@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tcpp/TCPInterface.hpp>
+#include <tcpp/LoopbackDevice.hpp>
+#include <tcpp/utils/IPv4.hpp>
+
+using tcpp::operator ""_nip;
+using namespace std::chrono_literals;
+
+using LoopbackInterface = tcpp::TCPInterface<1 << 10, tcpp::LoopbackDevice>;
+
+TEST(loopback, PacketsCrossOver) {
+    tcpp::LoopbackPair pair;
+    tcpp::PacketAllocator allocator;
+    auto buffer = allocator.allocate();
+    std::span<uint8_t> packet { buffer, 20 };
+    pair.first.send_packets({ &packet, 1 });
+    auto received = pair.second.receive_packet();
+    ASSERT_EQ(received.data.data(), buffer);
+    ASSERT_EQ(received.data.size(), 20);
+    ASSERT_TRUE(received.checksum_valid);
+    allocator.deallocate(buffer);
+
+    pair.second.close();
+    ASSERT_TRUE(pair.second.receive_packet().data.empty());
+}
+
+TEST(loopback, ReceiverParksUntilWokenUp) {
+    tcpp::LoopbackPair pair;
+    tcpp::PacketAllocator allocator;
+    auto buffer = allocator.allocate();
+    std::atomic<bool> received = false;
+    std::jthread receiver([&] {
+        // Parked until the packet is sent, then until the device is closed
+        auto packet = pair.second.receive_packet();
+        EXPECT_EQ(packet.data.data(), buffer);
+        received = true;
+        EXPECT_TRUE(pair.second.receive_packet().data.empty());
+    });
+    std::this_thread::sleep_for(10ms);
+    ASSERT_FALSE(received);
+    std::span<uint8_t> packet { buffer, 20 };
+    pair.first.send_packets({ &packet, 1 });
+    received.wait(false);
+    pair.second.close();
+    receiver.join();
+    allocator.deallocate(buffer);
+}
+
+TEST(loopback, TwoInterfaces) {
+    tcpp::LoopbackPair pair;
+    LoopbackInterface server { std::move(pair.first) };
+    LoopbackInterface client { std::move(pair.second) };
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+    std::atomic<tcpp::TCPConnection<1 << 10>*> accepted = nullptr;
+    std::jthread acceptor([&] {
+        // The server greets the connection, then closes its side
+        accepted = &listener.accept();
+        accepted.load()->connection_established.wait(false);
+        accepted.load()->write("Hello World!\n");
+        accepted.load()->close();
+    });
+    // Whether or not accept() is called by then, the connection is handshaked and waits in the backlog
+    auto& connection = client.connect({ "10.0.0.2"_nip, 50000 }, server_endpoint);
+    connection.connection_established.wait(false);
+
+    std::string received;
+    std::array<uint8_t, 64> buffer { };
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (received.size() < 13 && std::chrono::steady_clock::now() < deadline) {
+        auto n = connection.read(buffer);
+        received.append(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(n));
+    }
+    ASSERT_EQ(received, "Hello World!\n");
+
+    // Both sides are closed before the interfaces are destroyed, so that
+    //  none of the segments of the closing handshake are left unsent.
+    // The connections are released and freed meanwhile.
+    connection.peer_closed.wait(false);
+    connection.close();
+    acceptor.join();
+}
+
+TEST(loopback, AcceptsFromTheBacklog) {
+    // The syns of different connections are received on different queues, by different listener threads
+    tcpp::LoopbackPair pair(2);
+    LoopbackInterface server { std::move(pair.first) };
+    LoopbackInterface client { std::move(pair.second) };
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+
+    // All of them connect before anything is accepted
+    constexpr uint16_t count = 8;
+    std::vector<tcpp::TCPConnection<1 << 10>*> connected;
+    for (uint16_t i = 0; i < count; i++) {
+        connected.push_back(&client.connect({ "10.0.0.2"_nip, static_cast<uint16_t>(50000 + i) }, server_endpoint));
+    }
+    for (auto connection : connected) connection->connection_established.wait(false);
+
+    std::set<uint16_t> accepted_ports;
+    std::vector<std::jthread> closers;
+    for (uint16_t i = 0; i < count; i++) {
+        auto& connection = listener.accept();
+        accepted_ports.insert(connection.id.source_port);
+        closers.emplace_back([&connection] { connection.close(); });
+    }
+    ASSERT_EQ(accepted_ports.size(), count);
+    for (auto connection : connected) connection->close();
+}
+
+TEST(loopback, ClosingAListenerClosesItsBacklog) {
+    tcpp::LoopbackPair pair;
+    LoopbackInterface server { std::move(pair.first) };
+    LoopbackInterface client { std::move(pair.second) };
+
+    // Woken up by the close, with no connection to accept
+    auto& idle = server.bind({ "10.0.0.1"_nip, 4001 });
+    std::jthread acceptor([&] { EXPECT_THROW((void)idle.accept(), std::runtime_error); });
+    std::this_thread::sleep_for(10ms);
+    idle.close();
+    acceptor.join();
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+    auto& connection = client.connect({ "10.0.0.2"_nip, 50000 }, server_endpoint);
+    connection.connection_established.wait(false);
+
+    // The connection never accepted is closed along with the listener
+    std::jthread closer([&] { listener.close(); });
+    connection.peer_closed.wait(false);
+    connection.close();
+    closer.join();
+    ASSERT_THROW((void)listener.accept(), std::runtime_error);
+
+    // The endpoint is free to be bound again
+    server.bind(server_endpoint).close();
+}
+
+TEST(loopback, SegmentsWrittenBytes) {
+    tcpp::LoopbackPair pair;
+    LoopbackInterface server { std::move(pair.first) };
+    LoopbackInterface client { std::move(pair.second) };
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+
+    // Many times the receive buffer, so that the window fills up and opens again as the bytes are read
+    std::vector<uint8_t> sent(4 << 20);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i * 7);
+
+    std::vector<uint8_t> received;
+    std::jthread acceptor([&] {
+        auto& connection = listener.accept();
+        std::array<uint8_t, 4096> buffer { };
+        while (!connection.peer_closed || connection.received_regions()[0].size() > 0) {
+            auto n = connection.read(buffer);
+            received.insert(received.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(n));
+            // Falls behind every now and then
+            if (received.size() % (1 << 20) < n) std::this_thread::sleep_for(20ms);
+        }
+        connection.close();
+    });
+
+    auto& connection = client.connect({ "10.0.0.2"_nip, 50000 }, server_endpoint);
+    // Written before the handshake completes, and sent once it does
+    size_t written = 0;
+    while (written < sent.size()) {
+        written += connection.write(std::span { sent }.subspan(written));
+    }
+    connection.close();
+    acceptor.join();
+    ASSERT_EQ(received, sent);
+}
+
+// Drops every n-th packet sent through it, starting with the first one, as a lossy link would
+class LossyDevice {
+public:
+    LossyDevice(tcpp::LoopbackDevice device_, const size_t every_) : device(std::move(device_)), every(every_) { }
+
+    tcpp::ReceivedPacket receive_packet(const size_t queue = 0) { return device.receive_packet(queue); }
+
+    void send_packets(const std::span<const std::span<uint8_t>> packets, const size_t queue = 0) {
+        for (auto packet : packets) {
+            if (sent++ % every == 0) {
+                tcpp::PacketAllocator{}.deallocate(packet.data());
+                continue;
+            }
+            device.send_packets({ &packet, 1 }, queue);
+        }
+    }
+
+    void close() { device.close(); }
+
+    [[nodiscard]] size_t queues_count() const { return device.queues_count(); }
+
+    [[nodiscard]] bool offloads_enabled() const { return device.offloads_enabled(); }
+
+private:
+    tcpp::LoopbackDevice device;
+    size_t every;
+    size_t sent = 0;
+};
+
+TEST(loopback, RetransmitsLostSegments) {
+    using LossyInterface = tcpp::TCPInterface<1 << 10, LossyDevice>;
+    tcpp::LoopbackPair pair;
+    // The syn and the syn-ack are the first to be lost, and each is sent again on a timeout
+    LossyInterface server { LossyDevice { std::move(pair.first), 10 } };
+    LossyInterface client { LossyDevice { std::move(pair.second), 25 } };
+
+    const tcpp::Endpoint server_endpoint { "10.0.0.1"_nip, 4000 };
+    auto& listener = server.bind(server_endpoint);
+
+    std::vector<uint8_t> sent(1 << 20);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i * 13);
+
+    std::vector<uint8_t> received;
+    std::jthread acceptor([&] {
+        auto& connection = listener.accept();
+        std::array<uint8_t, 4096> buffer { };
+        while (!connection.peer_closed || connection.received_regions()[0].size() > 0) {
+            auto n = connection.read(buffer);
+            received.insert(received.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(n));
+        }
+        connection.close();
+    });
+
+    auto& connection = client.connect({ "10.0.0.2"_nip, 50000 }, server_endpoint);
+    size_t written = 0;
+    while (written < sent.size()) {
+        written += connection.write(std::span { sent }.subspan(written));
+    }
+    connection.close();
+    acceptor.join();
+    ASSERT_EQ(received, sent);
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <tcpp/allocators/PacketHandle.hpp>
+
+TEST(packet_handle, SharesTheBufferWithoutCopying) {
+    tcpp::PacketHandle handle { tcpp::PacketAllocator{}.allocate() };
+    handle.get()[0] = 42;
+    ASSERT_TRUE(handle.unique());
+    {
+        auto copy = handle;
+        ASSERT_EQ(copy.get(), handle.get());
+        ASSERT_EQ(handle.use_count(), 2);
+        ASSERT_FALSE(handle.unique());
+    }
+    ASSERT_TRUE(handle.unique());
+
+    // A raw buffer handed over while the handle keeps its own reference
+    auto shared = handle.share();
+    ASSERT_EQ(handle.use_count(), 2);
+    tcpp::PacketAllocator{}.deallocate(shared);
+    ASSERT_EQ(handle.get()[0], 42);
+    ASSERT_TRUE(handle.unique());
+
+    auto moved = std::move(handle);
+    ASSERT_FALSE(handle);
+    ASSERT_EQ(moved.use_count(), 1);
+}
+
+TEST(packet_handle, LastHolderFreesTheBuffer) {
+    tcpp::PacketAllocator allocator;
+    std::vector<tcpp::PacketBuffer> buffers;
+    for (int i = 0; i < 100; i++) {
+        tcpp::PacketHandle handle { allocator.allocate() };
+        buffers.push_back(handle.share());
+    }
+    // Each buffer is freed by whichever thread drops its last reference
+    std::jthread([&] { allocator.deallocate_bulk(buffers); }).join();
+    // Freed, so a buffer handed out again starts with a single reference
+    tcpp::PacketHandle handle { allocator.allocate() };
+    ASSERT_EQ(handle.use_count(), 1);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <stdexcept>
+
+#include <tcpp/PacketSocketDevice.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/utils/IPv4.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+
+using tcpp::operator ""_nip;
+using namespace std::chrono_literals;
+
+// Opening packet sockets needs CAP_NET_RAW, which the tests may run without
+static std::optional<tcpp::PacketSocketDevice> try_build(tcpp::PacketSocketBuilder builder) {
+    try {
+        return builder.build();
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+TEST(packet_socket, RejectsInvalidConfigurations) {
+    ASSERT_THROW(tcpp::PacketSocketBuilder("lo").build(), std::invalid_argument);
+    ASSERT_THROW(tcpp::PacketSocketBuilder("lo").set_ip4("10.77.0.1").set_queues(0).build(), std::invalid_argument);
+    ASSERT_THROW(tcpp::PacketSocketBuilder("lo").set_ip4("10.77.0.1").set_rx_ring(1000, 4).build(), std::invalid_argument);
+    ASSERT_THROW(tcpp::PacketSocketBuilder("lo").set_ip4("10.77.0.1").set_tx_frames(0).build(), std::invalid_argument);
+}
+
+TEST(packet_socket, UnknownInterfaceThrows) {
+    ASSERT_THROW(tcpp::PacketSocketBuilder("tcpp-none0").set_ip4("10.77.0.1").build(), std::runtime_error);
+}
+
+// Two devices on the loopback interface see each other's frames. The first packets are
+//  dropped until the address of the receiver is resolved over ARP, and then they get through.
+TEST(packet_socket, ResolvesANeighbourOverLoopback) {
+    auto first = try_build(tcpp::PacketSocketBuilder("lo").set_ip4("10.77.0.1").set_rx_ring(1 << 16, 4));
+    auto second = try_build(tcpp::PacketSocketBuilder("lo").set_ip4("10.77.0.2").set_rx_ring(1 << 16, 4));
+    if (!first || !second) GTEST_SKIP() << "Packet sockets aren't permitted";
+
+    tcpp::PacketAllocator allocator;
+    // Receives the ARP reply, and only returns once the device is closed
+    auto first_receiver = std::async(std::launch::async, [&] {
+        for (auto packet = first->receive_packet(); !packet.data.empty(); packet = first->receive_packet()) {
+            allocator.deallocate(packet.data.data());
+        }
+    });
+    auto second_receiver = std::async(std::launch::async, [&] { return second->receive_packet(); });
+
+    constexpr uint16_t Size = 28;
+    for (int i = 0; i < 500 && second_receiver.wait_for(10ms) != std::future_status::ready; i++) {
+        auto buffer = allocator.allocate(Size);
+        std::fill_n(buffer, Size, 0);
+        auto& ip = tcpp::structs::IPv4::from_ptr(buffer);
+        ip.version = 4;
+        ip.ihl = 5;
+        ip.set_total_len(Size);
+        ip.ttl = 64;
+        ip.protocol = 253;
+        ip.source_addr_n = "10.77.0.1"_nip;
+        ip.dest_addr_n = "10.77.0.2"_nip;
+        std::span<uint8_t> packet { buffer, Size };
+        first->send_packets({ &packet, 1 });
+    }
+    // Closed first, so that the receivers return even if nothing got through
+    first->close();
+    second->close();
+    first_receiver.get();
+
+    auto received = second_receiver.get();
+    ASSERT_EQ(received.data.size(), Size);
+    auto& ip = tcpp::structs::IPv4::from_ptr(received.data.data());
+    ASSERT_EQ(ip.source_addr_n, "10.77.0.1"_nip);
+    ASSERT_EQ(ip.protocol, 253);
+    allocator.deallocate(received.data.data());
+}
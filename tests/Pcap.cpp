@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <vector>
+#include <cstring>
+#include <fstream>
+
+#include <tcpp/PcapCapture.hpp>
+#include <tcpp/PcapReplayDevice.hpp>
+#include <tcpp/structs/Pcap.hpp>
+#include <tcpp/structs/IPv4.hpp>
+#include <tcpp/structs/TCP.hpp>
+#include <tcpp/allocators/PacketAllocator.hpp>
+
+namespace {
+
+std::vector<uint8_t> ip_packet(const uint16_t size, const uint8_t fill) {
+    std::vector<uint8_t> packet(size, fill);
+    std::fill_n(packet.begin(), sizeof(tcpp::structs::IPv4), 0);
+    auto& ip = tcpp::structs::IPv4::from_ptr(packet.data());
+    ip.version = 4;
+    ip.ihl = sizeof(tcpp::structs::IPv4) / 4;
+    ip.set_total_len(size);
+    ip.protocol = tcpp::structs::IPv4::IPPROTOCOL_UDP;
+    return packet;
+}
+
+}
+
+using namespace std::chrono_literals;
+
+TEST(pcap, CaptureThenReplay) {
+    const auto path = testing::TempDir() + "tcpp_capture.pcap";
+    auto first = ip_packet(60, 0xAB);
+    auto second = ip_packet(1500, 0xCD);
+    // Longer than the snapshot length, so it can't be replayed
+    auto truncated = ip_packet(3000, 0xEF);
+    {
+        tcpp::PcapCapture capture(path);
+        capture.record_received(0, first);
+        capture.record_sent(0, truncated);
+        capture.record_sent(0, second);
+        ASSERT_EQ(capture.dropped_count(), 0);
+    }
+
+    tcpp::PcapReplayDevice device(path);
+    ASSERT_EQ(device.packets_count(), 2);
+    // The received packets are written before the sent ones
+    for (auto& expected : { first, second }) {
+        auto packet = device.receive_packet();
+        ASSERT_EQ(packet.data.size(), expected.size());
+        ASSERT_TRUE(std::equal(packet.data.begin(), packet.data.end(), expected.begin()));
+        tcpp::PacketAllocator{}.deallocate(packet.data.data());
+    }
+    ASSERT_TRUE(device.receive_packet().data.empty());
+    ASSERT_TRUE(device.finished());
+}
+
+TEST(pcap, ChecksumsTheOffloadedSegments) {
+    const auto path = testing::TempDir() + "tcpp_offloaded.pcap";
+    // Handed to the device without a TCP checksum, which the device would fill in
+    auto segment = ip_packet(100, 0x12);
+    auto& ip = tcpp::structs::IPv4::from_ptr(segment.data());
+    ip.protocol = tcpp::structs::IPv4::IPPROTOCOL_TCP;
+    ip.tcp_payload().data_offset = sizeof(tcpp::structs::TCP) / 4;
+    ip.tcp_payload().set_checksum(0);
+    {
+        tcpp::PcapCapture capture(path);
+        capture.record_sent(0, segment, true);
+    }
+
+    auto expected = segment;
+    tcpp::structs::IPv4::from_ptr(expected.data()).compute_and_set_tcp_checksum();
+    ASSERT_NE(expected, segment);
+
+    tcpp::PcapReplayDevice device(path);
+    auto packet = device.receive_packet();
+    ASSERT_TRUE(std::equal(packet.data.begin(), packet.data.end(), expected.begin(), expected.end()));
+    tcpp::PacketAllocator{}.deallocate(packet.data.data());
+}
+
+// The second packet was captured an hour after the first, and closing the device stops the wait
+TEST(pcap, ClosingInterruptsTheRecordedTiming) {
+    const auto path = testing::TempDir() + "tcpp_delayed.pcap";
+    auto packet = ip_packet(60, 0x34);
+    {
+        std::ofstream file(path, std::ios::binary);
+        tcpp::structs::PcapFileHeader header {
+            .magic = tcpp::structs::PcapFileHeader::MAGIC_MICROSECONDS,
+            .version_major = 2,
+            .version_minor = 4,
+            .thiszone = 0,
+            .sigfigs = 0,
+            .snaplen = 65535,
+            .linktype = tcpp::structs::PcapFileHeader::LINKTYPE_RAW,
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const uint32_t seconds : { 0u, 3600u }) {
+            const auto size = static_cast<uint32_t>(packet.size());
+            tcpp::structs::PcapRecordHeader record { seconds, 0, size, size };
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            file.write(reinterpret_cast<const char*>(packet.data()), size);
+        }
+    }
+
+    tcpp::PcapReplayDevice device(path, tcpp::ReplayTiming::Recorded);
+    ASSERT_EQ(device.packets_count(), 2);
+    auto first = device.receive_packet();
+    ASSERT_EQ(first.data.size(), packet.size());
+    tcpp::PacketAllocator{}.deallocate(first.data.data());
+
+    auto second = std::async(std::launch::async, [&] { return device.receive_packet(); });
+    // Closed before asserting, so that a failure doesn't leave the receiver waiting for an hour
+    const auto waiting = second.wait_for(50ms);
+    device.close();
+    ASSERT_EQ(waiting, std::future_status::timeout);
+    ASSERT_EQ(second.wait_for(5s), std::future_status::ready);
+    ASSERT_TRUE(second.get().data.empty());
+    ASSERT_EQ(device.replayed_count(), 1);
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <tcpp/utils/IPv4.hpp>
+#include <tcpp/data-structures/PortDemux.hpp>
+
+using namespace tcpp;
+
+TEST(port_demux, ExactBindingsComeBeforeTheWildcard) {
+    EpochReclaimer reclaimer(1);
+    PortDemux<int> demux(reclaimer);
+    const auto first = "10.0.0.1"_nip;
+    const auto second = "10.0.0.2"_nip;
+
+    ASSERT_EQ(demux.find({ first, 4000 }), nullptr);
+    ASSERT_EQ(*demux.bind({ first, 4000 }, 1), 1);
+    ASSERT_EQ(demux.bind({ first, 4000 }, 2), nullptr);
+    ASSERT_EQ(demux.find({ second, 4000 }), nullptr);
+    ASSERT_EQ(demux.find({ first, 4001 }), nullptr);
+
+    ASSERT_EQ(*demux.bind({ AnyAddress, 4000 }, 3), 3);
+    ASSERT_EQ(*demux.find({ first, 4000 }), 1);
+    ASSERT_EQ(*demux.find({ second, 4000 }), 3);
+
+    {
+        // Unbound values remain valid for the readers that might still hold them
+        auto guard = reclaimer.pin(0);
+        auto value = demux.find({ first, 4000 });
+        ASSERT_TRUE(demux.unbind({ first, 4000 }));
+        ASSERT_FALSE(demux.unbind({ first, 4000 }));
+        for (int i = 0; i < 4; i++) reclaimer.collect();
+        ASSERT_GT(reclaimer.pending_count(), 0);
+        ASSERT_EQ(*value, 1);
+        ASSERT_EQ(*demux.find({ first, 4000 }), 3);
+    }
+    // And are freed once none of them can
+    for (int i = 0; i < 4; i++) reclaimer.collect();
+    ASSERT_EQ(reclaimer.pending_count(), 0);
+
+    ASSERT_TRUE(demux.unbind({ AnyAddress, 4000 }));
+    ASSERT_EQ(demux.find({ second, 4000 }), nullptr);
+    ASSERT_EQ(*demux.bind({ first, 4000 }, 4), 4);
+}
+
+TEST(port_demux, DetachedValuesAreLeftToTheCaller) {
+    EpochReclaimer reclaimer(1);
+    PortDemux<int> demux(reclaimer);
+    const auto address = "10.0.0.1"_nip;
+    auto value = demux.bind({ address, 4000 }, 1);
+
+    auto detached = demux.detach({ address, 4000 });
+    ASSERT_EQ(detached.get(), value);
+    ASSERT_EQ(demux.detach({ address, 4000 }), nullptr);
+    ASSERT_EQ(demux.find({ address, 4000 }), nullptr);
+    // Only the replaced bindings are retired
+    for (int i = 0; i < 4; i++) reclaimer.collect();
+    ASSERT_EQ(reclaimer.pending_count(), 0);
+    ASSERT_EQ(*detached, 1);
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <tcpp/data-structures/MPSCBoundedQueue.hpp>
+#include <tcpp/data-structures/MPMCBoundedQueue.hpp>
+
+TEST(queues, BoundedCapacity) {
+    tcpp::MPSCBoundedQueue<int, 4> queue;
+    for (int i = 0; i < 4; i++) ASSERT_TRUE(queue.push(i));
+    ASSERT_FALSE(queue.push(4));
+    ASSERT_EQ(queue.pop().value(), 0);
+    ASSERT_TRUE(queue.push(4));
+    for (int i = 1; i <= 4; i++) ASSERT_EQ(queue.pop().value(), i);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.pop().has_value());
+}
+
+TEST(queues, MPSCKeepsTheOrderOfEachProducer) {
+    constexpr int producers = 4;
+    constexpr int count = 10'000;
+    tcpp::MPSCBoundedQueue<std::pair<int, int>, 64> queue;
+
+    std::vector<std::jthread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p] {
+            for (int i = 0; i < count; i++) {
+                while (!queue.push(p, i)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::array<int, producers> next { };
+    for (int received = 0; received < producers * count; ) {
+        auto element = queue.pop();
+        if (!element.has_value()) continue;
+        auto [p, i] = element.value();
+        ASSERT_EQ(i, next[p]++);
+        received++;
+    }
+}
+
+TEST(queues, MPMCDeliversEachElementOnce) {
+    constexpr int producers = 4;
+    constexpr int consumers = 4;
+    constexpr int count = 10'000;
+    tcpp::MPMCBoundedQueue<int, 64> queue;
+    std::vector<std::atomic<int>> seen(producers * count);
+    std::atomic<int> received = 0;
+
+    {
+        std::vector<std::jthread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, p] {
+                for (int i = 0; i < count; i++) {
+                    while (!queue.push(p * count + i)) std::this_thread::yield();
+                }
+            });
+        }
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                while (received.load() < producers * count) {
+                    auto element = queue.pop();
+                    if (!element.has_value()) continue;
+                    seen[static_cast<size_t>(element.value())]++;
+                    received++;
+                }
+            });
+        }
+    }
+
+    for (auto& times : seen) ASSERT_EQ(times.load(), 1);
+}
+
+TEST(queues, SPSCBulkWrapsAround) {
+    SPSCBoundedWaitFreeQueue<int, 8> queue;
+    std::array<int, 6> in { 1, 2, 3, 4, 5, 6 };
+    std::array<int, 8> out { };
+    ASSERT_EQ(queue.push_n(in), 6);
+    ASSERT_EQ(queue.pop_n({ out.data(), 4 }), 4);
+    // Only 6 of these fit, and they wrap around the end of the ring
+    std::array<int, 8> more { 7, 8, 9, 10, 11, 12, 13, 14 };
+    ASSERT_EQ(queue.push_n(more), 6);
+    ASSERT_EQ(queue.pop_n(out), 8);
+    ASSERT_EQ(out, (std::array { 5, 6, 7, 8, 9, 10, 11, 12 }));
+    ASSERT_EQ(queue.pop_n(out), 0);
+}
+
+TEST(queues, SPSCRegions) {
+    SPSCBoundedWaitFreeQueue<int, 8> queue;
+    std::array<int, 6> filler { };
+    ASSERT_EQ(queue.push_n(filler), 6);
+    ASSERT_EQ(queue.pop_n(filler), 6);
+
+    // Only the free slots up to the end of the ring are contiguous
+    auto region = queue.push_region();
+    ASSERT_EQ(region.size(), 2);
+    region[0] = 1;
+    region[1] = 2;
+    queue.commit_push(2);
+    region = queue.push_region();
+    ASSERT_EQ(region.size(), 6);
+    region[0] = 3;
+    queue.commit_push(1);
+
+    auto filled = queue.pop_region();
+    ASSERT_EQ(filled.size(), 2);
+    ASSERT_EQ(filled[0], 1);
+    queue.commit_pop(2);
+    filled = queue.pop_region();
+    ASSERT_EQ(filled.size(), 1);
+    ASSERT_EQ(filled[0], 3);
+    queue.commit_pop(1);
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(queues, MPMCBulkPopsDeliverEachElementOnce) {
+    constexpr int producers = 2;
+    constexpr int consumers = 4;
+    constexpr int count = 10'000;
+    tcpp::MPMCBoundedQueue<int, 64> queue;
+    std::vector<std::atomic<int>> seen(producers * count);
+    std::atomic<int> received = 0;
+
+    {
+        std::vector<std::jthread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, p] {
+                for (int i = 0; i < count; i++) {
+                    while (!queue.push(p * count + i)) std::this_thread::yield();
+                }
+            });
+        }
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&] {
+                std::array<int, 7> batch { };
+                while (received.load() < producers * count) {
+                    auto popped = queue.pop_n(batch);
+                    for (size_t i = 0; i < popped; i++) seen[static_cast<size_t>(batch[i])]++;
+                    received += static_cast<int>(popped);
+                }
+            });
+        }
+    }
+
+    for (auto& times : seen) ASSERT_EQ(times.load(), 1);
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include <tcpp/data-structures/ReassemblyQueue.hpp>
+
+static std::vector<std::pair<uint32_t, uint32_t>> ranges_of(const tcpp::ReassemblyQueue& queue, const uint32_t recent = 0) {
+    std::array<tcpp::ReassemblyQueue::Range, 8> ranges { };
+    std::vector<std::pair<uint32_t, uint32_t>> result;
+    for (auto [begin, end] : std::span { ranges }.first(queue.ranges(ranges, recent))) result.emplace_back(begin, end);
+    return result;
+}
+
+static bool insert(tcpp::ReassemblyQueue& queue, const uint32_t seq, const size_t length, const bool fin = false) {
+    auto packet = tcpp::PacketAllocator{}.allocate();
+    for (size_t i = 0; i < length; i++) packet[40 + i] = static_cast<uint8_t>(seq + i);
+    if (queue.insert(packet, 40, seq, length, fin)) return true;
+    tcpp::PacketAllocator{}.deallocate(packet);
+    return false;
+}
+
+TEST(reassembly_queue, TrimsTheOverlaps) {
+    tcpp::ReassemblyQueue queue;
+    ASSERT_TRUE(insert(queue, 100, 10));
+    ASSERT_TRUE(insert(queue, 120, 10));
+    // Nothing new
+    ASSERT_FALSE(insert(queue, 102, 5));
+    // Overlaps both ends, and only fills the hole in between
+    ASSERT_TRUE(insert(queue, 105, 20));
+    ASSERT_EQ(queue.size(), 3);
+    ASSERT_EQ(ranges_of(queue), (std::vector<std::pair<uint32_t, uint32_t>> { { 100, 130 } }));
+
+    // The payloads are contiguous, and each byte is where its sequence number says
+    uint32_t seq = 100;
+    while (auto segment = queue.front()) {
+        ASSERT_EQ(segment->seq, seq);
+        for (auto byte : segment->payload()) ASSERT_EQ(byte, static_cast<uint8_t>(seq++));
+        queue.pop_front();
+    }
+    ASSERT_EQ(seq, 130);
+}
+
+TEST(reassembly_queue, ReplacesTheCoveredSegments) {
+    tcpp::ReassemblyQueue queue;
+    ASSERT_TRUE(insert(queue, 110, 5));
+    ASSERT_TRUE(insert(queue, 120, 5));
+    ASSERT_TRUE(insert(queue, 140, 5, true));
+    ASSERT_TRUE(insert(queue, 100, 30));
+    ASSERT_EQ(queue.size(), 2);
+    // The fin takes a sequence number of its own, and nothing is taken past it
+    ASSERT_EQ(ranges_of(queue), (std::vector<std::pair<uint32_t, uint32_t>> { { 100, 130 }, { 140, 146 } }));
+    ASSERT_FALSE(insert(queue, 144, 10));
+    ASSERT_FALSE(insert(queue, 146, 10));
+    ASSERT_FALSE(insert(queue, 150, 10));
+    ASSERT_EQ(queue.size(), 2);
+}
+
+TEST(reassembly_queue, GivesUpTheFurthestSegmentsFirst) {
+    tcpp::ReassemblyQueue queue { 2 };
+    ASSERT_TRUE(insert(queue, 200, 10));
+    ASSERT_TRUE(insert(queue, 300, 10));
+    ASSERT_FALSE(insert(queue, 400, 10));
+    ASSERT_TRUE(insert(queue, 100, 10));
+    ASSERT_EQ(ranges_of(queue), (std::vector<std::pair<uint32_t, uint32_t>> { { 100, 110 }, { 200, 210 } }));
+}
+
+TEST(reassembly_queue, WrapsAroundTheSequenceSpace) {
+    tcpp::ReassemblyQueue queue;
+    ASSERT_TRUE(insert(queue, 0xFFFFFFFA, 10));
+    ASSERT_TRUE(insert(queue, 0xFFFFFFF0, 12));
+    ASSERT_EQ(queue.front()->seq, 0xFFFFFFF0);
+    ASSERT_EQ(ranges_of(queue, 0xFFFFFFF0), (std::vector<std::pair<uint32_t, uint32_t>> { { 0xFFFFFFF0, 4 } }));
+}
+
+TEST(reassembly_queue, PutsTheRecentRangeFirst) {
+    tcpp::ReassemblyQueue queue;
+    ASSERT_TRUE(insert(queue, 100, 10));
+    ASSERT_TRUE(insert(queue, 200, 10));
+    ASSERT_TRUE(insert(queue, 300, 10));
+    ASSERT_TRUE(insert(queue, 210, 10));
+    ASSERT_EQ(ranges_of(queue, 210), (std::vector<std::pair<uint32_t, uint32_t>> { { 200, 220 }, { 100, 110 }, { 300, 310 } }));
+}
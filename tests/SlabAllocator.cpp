@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+#include <tcpp/allocators/PacketAllocator.hpp>
+#include <tcpp/allocators/ReusableSlabAllocator.hpp>
+
+// Instantiations of their own, so that the slabs used by the rest of the tests don't interfere
+using SmallAllocator = tcpp::ReusableSlabSingletonAllocator<uint8_t, 64, 256>;
+using TinyAllocator = tcpp::ReusableSlabSingletonAllocator<uint64_t, 1, 8>;
+
+TEST(slab_allocator, HandsOutDistinctSlabs) {
+    SmallAllocator allocator;
+    std::set<uint8_t*> slabs;
+    for (int i = 0; i < 256; i++) {
+        auto slab = allocator.allocate();
+        ASSERT_TRUE(slabs.insert(slab).second);
+        auto region = allocator.region();
+        ASSERT_GE(slab, region.data());
+        ASSERT_LE(slab + 64, region.data() + region.size());
+    }
+    ASSERT_THROW(allocator.allocate(), std::runtime_error);
+    for (auto slab : slabs) allocator.deallocate(slab);
+}
+
+TEST(slab_allocator, SlabsFreedByOtherThreadsComeBack) {
+    SmallAllocator allocator;
+    std::vector<uint8_t*> slabs;
+    for (int i = 0; i < 256; i++) slabs.push_back(allocator.allocate());
+
+    // Freed into the magazines of other threads, which are flushed to the depot as the threads exit
+    {
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                SmallAllocator local;
+                for (size_t i = t; i < slabs.size(); i += 4) local.deallocate(slabs[i]);
+            });
+        }
+    }
+
+    std::set<uint8_t*> reallocated;
+    for (int i = 0; i < 256; i++) ASSERT_TRUE(reallocated.insert(allocator.allocate()).second);
+    for (auto slab : reallocated) allocator.deallocate(slab);
+}
+
+TEST(slab_allocator, MagazineSpillsToTheDepot) {
+    // The magazine of a thread holds at most two slabs here
+    TinyAllocator allocator;
+    std::vector<uint64_t*> slabs;
+    for (int i = 0; i < 8; i++) slabs.push_back(allocator.allocate());
+    for (auto slab : slabs) allocator.deallocate(slab);
+
+    // The six spilled slabs are available to the other threads, while the last two are kept here
+    std::set<uint64_t*> freed(slabs.begin(), slabs.end());
+    std::set<uint64_t*> taken;
+    std::jthread([&] {
+        TinyAllocator local;
+        for (int i = 0; i < 6; i++) {
+            auto slab = local.allocate();
+            EXPECT_TRUE(freed.contains(slab));
+            EXPECT_TRUE(taken.insert(slab).second);
+        }
+        EXPECT_THROW((void)local.allocate(), std::runtime_error);
+        for (auto slab : taken) local.deallocate(slab);
+    }).join();
+    ASSERT_EQ(taken.size(), 6);
+
+    // Served from the magazine, before the depot, which holds the slabs taken above by now
+    std::set<uint64_t*> kept { allocator.allocate(), allocator.allocate() };
+    ASSERT_EQ(kept.size(), 2);
+    for (auto slab : kept) {
+        ASSERT_TRUE(freed.contains(slab));
+        ASSERT_FALSE(taken.contains(slab));
+        allocator.deallocate(slab);
+    }
+}
+
+TEST(slab_allocator, ArenaGrowsInChunks) {
+    tcpp::ArenaOptions options;
+    options.initial_size = tcpp::Arena::HugePageSize;
+    options.growth_size = tcpp::Arena::HugePageSize;
+    // 512 slabs per chunk, up to 2048 of them
+    tcpp::ReusableSlabAllocator<uint8_t, 4096, 2048> allocator(options);
+    ASSERT_EQ(allocator.slabs_count(), 512);
+
+    std::vector<uint8_t*> slabs;
+    for (int i = 0; i < 1000; i++) {
+        slabs.push_back(allocator.allocate());
+        // Backed by memory
+        slabs.back()[4095] = 1;
+    }
+    ASSERT_EQ(allocator.slabs_count(), 1024);
+    ASSERT_EQ(allocator.committed_region().size(), 1024 * 4096);
+
+    for (int i = 1000; i < 2048; i++) slabs.push_back(allocator.allocate());
+    ASSERT_THROW(allocator.allocate(), std::runtime_error);
+    ASSERT_EQ(std::set<uint8_t*>(slabs.begin(), slabs.end()).size(), 2048);
+    allocator.deallocate_bulk(slabs);
+}
+
+TEST(slab_allocator, ArenaTakesAnyNumaNode) {
+    // Past the nodes of a single word of the mask. The placement fails on a machine without
+    //  such a node, which leaves the memory to the first-touch policy.
+    tcpp::ArenaOptions options;
+    options.initial_size = tcpp::Arena::HugePageSize;
+    options.numa_node = 100;
+    tcpp::Arena arena(tcpp::Arena::HugePageSize, options);
+    ASSERT_EQ(arena.committed(), tcpp::Arena::HugePageSize);
+    arena.data()[0] = 1;
+}
+
+TEST(slab_allocator, PacketsTakeTheSmallestClassThatFits) {
+    using tcpp::PacketAllocator;
+    using tcpp::SizeClass;
+    PacketAllocator allocator;
+
+    auto ack = allocator.allocate(40);
+    auto segment = allocator.allocate(1500);
+    auto offloaded = allocator.allocate(1 << 16);
+    ASSERT_EQ(PacketAllocator::metadata(ack).size_class, SizeClass::Small);
+    ASSERT_EQ(PacketAllocator::metadata(segment).size_class, SizeClass::Regular);
+    ASSERT_EQ(PacketAllocator::metadata(offloaded).size_class, SizeClass::Large);
+    ASSERT_EQ(PacketAllocator::capacity(ack), PacketAllocator::SmallCapacity);
+    ASSERT_EQ(PacketAllocator::capacity(segment), PacketAllocator::RegularCapacity);
+    ASSERT_GE(PacketAllocator::capacity(offloaded), 1 << 16);
+    ASSERT_THROW((void)allocator.allocate(PacketAllocator::LargeCapacity + 1), std::invalid_argument);
+    // Too late, now that the buffers are allocated
+    ASSERT_FALSE(PacketAllocator::configure({ }, { }, { }));
+
+    // Each class is carved out of its own region
+    auto regions = PacketAllocator::regions();
+    for (auto [buffer, index] : { std::pair { ack, 0 }, std::pair { segment, 1 }, std::pair { offloaded, 2 } }) {
+        auto region = regions[static_cast<size_t>(index)];
+        ASSERT_GE(buffer, region.data());
+        ASSERT_LT(buffer, region.data() + region.size());
+    }
+
+    // Freed back to the class it came from, so that the ones handed out next still come from their regions
+    std::array buffers { ack, segment, offloaded };
+    allocator.deallocate_bulk(buffers);
+    buffers = { allocator.allocate(40), allocator.allocate(1500), allocator.allocate(1 << 16) };
+    for (size_t i = 0; i < buffers.size(); i++) {
+        ASSERT_EQ(PacketAllocator::metadata(buffers[i]).size_class, static_cast<SizeClass>(i));
+        ASSERT_GE(buffers[i], regions[i].data());
+        ASSERT_LT(buffers[i], regions[i].data() + regions[i].size());
+    }
+    ASSERT_EQ(PacketAllocator::capacity(buffers[0]), PacketAllocator::SmallCapacity);
+    allocator.deallocate_bulk(buffers);
+}
@@ -0,0 +1,418 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <string>
+#include <vector>
+#include <optional>
+#include <utility>
+#include <functional>
+
+#include <tcpp/TCPConnection.hpp>
+#include <tcpp/PayloadView.hpp>
+
+using Connection = tcpp::TCPConnection<1 << 10>;
+
+// A client and a server connection wired to each other through their send queues. The packets are carried
+//  over by pump(), on the thread of the test, and the ones the filters pick are dropped on the way. The
+//  timers asked for by the client are run by fire_client_timer(), on the same thread.
+struct ConnectionPair {
+    Connection::SendQueue client_queue;
+    Connection::SendQueue server_queue;
+    std::optional<tcpp::SteadyTime> client_timer;
+    Connection client;
+    Connection server;
+    std::function<bool(const tcpp::structs::IPv4&)> drop_from_client = [](auto&) { return false; };
+    std::function<bool(const tcpp::structs::IPv4&)> drop_from_server = [](auto&) { return false; };
+
+    explicit ConnectionPair(const tcpp::ConnectionOptions options = { })
+        : client({ 1, 2, 3, 4 }, client_queue, options, { }, [this](auto time) { client_timer = time; }),
+          server({ 2, 1, 4, 3 }, server_queue, options)
+    {
+        client.open();
+        while (pump()) { }
+    }
+
+    // Returns whether anything was carried over
+    bool pump() {
+        bool any = false;
+        while (auto packet = client_queue.pop()) {
+            any = true;
+            if (drop_from_client(tcpp::structs::IPv4::from_ptr(*packet))) {
+                tcpp::PacketAllocator{}.deallocate(*packet);
+                continue;
+            }
+            server.process_packet(*packet);
+        }
+        while (auto packet = server_queue.pop()) {
+            any = true;
+            if (drop_from_server(tcpp::structs::IPv4::from_ptr(*packet))) {
+                tcpp::PacketAllocator{}.deallocate(*packet);
+                continue;
+            }
+            client.process_packet(*packet);
+        }
+        return any;
+    }
+
+    // Returns whether a timer was due
+    bool fire_client_timer() {
+        if (!client_timer) return false;
+        std::this_thread::sleep_until(*std::exchange(client_timer, std::nullopt));
+        client.process_timer();
+        return true;
+    }
+
+    // Both sides close at once. Each close() waits for the other side, so they're called off the pumping thread.
+    ~ConnectionPair() {
+        std::jthread client_closer([this] { client.close(); });
+        std::jthread server_closer([this] { server.close(); });
+        while (!client.connection_closed || !server.connection_closed) {
+            if (!pump()) std::this_thread::yield();
+        }
+    }
+};
+
+static size_t payload_size(const tcpp::structs::IPv4& ip) {
+    return ip.total_len() - ip.payload_offset() - ip.tcp_payload().payload_offset();
+}
+
+// Writes the bytes on the client, and reads them on the server, pumping the packets in between
+static std::vector<uint8_t> transfer(ConnectionPair& pair, const std::vector<uint8_t>& sent) {
+    std::vector<uint8_t> received(sent.size());
+    size_t written = 0;
+    size_t read = 0;
+    for (int i = 0; i < 100000 && read < sent.size(); i++) {
+        written += pair.client.write(std::span { sent }.subspan(written));
+        pair.pump();
+        read += pair.server.read(std::span { received }.subspan(read));
+    }
+    received.resize(read);
+    return received;
+}
+
+TEST(tcp_connection, SacksAndResendsOnlyTheLostSegments) {
+    ConnectionPair pair;
+    std::vector<uint8_t> sent(200000);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i * 7);
+
+    // The 5th and the 9th data segments are lost, once each
+    size_t data_segments = 0;
+    std::set<uint32_t> seen;
+    size_t resent = 0;
+    pair.drop_from_client = [&](const tcpp::structs::IPv4& ip) {
+        if (payload_size(ip) == 0) return false;
+        if (!seen.insert(ip.tcp_payload().seq_num()).second) {
+            resent++;
+            return false;
+        }
+        data_segments++;
+        return data_segments == 5 || data_segments == 9;
+    };
+
+    ASSERT_EQ(transfer(pair, sent), sent);
+    ASSERT_EQ(resent, 2);
+}
+
+TEST(tcp_connection, InitialSequenceNumbersDependOnTheConnection) {
+    const tcpp::ConnectionID id { 1, 2, 3, 4 };
+    const auto first = tcpp::initial_sequence_number(id);
+    // The clock ticks every 4 microseconds
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const auto later = tcpp::initial_sequence_number(id);
+    ASSERT_TRUE(tcpp::seq_lt(first, later));
+    ASSERT_LT(later - first, 1u << 20);
+    // Another port on the same hosts lands elsewhere in the sequence space
+    const auto other = tcpp::initial_sequence_number({ 1, 2, 3, 5 });
+    ASSERT_GT(std::min(other - later, later - other), 1u << 10);
+}
+
+TEST(tcp_connection, ProbesAClosedWindow) {
+    // Fewer bytes than written fit in the receive buffer, and the timeout is as short as the round trips
+    ConnectionPair pair({ .min_rto = std::chrono::milliseconds(1), .buffer_size = 1 << 14 });
+    std::vector<uint8_t> sent(1 << 16);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i * 3);
+
+    std::set<uint32_t> seen;
+    size_t resent = 0;
+    pair.drop_from_client = [&](const tcpp::structs::IPv4& ip) {
+        if (payload_size(ip) > 0 && !seen.insert(ip.tcp_payload().seq_num()).second) resent++;
+        return false;
+    };
+
+    size_t written = pair.client.write(std::span { sent });
+    while (pair.pump()) { }
+    // The window is full, and the updates that reopen it are lost
+    pair.drop_from_server = [](auto&) { return true; };
+    std::vector<uint8_t> received(sent.size());
+    size_t read = pair.server.read(received);
+    ASSERT_GT(read, 0);
+    while (pair.pump()) { }
+    pair.drop_from_server = [](auto&) { return false; };
+
+    // The probes find the window open again, and nothing is taken as lost meanwhile
+    for (int i = 0; i < 10000 && read < sent.size(); i++) {
+        written += pair.client.write(std::span { sent }.subspan(written));
+        if (!pair.pump()) pair.fire_client_timer();
+        read += pair.server.read(std::span { received }.subspan(read));
+    }
+    ASSERT_EQ(received, sent);
+    ASSERT_EQ(resent, 0);
+}
+
+TEST(tcp_connection, PushesAgainWhatAFullQueueRefused) {
+    ConnectionPair pair;
+    // Filled up with packets of no one, as a sender that's fallen behind would leave it
+    tcpp::PacketAllocator allocator;
+    while (true) {
+        auto buffer = allocator.allocate();
+        if (!pair.client_queue.push(buffer)) {
+            allocator.deallocate(buffer);
+            break;
+        }
+    }
+    ASSERT_EQ(pair.client.write("Hello World!\n"), 13);
+
+    // Kept rather than lost, and pushed again shortly after the queue has room
+    ASSERT_TRUE(pair.client_timer.has_value());
+    ASSERT_LT(*pair.client_timer, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+    while (auto packet = pair.client_queue.pop()) allocator.deallocate(*packet);
+    ASSERT_TRUE(pair.fire_client_timer());
+    while (pair.pump()) { }
+
+    std::array<uint8_t, 64> buffer { };
+    const auto n = pair.server.read(buffer);
+    ASSERT_EQ(std::string(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(n)), "Hello World!\n");
+}
+
+TEST(tcp_connection, HoldsBackSmallPiecesOfSegments) {
+    ConnectionPair pair({ .min_rto = std::chrono::milliseconds(1), .buffer_size = 1 << 14 });
+    // A peer that offers the window as soon as it has any room at all
+    pair.drop_from_server = [](const tcpp::structs::IPv4& ip) {
+        const_cast<tcpp::structs::IPv4&>(ip).tcp_payload().set_window_size(100);
+        return false;
+    };
+    size_t sent = 0;
+    pair.drop_from_client = [&](const tcpp::structs::IPv4& ip) {
+        sent += payload_size(ip);
+        return false;
+    };
+    std::vector<uint8_t> bytes(4000, 1);
+    ASSERT_EQ(pair.client.write(std::span { bytes }), bytes.size());
+    while (pair.pump()) { }
+    ASSERT_EQ(sent, bytes.size());
+
+    // The window of 100 bytes is far less than a segment, and than half the largest window offered
+    ASSERT_EQ(pair.client.write(std::span { bytes }), bytes.size());
+    while (pair.pump()) { }
+    ASSERT_EQ(sent, bytes.size());
+
+    // Until nothing comes to open the window further for a while
+    ASSERT_TRUE(pair.fire_client_timer());
+    while (pair.pump()) { }
+    ASSERT_EQ(sent, bytes.size() + 100);
+    pair.drop_from_server = [](auto&) { return false; };
+}
+
+TEST(tcp_connection, TakesTheAcknowledgementOfADuplicate) {
+    ConnectionPair pair({ .min_rto = std::chrono::milliseconds(1) });
+    std::vector<uint8_t> bytes(100, 1);
+
+    // A copy of the data segment of the server, to be received again later
+    tcpp::PacketHandle copy;
+    pair.drop_from_server = [&](const tcpp::structs::IPv4& ip) {
+        if (payload_size(ip) > 0 && !copy) {
+            copy = tcpp::PacketHandle { tcpp::PacketAllocator{}.allocate(ip.total_len()) };
+            std::copy_n(reinterpret_cast<const uint8_t*>(&ip), ip.total_len(), copy.get());
+        }
+        return false;
+    };
+    ASSERT_EQ(pair.server.write(bytes), bytes.size());
+    while (pair.pump()) { }
+    ASSERT_EQ(pair.client.read(bytes), bytes.size());
+
+    // The acknowledgement of the data of the client is lost
+    std::set<uint32_t> seen;
+    size_t resent = 0;
+    pair.drop_from_client = [&](const tcpp::structs::IPv4& ip) {
+        if (payload_size(ip) > 0 && !seen.insert(ip.tcp_payload().seq_num()).second) resent++;
+        return false;
+    };
+    pair.drop_from_server = [](auto&) { return true; };
+    ASSERT_EQ(pair.client.write(bytes), bytes.size());
+    while (pair.pump()) { }
+    pair.drop_from_server = [](auto&) { return false; };
+
+    // Then the segment of the server is received again, carrying the acknowledgement
+    auto& duplicate = tcpp::structs::IPv4::from_ptr(copy.get());
+    duplicate.tcp_payload().set_ack_num(duplicate.tcp_payload().ack_num() + static_cast<uint32_t>(bytes.size()));
+    pair.client.process_packet(copy.release());
+    while (pair.pump()) { }
+    pair.fire_client_timer();
+    while (pair.pump()) { }
+    ASSERT_EQ(resent, 0);
+}
+
+TEST(tcp_connection, LingersInTimeWait) {
+    ConnectionPair pair({ .time_wait = std::chrono::milliseconds(50) });
+
+    // Copies of the fin of the server, to be received again later
+    std::vector<tcpp::PacketHandle> fins;
+    pair.drop_from_server = [&](const tcpp::structs::IPv4& ip) {
+        if (ip.tcp_payload().fin) {
+            for (int i = 0; i < 2; i++) {
+                fins.emplace_back(tcpp::PacketAllocator{}.allocate(ip.total_len()));
+                std::copy_n(reinterpret_cast<const uint8_t*>(&ip), ip.total_len(), fins.back().get());
+            }
+        }
+        return false;
+    };
+    size_t acks = 0;
+    pair.drop_from_client = [&](auto&) { acks++; return false; };
+
+    // The client closes first, and is the one to linger
+    {
+        std::jthread client_closer([&] { pair.client.close(); });
+        while (!pair.server.peer_closed) pair.pump();
+        std::jthread server_closer([&] { pair.server.close(); });
+        while (!pair.client.connection_closed || !pair.server.connection_closed) pair.pump();
+    }
+    ASSERT_EQ(fins.size(), 2);
+    ASSERT_TRUE(pair.client_timer.has_value());
+
+    // The fin is sent again, as if the last acknowledgement were lost, and it's acknowledged again
+    acks = 0;
+    pair.client.process_packet(fins[0].release());
+    ASSERT_EQ(acks, 0);
+    while (pair.pump()) { }
+    ASSERT_EQ(acks, 1);
+
+    // Until the connection is let go of, after which nothing is answered anymore
+    const auto start = std::chrono::steady_clock::now();
+    while (pair.fire_client_timer()) { }
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+    pair.client.process_packet(fins[1].release());
+    while (pair.pump()) { }
+    ASSERT_EQ(acks, 1);
+}
+
+TEST(tcp_connection, LoanedPayloadHoldsItsBuffer) {
+    ConnectionPair pair({ .zero_copy_receive = true });
+    std::vector<uint8_t> sent(100);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i);
+    ASSERT_EQ(pair.client.write(sent), sent.size());
+    while (pair.pump()) { }
+
+    auto view = pair.server.receive_payload();
+    ASSERT_TRUE(view.has_value());
+    ASSERT_TRUE(std::ranges::equal(view->data(), sent));
+    // The payload is loaned in place, right after the headers of the segment
+    const auto buffer = const_cast<uint8_t*>(view->data().data()) - sizeof(tcpp::structs::IPv4) - sizeof(tcpp::structs::TCP);
+    tcpp::PacketAllocator::retain(buffer);
+    ASSERT_EQ(tcpp::PacketAllocator::references(buffer), 2);
+
+    // Held by whichever view it's moved to, and let go of once
+    tcpp::PayloadView moved = std::move(view.value());
+    ASSERT_TRUE(view->empty());
+    ASSERT_EQ(tcpp::PacketAllocator::references(buffer), 2);
+    view.reset();
+    ASSERT_EQ(tcpp::PacketAllocator::references(buffer), 2);
+    moved.release();
+    ASSERT_TRUE(moved.empty());
+    ASSERT_EQ(tcpp::PacketAllocator::references(buffer), 1);
+    moved.release();
+    ASSERT_EQ(tcpp::PacketAllocator::references(buffer), 1);
+    tcpp::PacketAllocator{}.deallocate(buffer);
+}
+
+TEST(tcp_connection, LoansWholeSegmentsOnceTheSlotsRunOut) {
+    ConnectionPair pair({ .zero_copy_receive = true, .min_rto = std::chrono::milliseconds(1) });
+    // The connection has 256 slots for the segments loaned to the application. The window counts each
+    //  of them as a whole segment, which lets the small segments that follow outnumber the slots left.
+    constexpr size_t small_segments = 250;
+    constexpr size_t small_size = 10;
+    constexpr size_t segments = 20;
+    constexpr size_t size = 100;
+    std::vector<uint8_t> sent(small_segments * small_size + segments * size);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i * 7);
+
+    size_t written = 0;
+    for (size_t i = 0; i < small_segments; i++) {
+        written += pair.client.write(std::span { sent }.subspan(written, small_size));
+        while (pair.pump()) { }
+    }
+    // The first of them is lost, and the rest wait for it out of order. It's sent again on a timeout, being too
+    //  small to be taken as lost, and then as many as there are slots for are loaned at once.
+    std::optional<uint32_t> dropped;
+    bool resent = false;
+    pair.drop_from_client = [&](const tcpp::structs::IPv4& ip) {
+        if (payload_size(ip) == 0) return false;
+        if (!dropped) {
+            dropped = ip.tcp_payload().seq_num();
+            return true;
+        }
+        resent |= ip.tcp_payload().seq_num() == *dropped;
+        return false;
+    };
+    for (size_t i = 0; i < segments; i++) {
+        written += pair.client.write(std::span { sent }.subspan(written, size));
+        while (pair.pump()) { }
+    }
+    ASSERT_EQ(written, sent.size());
+    for (int i = 0; i < 100 && !resent; i++) {
+        pair.fire_client_timer();
+        while (pair.pump()) { }
+    }
+    ASSERT_TRUE(resent);
+
+    // None of the segments that didn't find a slot is loaned in part
+    std::vector<uint8_t> received;
+    size_t loaned = 0;
+    while (auto view = pair.server.receive_payload()) {
+        ASSERT_TRUE(view->size() == small_size || view->size() == size);
+        received.insert(received.end(), view->data().begin(), view->data().end());
+        loaned++;
+    }
+    ASSERT_EQ(loaned, 256);
+
+    // And they're loaned once there are slots for them
+    for (int i = 0; i < 1000 && received.size() < sent.size(); i++) {
+        if (!pair.pump()) pair.fire_client_timer();
+        while (auto view = pair.server.receive_payload()) {
+            ASSERT_TRUE(view->size() == small_size || view->size() == size);
+            received.insert(received.end(), view->data().begin(), view->data().end());
+        }
+    }
+    ASSERT_EQ(received, sent);
+}
+
+TEST(tcp_connection, ReadsAfterALoanedPayload) {
+    ConnectionPair pair({ .zero_copy_receive = true });
+    std::vector<uint8_t> sent(300);
+    for (size_t i = 0; i < sent.size(); i++) sent[i] = static_cast<uint8_t>(i);
+    // Three segments of 100 bytes
+    for (size_t i = 0; i < 3; i++) {
+        ASSERT_EQ(pair.client.write(std::span { sent }.subspan(i * 100, 100)), 100);
+        while (pair.pump()) { }
+    }
+
+    // Half of the first segment is consumed, then the view is released along with the other half
+    auto view = pair.server.receive_payload();
+    ASSERT_TRUE(view.has_value());
+    view->remove_prefix(50);
+    ASSERT_TRUE(std::ranges::equal(view->data(), std::span { sent }.subspan(50, 50)));
+    view.reset();
+
+    // read() goes on with the next segment, across the segments, and keeps the rest of a segment it reads in part
+    std::array<uint8_t, 30> first { };
+    ASSERT_EQ(pair.server.read(first), first.size());
+    ASSERT_TRUE(std::ranges::equal(first, std::span { sent }.subspan(100, 30)));
+    std::array<uint8_t, 200> rest { };
+    ASSERT_EQ(pair.server.read(rest), 170);
+    ASSERT_TRUE(std::ranges::equal(std::span { rest }.first(170), std::span { sent }.subspan(130)));
+    ASSERT_EQ(pair.server.read(rest), 0);
+    ASSERT_FALSE(pair.server.receive_payload().has_value());
+}
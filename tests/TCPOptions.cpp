@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+
+#include <tcpp/structs/TCP.hpp>
+
+using tcpp::structs::TCP;
+
+/*
+ * The TCP header of a syn sent by Linux, with its options:
+ *   Maximum segment size: 65495 bytes
+ *   SACK permitted
+ *   Timestamps: TSval 2297665210, TSecr 0
+ *   No-Operation (NOP)
+ *   Window scale: 7 (multiply by 128)
+ */
+alignas(4) uint8_t linux_syn[] = { 0xcd, 0xec, 0x0f, 0xa0, 0x2a, 0x8f, 0x5d, 0x5e, 0x00, 0x00, 0x00, 0x00,
+    0xa0, 0x02, 0xff, 0xd7, 0xfe, 0x30, 0x00, 0x00, 0x02, 0x04, 0xff, 0xd7, 0x04, 0x02, 0x08, 0x0a,
+    0x88, 0xf3, 0x5c, 0xba, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0x03, 0x07 };
+
+TEST(tcp_options, ParsesTheOptionsOfASyn) {
+    auto& tcp = TCP::from_ptr(linux_syn);
+    ASSERT_EQ(tcp.options().size(), 20);
+    ASSERT_EQ(tcp.mss_option(), 65495);
+    ASSERT_EQ(tcp.window_scale_option(), 7);
+    ASSERT_TRUE(tcp.sack_permitted_option());
+}
+
+TEST(tcp_options, AppendsOptionsToTheHeader) {
+    alignas(4) std::array<uint8_t, 60> header { };
+    auto& tcp = TCP::from_ptr(header.data());
+    tcp.data_offset = sizeof(TCP) / 4;
+    ASSERT_EQ(tcp.mss_option(), 0);
+    ASSERT_EQ(tcp.window_scale_option(), -1);
+    ASSERT_FALSE(tcp.sack_permitted_option());
+
+    tcp.set_mss_option(1460);
+    tcp.set_window_scale_option(20);
+    tcp.set_sack_permitted_option();
+    ASSERT_EQ(tcp.payload_offset(), sizeof(TCP) + TCP::SYN_OPTIONS_SIZE);
+    ASSERT_EQ(tcp.mss_option(), 1460);
+    // Shift counts above the maximum are taken as the maximum
+    ASSERT_EQ(tcp.window_scale_option(), TCP::MAX_WINDOW_SCALE);
+    ASSERT_TRUE(tcp.sack_permitted_option());
+}
+
+TEST(tcp_options, CarriesTheSackBlocks) {
+    alignas(4) std::array<uint8_t, 60> header { };
+    auto& tcp = TCP::from_ptr(header.data());
+    tcp.data_offset = sizeof(TCP) / 4;
+    std::array<TCP::SackBlock, TCP::MAX_SACK_BLOCKS> blocks { };
+    ASSERT_EQ(tcp.sack_option(blocks), 0);
+
+    const std::array<TCP::SackBlock, 5> sent { { { 100, 200 }, { 0xFFFFFF00, 10 }, { 300, 400 }, { 500, 600 }, { 700, 800 } } };
+    tcp.set_sack_option(sent);
+    // Only as many as fit in the options
+    ASSERT_EQ(tcp.payload_offset(), sizeof(TCP) + TCP::padded_sack_option_size(TCP::MAX_SACK_BLOCKS));
+    ASSERT_EQ(tcp.sack_option(blocks), TCP::MAX_SACK_BLOCKS);
+    for (size_t i = 0; i < TCP::MAX_SACK_BLOCKS; i++) {
+        ASSERT_EQ(blocks[i].begin, sent[i].begin);
+        ASSERT_EQ(blocks[i].end, sent[i].end);
+    }
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <tcpp/data-structures/WaitableQueue.hpp>
+#include <tcpp/data-structures/MPSCBoundedQueue.hpp>
+
+TEST(wait_strategy, ParkedConsumerIsWokenUp) {
+    // With no spinning at all, the consumer parks whenever the queue is empty.
+    //  Every element has to arrive regardless of how the two threads interleave.
+    tcpp::WaitableQueue<tcpp::MPSCBoundedQueue<int, 64>> queue;
+    constexpr int count = 10'000;
+
+    std::jthread producer([&] {
+        for (int i = 0; i < count; i++) {
+            while (!queue.push(i)) { }
+        }
+    });
+
+    tcpp::Backoff backoff(tcpp::WaitStrategy::SpinPark, 0);
+    int expected = 0;
+    while (expected < count) {
+        auto value = queue.pop();
+        if (!value.has_value()) {
+            backoff.idle(queue.parking_spot(), [&] { return !queue.empty(); });
+            continue;
+        }
+        backoff.reset();
+        ASSERT_EQ(value.value(), expected++);
+    }
+}